@@ -0,0 +1,194 @@
+/*
+Match Counter for OBS
+Copyright (C) 2025 Yudai Udagawa
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+/*
+ * match-counter.cの書式化・勝敗操作のマイクロベンチマーク
+ *
+ * 結果は1行1件のJSON（NDJSON）で標準出力に書き出す。
+ *   match-counter-bench [--iterations N]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <util/platform.h>
+#include "match-counter.h"
+
+#define DEFAULT_ITERATIONS 1000000
+#define MATCHUP_KEYS 10000
+
+struct bench_result {
+	const char *name;
+	const char *format;
+	uint64_t iterations;
+	uint64_t elapsed_ns;
+	uint64_t allocs;
+};
+
+// 最適化で結果が捨てられないようにするための書き込み先
+static volatile size_t bench_sink = 0;
+
+static void print_result(const struct bench_result *result)
+{
+	double ns_per_op = (double)result->elapsed_ns / (double)result->iterations;
+	double allocs_per_op = (double)result->allocs / (double)result->iterations;
+
+	printf("{\"name\":\"%s\",\"format\":\"%s\",\"iterations\":%llu,\"ns_per_op\":%.2f,\"allocs_per_op\":%.3f}\n",
+	       result->name, result->format ? result->format : "", (unsigned long long)result->iterations,
+	       ns_per_op, allocs_per_op);
+}
+
+// 毎回確保した文字列を返すAPI（プロパティ・get_text用）
+static void bench_formatted_text(const char *name, const char *format, uint64_t iterations)
+{
+	match_counter_t *counter = match_counter_create();
+	match_counter_set_format(counter, format);
+	match_counter_set_wins(counter, 123);
+	match_counter_set_losses(counter, 45);
+
+	uint64_t allocs = bnum_allocs();
+	uint64_t start = os_gettime_ns();
+
+	for (uint64_t i = 0; i < iterations; i++) {
+		char *text = match_counter_get_formatted_text(counter);
+		bench_sink += (size_t)text[0];
+		bfree(text);
+	}
+
+	struct bench_result result = {name, format, iterations, os_gettime_ns() - start, bnum_allocs() - allocs};
+	print_result(&result);
+	match_counter_destroy(counter);
+}
+
+// 描画スレッドが使う内部バッファ版。毎回勝敗数を変えてキャッシュを無効にする
+static void bench_text(const char *name, const char *format, uint64_t iterations)
+{
+	match_counter_t *counter = match_counter_create();
+	match_counter_set_format(counter, format);
+	match_counter_set_losses(counter, 45);
+
+	uint64_t allocs = bnum_allocs();
+	uint64_t start = os_gettime_ns();
+
+	for (uint64_t i = 0; i < iterations; i++) {
+		match_counter_add_win(counter);
+		bench_sink += (size_t)match_counter_get_text(counter)[0];
+	}
+
+	struct bench_result result = {name, format, iterations, os_gettime_ns() - start, bnum_allocs() - allocs};
+	print_result(&result);
+	match_counter_destroy(counter);
+}
+
+typedef bool (*counter_op_t)(match_counter_t *counter);
+
+static void bench_counter_op(const char *name, counter_op_t op, counter_op_t setup, uint64_t iterations)
+{
+	match_counter_t *counter = match_counter_create();
+
+	uint64_t allocs = bnum_allocs();
+	uint64_t start = os_gettime_ns();
+
+	for (uint64_t i = 0; i < iterations; i++) {
+		if (setup)
+			setup(counter);
+		op(counter);
+	}
+
+	struct bench_result result = {name, NULL, iterations, os_gettime_ns() - start, bnum_allocs() - allocs};
+	print_result(&result);
+	bench_sink += (size_t)match_counter_get_wins(counter);
+	match_counter_destroy(counter);
+}
+
+// 多数の対戦カードを順に切り替えながら記録と表示を行う。キーはあらかじめ全て登録しておく
+static void bench_matchup_switch(const char *name, const char *format, uint64_t iterations)
+{
+	match_counter_t *counter = match_counter_create();
+	match_counter_set_format(counter, format);
+
+	static char keys[MATCHUP_KEYS][MATCH_COUNTER_MATCHUP_KEY_SIZE];
+	for (size_t i = 0; i < MATCHUP_KEYS; i++) {
+		snprintf(keys[i], sizeof(keys[i]), "opponent-%05zu", i);
+		match_counter_set_matchup(counter, keys[i]);
+		match_counter_add_win(counter);
+	}
+
+	uint64_t allocs = bnum_allocs();
+	uint64_t start = os_gettime_ns();
+
+	for (uint64_t i = 0; i < iterations; i++) {
+		match_counter_set_matchup(counter, keys[(i * 7919) % MATCHUP_KEYS]);
+		if (i & 1)
+			match_counter_add_win(counter);
+		else
+			match_counter_add_loss(counter);
+		bench_sink += (size_t)match_counter_get_text(counter)[0];
+	}
+
+	struct bench_result result = {name, format, iterations, os_gettime_ns() - start, bnum_allocs() - allocs};
+	print_result(&result);
+	match_counter_destroy(counter);
+}
+
+int main(int argc, char **argv)
+{
+	uint64_t iterations = DEFAULT_ITERATIONS;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+			iterations = strtoull(argv[++i], NULL, 10);
+		} else {
+			fprintf(stderr, "usage: %s [--iterations N]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (!iterations)
+		iterations = 1;
+
+	static const struct {
+		const char *name;
+		const char *format;
+	} formats[] = {
+		{"short", "%w-%l"},
+		{"default", "%w-%l(%r)"},
+		{"long", "Ranked session today: %w wins / %l losses over %t matches, "
+			 "current win rate %r -- thanks for watching and good luck in queue!"},
+		{"dense", "%w%l%t%r%w%l%t%r%w%l%t%r%w%l%t%r%w%l%t%r%w%l%t%r%w%l%t%r%w%l%t%r"},
+	};
+
+	char name[64];
+	for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
+		snprintf(name, sizeof(name), "get_formatted_text/%s", formats[i].name);
+		bench_formatted_text(name, formats[i].format, iterations);
+
+		snprintf(name, sizeof(name), "get_text/%s", formats[i].name);
+		bench_text(name, formats[i].format, iterations);
+	}
+
+	bench_counter_op("add_win", match_counter_add_win, NULL, iterations);
+	bench_counter_op("add_loss", match_counter_add_loss, NULL, iterations);
+	bench_counter_op("subtract_win", match_counter_subtract_win, match_counter_add_win, iterations);
+	bench_counter_op("subtract_loss", match_counter_subtract_loss, match_counter_add_loss, iterations);
+	bench_counter_op("reset", match_counter_reset, match_counter_add_win, iterations);
+
+	bench_matchup_switch("matchup_switch", "vs %k: %kw-%kl (%kr)", iterations);
+
+	return 0;
+}
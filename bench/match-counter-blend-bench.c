@@ -0,0 +1,204 @@
+/*
+Match Counter for OBS
+Copyright (C) 2025 Yudai Udagawa
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+/*
+ * グリフアトラスからテキストを合成するアルファブレンドのベンチマーク
+ *
+ * このCPUで使えるカーネル（スカラー版とSSE2/AVX2/NEON）ごとに、match-counter-compose.cと同じ手順で
+ * スコアのテキストを合成する時間と、長い1行を合成する時間を測る。
+ * 結果は1行1件のJSON（NDJSON）で標準出力に書き出し、各カーネルの結果がスカラー版と一致するかも確かめる。
+ *   match-counter-blend-bench [--iterations N] [--height N]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <util/bmem.h>
+#include <util/platform.h>
+#include "match-counter-blend.h"
+
+#define DEFAULT_ITERATIONS 2000
+#define DEFAULT_HEIGHT 128
+#define GLYPH_COUNT 13 // "0123456789-%."
+#define GLYPH_PADDING 2
+#define ROW_PIXELS 4096
+
+// 合成するテキスト（"128-64 66.7%" からスペースを除いたもの）のアトラスでの番号
+static const uint32_t text_indices[] = {1, 2, 8, 10, 6, 4, 6, 6, 12, 7, 11};
+#define TEXT_LENGTH (sizeof(text_indices) / sizeof(text_indices[0]))
+
+struct bench_atlas {
+	uint8_t *pixels;
+	uint32_t cx;
+	uint32_t cy;
+	uint32_t glyph_x[GLYPH_COUNT];
+	uint32_t glyph_cx;
+};
+
+// 最適化で結果が捨てられないようにするための書き込み先
+static volatile size_t bench_sink = 0;
+
+// 輪郭がなめらかに変わる、乗算済みアルファの白い文字のようなピクセルを作る
+static void bench_atlas_init(struct bench_atlas *atlas, uint32_t height)
+{
+	atlas->cy = height;
+	atlas->glyph_cx = height * 5 / 8;
+	atlas->cx = (atlas->glyph_cx + GLYPH_PADDING) * GLYPH_COUNT;
+	atlas->pixels = bzalloc((size_t)atlas->cx * atlas->cy * 4);
+
+	uint32_t seed = 12345;
+	for (size_t g = 0; g < GLYPH_COUNT; g++) {
+		atlas->glyph_x[g] = (uint32_t)g * (atlas->glyph_cx + GLYPH_PADDING);
+
+		// 余白にはみ出す部分も含めて塗る
+		for (uint32_t y = 0; y < atlas->cy; y++) {
+			for (uint32_t x = 0; x < atlas->glyph_cx + GLYPH_PADDING; x++) {
+				seed = seed * 1103515245u + 12345u;
+				uint8_t alpha = (uint8_t)((seed >> 16) % 3 == 0 ? 0 : (seed >> 8));
+				uint8_t *p = atlas->pixels + ((size_t)y * atlas->cx + atlas->glyph_x[g] + x) * 4;
+				p[0] = p[1] = p[2] = alpha;
+				p[3] = alpha;
+			}
+		}
+	}
+}
+
+// match-counter-compose.cのcompose_runと同じく、文字を横に並べて右のはみ出しを次の文字に重ねる
+static void bench_compose(const struct bench_atlas *atlas, match_counter_blend_func_t over, uint8_t *dst,
+			  uint32_t cx)
+{
+	size_t linesize = (size_t)cx * 4;
+	memset(dst, 0, linesize * atlas->cy);
+
+	uint32_t x = 0;
+	for (size_t i = 0; i < TEXT_LENGTH; i++) {
+		const uint8_t *src = atlas->pixels + (size_t)atlas->glyph_x[text_indices[i]] * 4;
+		uint32_t cell_cx = atlas->glyph_cx + GLYPH_PADDING;
+		if (cell_cx > cx - x)
+			cell_cx = cx - x;
+
+		for (uint32_t y = 0; y < atlas->cy; y++)
+			over(dst + (size_t)x * 4 + y * linesize, src + (size_t)y * atlas->cx * 4, cell_cx);
+
+		x += atlas->glyph_cx;
+	}
+}
+
+static void print_result(const char *name, const char *kernel, uint64_t iterations, uint64_t pixels,
+			 uint64_t elapsed_ns, double scalar_ns, bool matches)
+{
+	double ns_per_op = (double)elapsed_ns / (double)iterations;
+	double mpix_per_sec = elapsed_ns ? (double)pixels * (double)iterations * 1000.0 / (double)elapsed_ns : 0.0;
+
+	printf("{\"name\":\"%s/%s\",\"iterations\":%llu,\"pixels_per_op\":%llu,\"ns_per_op\":%.1f,"
+	       "\"mpix_per_sec\":%.1f,\"speedup\":%.2f,\"matches_scalar\":%s}\n",
+	       name, kernel, (unsigned long long)iterations, (unsigned long long)pixels, ns_per_op, mpix_per_sec,
+	       ns_per_op > 0.0 ? scalar_ns / ns_per_op : 0.0, matches ? "true" : "false");
+}
+
+int main(int argc, char **argv)
+{
+	uint64_t iterations = DEFAULT_ITERATIONS;
+	uint32_t height = DEFAULT_HEIGHT;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+			iterations = strtoull(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "--height") == 0 && i + 1 < argc) {
+			height = (uint32_t)strtoul(argv[++i], NULL, 10);
+		} else {
+			fprintf(stderr, "usage: %s [--iterations N] [--height N]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (!iterations)
+		iterations = 1;
+	if (height < 8 || height > 1024)
+		height = DEFAULT_HEIGHT;
+
+	match_counter_blend_init();
+
+	size_t kernel_count;
+	const struct match_counter_blend_kernel *kernels = match_counter_blend_get_kernels(&kernel_count);
+
+	struct bench_atlas atlas;
+	bench_atlas_init(&atlas, height);
+
+	uint32_t text_cx = atlas.glyph_cx * (uint32_t)TEXT_LENGTH;
+	size_t text_size = (size_t)text_cx * atlas.cy * 4;
+	uint8_t *expected = bmalloc(text_size);
+	uint8_t *composed = bmalloc(text_size);
+	bench_compose(&atlas, kernels[0].over, expected, text_cx);
+
+	// テキストの合成（描画する内容が変わるたびにワーカースレッドで行う処理）
+	double scalar_ns = 0.0;
+	for (size_t k = 0; k < kernel_count; k++) {
+		uint64_t start = os_gettime_ns();
+		for (uint64_t i = 0; i < iterations; i++) {
+			bench_compose(&atlas, kernels[k].over, composed, text_cx);
+			bench_sink += composed[i % text_size];
+		}
+		uint64_t elapsed = os_gettime_ns() - start;
+
+		if (!k)
+			scalar_ns = (double)elapsed / (double)iterations;
+		print_result("compose", kernels[k].name, iterations, (uint64_t)text_cx * atlas.cy, elapsed, scalar_ns,
+			     memcmp(expected, composed, text_size) == 0);
+	}
+
+	// 長い1行への合成（カーネルそのもののスループット）
+	uint8_t *row_src = bmalloc(ROW_PIXELS * 4);
+	uint8_t *row_dst = bmalloc(ROW_PIXELS * 4);
+	uint8_t *row_base = bmalloc(ROW_PIXELS * 4);
+	uint8_t *row_expected = bmalloc(ROW_PIXELS * 4);
+	for (size_t i = 0; i < ROW_PIXELS * 4; i++) {
+		row_src[i] = atlas.pixels[i % ((size_t)atlas.cx * 4)];
+		row_base[i] = (uint8_t)(i * 7);
+	}
+	match_counter_blend_premultiply(row_base, ROW_PIXELS);
+	memcpy(row_expected, row_base, ROW_PIXELS * 4);
+	kernels[0].over(row_expected, row_src, ROW_PIXELS);
+
+	uint64_t row_iterations = iterations * 16;
+	for (size_t k = 0; k < kernel_count; k++) {
+		uint64_t start = os_gettime_ns();
+		for (uint64_t i = 0; i < row_iterations; i++) {
+			kernels[k].over(row_dst, row_src, ROW_PIXELS);
+			bench_sink += row_dst[i % (ROW_PIXELS * 4)];
+		}
+		uint64_t elapsed = os_gettime_ns() - start;
+
+		memcpy(row_dst, row_base, ROW_PIXELS * 4);
+		kernels[k].over(row_dst, row_src, ROW_PIXELS);
+
+		if (!k)
+			scalar_ns = (double)elapsed / (double)row_iterations;
+		print_result("blend_row", kernels[k].name, row_iterations, ROW_PIXELS, elapsed, scalar_ns,
+			     memcmp(row_expected, row_dst, ROW_PIXELS * 4) == 0);
+	}
+
+	bfree(row_src);
+	bfree(row_dst);
+	bfree(row_base);
+	bfree(row_expected);
+	bfree(expected);
+	bfree(composed);
+	bfree(atlas.pixels);
+	return 0;
+}
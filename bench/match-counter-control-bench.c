@@ -0,0 +1,269 @@
+/*
+Match Counter for OBS
+Copyright (C) 2025 Yudai Udagawa
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+/*
+ * 制御ソケットのスループットと、描画スレッドでの適用にかかる時間のベンチマーク
+ *
+ * クライアントのスレッドが1行にbatch個のコマンドを送り、応答を待ってから次の行を送る。
+ * メインスレッドは60fpsのフレームを模して、毎フレームmatch_counter_control_tickと
+ * match_counter_registry_drain_allを呼び、その処理時間を記録する。
+ * スループットは、適用されたコマンドの数をフレームのループ全体の時間で割ったもの。
+ * 1フレームの処理時間は壁時計で測るため、他のスレッドに割り込まれた時間も含む。
+ * 割り込みを除いた処理自体の時間は、スレッドのCPU時間（frame_cpu_*）で別に出力する。
+ * 結果は1行1件のJSON（NDJSON）で標準出力に書き出す。
+ *   match-counter-control-bench [--commands N] [--batch N] [--budget-us N]
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include "match-counter-control.h"
+#include "match-counter-registry.h"
+
+#define DEFAULT_COMMANDS 200000
+#define DEFAULT_BATCH 16
+#define DEFAULT_BUDGET_US 1000
+#define FRAME_NS 16666667ULL
+#define COUNTER_ID "bench"
+
+struct client_state {
+	const char *path;
+	uint64_t commands;
+	uint64_t batch;
+	uint64_t sent;
+	uint64_t busy;
+	bool failed;
+	volatile bool done;
+};
+
+// カウンターを表示するソースの代わりに購読する（購読者のいないカウンターへの操作は受け付けられない）
+static void counter_changed(void *data, match_counter_shared_t *shared)
+{
+	UNUSED_PARAMETER(data);
+	UNUSED_PARAMETER(shared);
+}
+
+// 改行までの1行を読む。切断やエラーならfalse
+static bool read_line(int fd, char *line, size_t size)
+{
+	size_t len = 0;
+	while (len + 1 < size) {
+		ssize_t received = recv(fd, line + len, 1, 0);
+		if (received < 0 && errno == EINTR)
+			continue;
+		if (received <= 0)
+			return false;
+		if (line[len] == '\n')
+			break;
+		len++;
+	}
+	line[len] = '\0';
+	return true;
+}
+
+static void *client_main(void *data)
+{
+	struct client_state *state = data;
+
+	struct sockaddr_un addr = {0};
+	addr.sun_family = AF_UNIX;
+	snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", state->path);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+		state->failed = true;
+		os_atomic_set_bool(&state->done, true);
+		return NULL;
+	}
+
+	// 勝利と敗北を交互に並べた1行を作っておき、毎回同じものを送る
+	struct dstr line = {0};
+	for (uint64_t i = 0; i < state->batch; i++)
+		dstr_cat(&line, i % 2 ? "loss " COUNTER_ID ";" : "win " COUNTER_ID ";");
+	line.array[line.len - 1] = '\n';
+
+	char response[256];
+
+	while (state->sent < state->commands) {
+		if (send(fd, line.array, line.len, 0) != (ssize_t)line.len ||
+		    !read_line(fd, response, sizeof(response))) {
+			state->failed = true;
+			break;
+		}
+
+		if (strncmp(response, "ok ", 3) == 0) {
+			state->sent += state->batch;
+		} else if (strcmp(response, "error busy") == 0) {
+			// 描画スレッドが追いつくまで待つ
+			state->busy++;
+			nanosleep(&(struct timespec){0, 1000000}, NULL);
+		} else {
+			fprintf(stderr, "unexpected response: %s\n", response);
+			state->failed = true;
+			break;
+		}
+	}
+
+	dstr_free(&line);
+	close(fd);
+	os_atomic_set_bool(&state->done, true);
+	return NULL;
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a;
+	uint64_t y = *(const uint64_t *)b;
+	return x < y ? -1 : x > y;
+}
+
+static uint64_t thread_cpu_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void sleep_until(uint64_t deadline_ns)
+{
+	uint64_t now = os_gettime_ns();
+	if (now >= deadline_ns)
+		return;
+
+	uint64_t wait = deadline_ns - now;
+	struct timespec ts = {(time_t)(wait / 1000000000ULL), (long)(wait % 1000000000ULL)};
+	nanosleep(&ts, NULL);
+}
+
+int main(int argc, char **argv)
+{
+	struct client_state state = {0};
+	state.commands = DEFAULT_COMMANDS;
+	state.batch = DEFAULT_BATCH;
+	uint64_t budget_us = DEFAULT_BUDGET_US;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--commands") == 0 && i + 1 < argc) {
+			state.commands = strtoull(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+			state.batch = strtoull(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "--budget-us") == 0 && i + 1 < argc) {
+			budget_us = strtoull(argv[++i], NULL, 10);
+		} else {
+			fprintf(stderr, "usage: %s [--commands N] [--batch N] [--budget-us N]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (!state.batch || state.batch > 256)
+		state.batch = DEFAULT_BATCH;
+	if (state.commands < state.batch)
+		state.commands = state.batch;
+
+	char path[64];
+	snprintf(path, sizeof(path), "/tmp/match-counter-bench-%ld.sock", (long)getpid());
+	state.path = path;
+
+	match_counter_registry_init();
+	match_counter_shared_t *shared = match_counter_registry_acquire(COUNTER_ID, NULL, 0, 0, NULL);
+	match_counter_t *counter = match_counter_shared_get_counter(shared);
+	match_counter_shared_subscribe(shared, counter_changed, NULL);
+
+	if (!match_counter_control_start(path)) {
+		fprintf(stderr, "failed to start control socket at %s\n", path);
+		return 1;
+	}
+
+	pthread_t client;
+	pthread_create(&client, NULL, client_main, &state);
+
+	size_t capacity = 1024;
+	size_t frames = 0;
+	uint64_t *work = malloc(sizeof(uint64_t) * capacity);
+	uint64_t *cpu = malloc(sizeof(uint64_t) * capacity);
+	uint64_t loop_start = os_gettime_ns();
+	uint64_t deadline = loop_start;
+
+	// クライアントが送り終えた後も、積み残しがなくなるまでフレームを回す
+	for (;;) {
+		bool done = os_atomic_load_bool(&state.done);
+
+		uint64_t start = os_gettime_ns();
+		uint64_t cpu_start = thread_cpu_ns();
+		match_counter_control_tick();
+		match_counter_registry_drain_all();
+		uint64_t cpu_elapsed = thread_cpu_ns() - cpu_start;
+		uint64_t elapsed = os_gettime_ns() - start;
+
+		if (frames == capacity) {
+			capacity *= 2;
+			work = realloc(work, sizeof(uint64_t) * capacity);
+			cpu = realloc(cpu, sizeof(uint64_t) * capacity);
+		}
+		cpu[frames] = cpu_elapsed;
+		work[frames++] = elapsed;
+
+		uint64_t applied = (uint64_t)match_counter_get_wins(counter) +
+				   (uint64_t)match_counter_get_losses(counter);
+		if (done && (state.failed || applied >= state.sent))
+			break;
+
+		deadline += FRAME_NS;
+		sleep_until(deadline);
+	}
+
+	uint64_t loop_ns = os_gettime_ns() - loop_start;
+	pthread_join(client, NULL);
+
+	uint64_t applied = (uint64_t)match_counter_get_wins(counter) + (uint64_t)match_counter_get_losses(counter);
+
+	uint64_t late = 0;
+	for (size_t i = 0; i < frames; i++)
+		late += work[i] > budget_us * 1000;
+	qsort(work, frames, sizeof(uint64_t), compare_u64);
+	qsort(cpu, frames, sizeof(uint64_t), compare_u64);
+
+	// 受け付けた数ではなく、描画スレッドで実際に適用された数で測る
+	double seconds = (double)loop_ns / 1e9;
+	printf("{\"name\":\"control/batch%llu\",\"commands\":%llu,\"applied\":%llu,\"applied_per_sec\":%.0f,"
+	       "\"busy_retries\":%llu,\"frames\":%zu,\"frame_work_p50_us\":%.1f,\"frame_work_p99_us\":%.1f,"
+	       "\"frame_work_max_us\":%.1f,\"frame_cpu_p99_us\":%.1f,\"frame_cpu_max_us\":%.1f,\"budget_us\":%llu,"
+	       "\"late_frames\":%llu}\n",
+	       (unsigned long long)state.batch, (unsigned long long)state.sent, (unsigned long long)applied,
+	       seconds > 0 ? (double)applied / seconds : 0.0, (unsigned long long)state.busy, frames,
+	       (double)work[(frames - 1) / 2] / 1000.0, (double)work[(frames - 1) * 99 / 100] / 1000.0,
+	       (double)work[frames - 1] / 1000.0, (double)cpu[(frames - 1) * 99 / 100] / 1000.0,
+	       (double)cpu[frames - 1] / 1000.0, (unsigned long long)budget_us, (unsigned long long)late);
+
+	free(cpu);
+	free(work);
+	match_counter_control_stop();
+	match_counter_shared_unsubscribe(shared, counter_changed, NULL);
+	match_counter_registry_release(shared, false);
+	match_counter_registry_free();
+
+	return state.failed || applied != state.sent;
+}
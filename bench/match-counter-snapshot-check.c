@@ -0,0 +1,157 @@
+/*
+Match Counter for OBS
+Copyright (C) 2025 Yudai Udagawa
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+/*
+ * 勝敗数のスナップショットが途中の状態を読まないことを確かめるマルチスレッドのチェック
+ *
+ * 書き込みスレッドはそれぞれ「勝利を追加・敗北を追加・敗北を取り消し・勝利を取り消し」を繰り返す。
+ * 各スレッドの寄与は常に勝利数が敗北数と同じか1多いだけなので、一貫した組なら
+ * 0 <= 敗北数 <= 勝利数 <= 書き込みスレッド数 が成り立つ。
+ * 読み込みスレッド（メインスレッド）はスナップショットを取り続け、この関係と、
+ * 世代番号が戻らず、完了した操作の数と開始した操作の数の間に収まっていることを確かめる。
+ * 結果は1行1件のJSON（NDJSON）で標準出力に書き出し、不整合があれば終了コードを1にする。
+ *   match-counter-snapshot-check [--writers N] [--ops N]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include "match-counter.h"
+#include "match-counter-atomic.h"
+
+#define DEFAULT_WRITERS 4
+#define DEFAULT_OPS 1000000
+#define MAX_WRITERS 64
+
+struct check_state {
+	match_counter_t *counter;
+	uint64_t ops; // 書き込みスレッドごとの操作の数（4の倍数）
+	volatile uint64_t started;
+	volatile uint64_t completed;
+	volatile long running;
+};
+
+// 操作を1つ行い、前後で開始・完了の数を進める
+static void check_apply(struct check_state *state, bool (*op)(match_counter_t *))
+{
+	match_counter_atomic_inc_u64(&state->started);
+	if (!op(state->counter)) {
+		fprintf(stderr, "operation unexpectedly failed\n");
+		abort();
+	}
+	match_counter_atomic_inc_u64(&state->completed);
+}
+
+static void *writer_main(void *data)
+{
+	struct check_state *state = data;
+
+	for (uint64_t i = 0; i < state->ops; i += 4) {
+		check_apply(state, match_counter_add_win);
+		check_apply(state, match_counter_add_loss);
+		check_apply(state, match_counter_subtract_loss);
+		check_apply(state, match_counter_subtract_win);
+	}
+
+	os_atomic_dec_long(&state->running);
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	struct check_state state = {0};
+	state.ops = DEFAULT_OPS;
+	long writers = DEFAULT_WRITERS;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--writers") == 0 && i + 1 < argc) {
+			writers = strtol(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "--ops") == 0 && i + 1 < argc) {
+			state.ops = strtoull(argv[++i], NULL, 10);
+		} else {
+			fprintf(stderr, "usage: %s [--writers N] [--ops N]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (writers < 1 || writers > MAX_WRITERS)
+		writers = DEFAULT_WRITERS;
+	state.ops = (state.ops + 3) / 4 * 4;
+
+	state.counter = match_counter_create();
+	uint64_t base_generation = match_counter_get_generation(state.counter);
+	state.running = writers;
+
+	pthread_t threads[MAX_WRITERS];
+	for (long i = 0; i < writers; i++)
+		pthread_create(&threads[i], NULL, writer_main, &state);
+
+	uint64_t snapshots = 0;
+	uint64_t torn = 0;
+	uint64_t generation_errors = 0;
+	uint64_t last_generation = base_generation;
+	uint64_t start = os_gettime_ns();
+
+	// 書き込みスレッドがすべて終わった後の最終状態も1回確かめる
+	for (bool last = false; !last;) {
+		last = os_atomic_load_long(&state.running) == 0;
+
+		uint64_t completed = match_counter_atomic_load_u64(&state.completed);
+		match_counter_snapshot_t snapshot;
+		match_counter_get_snapshot(state.counter, &snapshot);
+		uint64_t started = match_counter_atomic_load_u64(&state.started);
+		snapshots++;
+
+		if (snapshot.losses < 0 || snapshot.losses > snapshot.wins || snapshot.wins > writers) {
+			if (!torn++)
+				fprintf(stderr, "torn snapshot: wins=%d losses=%d\n", snapshot.wins, snapshot.losses);
+		}
+
+		if (snapshot.generation < last_generation || snapshot.generation < base_generation + completed ||
+		    snapshot.generation > base_generation + started) {
+			if (!generation_errors++)
+				fprintf(stderr, "bad generation: %llu (last %llu, completed %llu, started %llu)\n",
+					(unsigned long long)snapshot.generation, (unsigned long long)last_generation,
+					(unsigned long long)(base_generation + completed),
+					(unsigned long long)(base_generation + started));
+		}
+		last_generation = snapshot.generation;
+	}
+
+	uint64_t elapsed = os_gettime_ns() - start;
+
+	for (long i = 0; i < writers; i++)
+		pthread_join(threads[i], NULL);
+
+	// すべての操作が取り消し済みなので0勝0敗に戻り、世代番号は操作の数だけ進んでいる
+	match_counter_snapshot_t final_snapshot;
+	match_counter_get_snapshot(state.counter, &final_snapshot);
+	bool final_ok = final_snapshot.wins == 0 && final_snapshot.losses == 0 &&
+			final_snapshot.generation == base_generation + (uint64_t)writers * state.ops;
+
+	printf("{\"name\":\"snapshot/tearing\",\"writers\":%ld,\"ops\":%llu,\"snapshots\":%llu,"
+	       "\"ns_per_snapshot\":%.2f,\"torn\":%llu,\"generation_errors\":%llu,\"final_ok\":%s}\n",
+	       writers, (unsigned long long)((uint64_t)writers * state.ops), (unsigned long long)snapshots,
+	       (double)elapsed / (double)snapshots, (unsigned long long)torn, (unsigned long long)generation_errors,
+	       final_ok ? "true" : "false");
+
+	match_counter_destroy(state.counter);
+	return torn || generation_errors || !final_ok;
+}
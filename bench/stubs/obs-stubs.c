@@ -0,0 +1,262 @@
+/*
+Match Counter for OBS
+Copyright (C) 2025 Yudai Udagawa
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <util/base.h>
+#include <util/bmem.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+#include <util/threading.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+static uint64_t num_allocs = 0;
+
+void *bmalloc(size_t size)
+{
+	num_allocs++;
+	void *ptr = malloc(size ? size : 1);
+	if (!ptr) {
+		fprintf(stderr, "Out of memory while trying to allocate %zu bytes\n", size);
+		abort();
+	}
+	return ptr;
+}
+
+void *brealloc(void *ptr, size_t size)
+{
+	num_allocs++;
+	ptr = realloc(ptr, size ? size : 1);
+	if (!ptr) {
+		fprintf(stderr, "Out of memory while trying to allocate %zu bytes\n", size);
+		abort();
+	}
+	return ptr;
+}
+
+void bfree(void *ptr)
+{
+	free(ptr);
+}
+
+uint64_t bnum_allocs(void)
+{
+	return num_allocs;
+}
+
+void blog(int log_level, const char *format, ...)
+{
+	UNUSED_PARAMETER(log_level);
+	UNUSED_PARAMETER(format);
+}
+
+uint64_t os_gettime_ns(void)
+{
+#ifdef _WIN32
+	static LARGE_INTEGER frequency = {0};
+	LARGE_INTEGER counter;
+
+	if (!frequency.QuadPart)
+		QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+	return (uint64_t)((double)counter.QuadPart * 1000000000.0 / (double)frequency.QuadPart);
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+FILE *os_fopen(const char *path, const char *mode)
+{
+	return fopen(path, mode);
+}
+
+int os_rename(const char *old_path, const char *new_path)
+{
+	return rename(old_path, new_path);
+}
+
+int os_unlink(const char *path)
+{
+	return remove(path);
+}
+
+void os_set_thread_name(const char *name)
+{
+	UNUSED_PARAMETER(name);
+}
+
+#ifdef _WIN32
+struct thread_start {
+	void *(*start_routine)(void *);
+	void *arg;
+};
+
+static DWORD WINAPI thread_main(LPVOID data)
+{
+	struct thread_start start = *(struct thread_start *)data;
+	bfree(data);
+	start.start_routine(start.arg);
+	return 0;
+}
+
+int pthread_create(pthread_t *thread, const void *attr, void *(*start_routine)(void *), void *arg)
+{
+	UNUSED_PARAMETER(attr);
+	struct thread_start *start = bmalloc(sizeof(struct thread_start));
+	start->start_routine = start_routine;
+	start->arg = arg;
+
+	*thread = CreateThread(NULL, 0, thread_main, start, 0, NULL);
+	if (!*thread) {
+		bfree(start);
+		return -1;
+	}
+	return 0;
+}
+
+int pthread_join(pthread_t thread, void **value)
+{
+	if (value)
+		*value = NULL;
+	WaitForSingleObject(thread, INFINITE);
+	CloseHandle(thread);
+	return 0;
+}
+
+struct os_sem_data {
+	HANDLE handle;
+};
+
+int os_sem_init(os_sem_t **sem, int value)
+{
+	HANDLE handle = CreateSemaphore(NULL, (LONG)value, 0x7FFFFFFF, NULL);
+	if (!handle)
+		return -1;
+
+	*sem = bzalloc(sizeof(os_sem_t));
+	(*sem)->handle = handle;
+	return 0;
+}
+
+void os_sem_destroy(os_sem_t *sem)
+{
+	if (!sem)
+		return;
+
+	CloseHandle(sem->handle);
+	bfree(sem);
+}
+
+int os_sem_post(os_sem_t *sem)
+{
+	return ReleaseSemaphore(sem->handle, 1, NULL) ? 0 : -1;
+}
+
+int os_sem_wait(os_sem_t *sem)
+{
+	return WaitForSingleObject(sem->handle, INFINITE) == WAIT_OBJECT_0 ? 0 : -1;
+}
+#else
+struct os_sem_data {
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	int value;
+};
+
+int os_sem_init(os_sem_t **sem, int value)
+{
+	os_sem_t *data = bzalloc(sizeof(os_sem_t));
+	pthread_mutex_init(&data->mutex, NULL);
+	pthread_cond_init(&data->cond, NULL);
+	data->value = value;
+	*sem = data;
+	return 0;
+}
+
+void os_sem_destroy(os_sem_t *sem)
+{
+	if (!sem)
+		return;
+
+	pthread_cond_destroy(&sem->cond);
+	pthread_mutex_destroy(&sem->mutex);
+	bfree(sem);
+}
+
+int os_sem_post(os_sem_t *sem)
+{
+	pthread_mutex_lock(&sem->mutex);
+	sem->value++;
+	pthread_cond_signal(&sem->cond);
+	pthread_mutex_unlock(&sem->mutex);
+	return 0;
+}
+
+int os_sem_wait(os_sem_t *sem)
+{
+	pthread_mutex_lock(&sem->mutex);
+	while (!sem->value)
+		pthread_cond_wait(&sem->cond, &sem->mutex);
+	sem->value--;
+	pthread_mutex_unlock(&sem->mutex);
+	return 0;
+}
+#endif
+
+void dstr_vprintf(struct dstr *dst, const char *format, va_list args)
+{
+	dstr_copy(dst, "");
+
+	va_list copy;
+	va_copy(copy, args);
+	int len = vsnprintf(NULL, 0, format, copy);
+	va_end(copy);
+	if (len <= 0)
+		return;
+
+	dstr_ensure_capacity(dst, (size_t)len + 1);
+	vsnprintf(dst->array, (size_t)len + 1, format, args);
+	dst->len = (size_t)len;
+}
+
+void dstr_printf(struct dstr *dst, const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	dstr_vprintf(dst, format, args);
+	va_end(args);
+}
+
+void dstr_catf(struct dstr *dst, const char *format, ...)
+{
+	struct dstr text = {0};
+	va_list args;
+	va_start(args, format);
+	dstr_vprintf(&text, format, args);
+	va_end(args);
+
+	dstr_ncat(dst, text.array, text.len);
+	dstr_free(&text);
+}
@@ -0,0 +1,66 @@
+/*
+Match Counter for OBS
+Copyright (C) 2025 Yudai Udagawa
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include <string.h>
+#include "c99defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void *bmalloc(size_t size);
+void *brealloc(void *ptr, size_t size);
+void bfree(void *ptr);
+
+/**
+ * bmalloc/breallocが呼ばれた回数を取得する（ベンチマークの確保回数の計測用）
+ */
+uint64_t bnum_allocs(void);
+
+static inline void *bzalloc(size_t size)
+{
+	void *mem = bmalloc(size);
+	if (mem)
+		memset(mem, 0, size);
+	return mem;
+}
+
+static inline char *bstrdup_n(const char *str, size_t n)
+{
+	if (!str)
+		return NULL;
+
+	char *dup = (char *)bmalloc(n + 1);
+	memcpy(dup, str, n);
+	dup[n] = 0;
+	return dup;
+}
+
+static inline char *bstrdup(const char *str)
+{
+	if (!str)
+		return NULL;
+
+	return bstrdup_n(str, strlen(str));
+}
+
+#ifdef __cplusplus
+}
+#endif
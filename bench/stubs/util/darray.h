@@ -0,0 +1,137 @@
+/*
+Match Counter for OBS
+Copyright (C) 2025 Yudai Udagawa
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include "bmem.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DARRAY_INVALID ((size_t)-1)
+
+struct darray {
+	void *array;
+	size_t num;
+	size_t capacity;
+};
+
+#define DARRAY(type)                     \
+	union {                          \
+		struct darray da;        \
+		struct {                 \
+			type *array;     \
+			size_t num;      \
+			size_t capacity; \
+		};                       \
+	}
+
+static inline void darray_init(struct darray *dst)
+{
+	dst->array = NULL;
+	dst->num = 0;
+	dst->capacity = 0;
+}
+
+static inline void darray_free(struct darray *dst)
+{
+	bfree(dst->array);
+	darray_init(dst);
+}
+
+static inline void darray_ensure_capacity(const size_t element_size, struct darray *dst, const size_t new_size)
+{
+	if (new_size <= dst->capacity)
+		return;
+
+	size_t new_cap = !dst->capacity ? new_size : dst->capacity * 2;
+	if (new_size > new_cap)
+		new_cap = new_size;
+
+	dst->array = brealloc(dst->array, element_size * new_cap);
+	dst->capacity = new_cap;
+}
+
+static inline void darray_resize(const size_t element_size, struct darray *dst, const size_t size)
+{
+	darray_ensure_capacity(element_size, dst, size);
+	dst->num = size;
+}
+
+static inline size_t darray_push_back(const size_t element_size, struct darray *dst, const void *item)
+{
+	darray_ensure_capacity(element_size, dst, dst->num + 1);
+	memcpy((uint8_t *)dst->array + element_size * dst->num, item, element_size);
+	return dst->num++;
+}
+
+static inline void *darray_push_back_new(const size_t element_size, struct darray *dst)
+{
+	darray_ensure_capacity(element_size, dst, dst->num + 1);
+	void *last = (uint8_t *)dst->array + element_size * dst->num++;
+	memset(last, 0, element_size);
+	return last;
+}
+
+static inline size_t darray_push_back_array(const size_t element_size, struct darray *dst, const void *array,
+					    const size_t num)
+{
+	size_t old_num = dst->num;
+	if (!array || !num)
+		return old_num;
+
+	darray_resize(element_size, dst, old_num + num);
+	memcpy((uint8_t *)dst->array + element_size * old_num, array, element_size * num);
+	return old_num;
+}
+
+static inline void darray_erase(const size_t element_size, struct darray *dst, const size_t idx)
+{
+	if (idx >= dst->num || !--dst->num)
+		return;
+
+	memmove((uint8_t *)dst->array + element_size * idx, (uint8_t *)dst->array + element_size * (idx + 1),
+		element_size * (dst->num - idx));
+}
+
+static inline size_t darray_find(const size_t element_size, const struct darray *da, const void *item,
+				 const size_t idx)
+{
+	for (size_t i = idx; i < da->num; i++) {
+		if (memcmp((uint8_t *)da->array + element_size * i, item, element_size) == 0)
+			return i;
+	}
+	return DARRAY_INVALID;
+}
+
+#define da_init(v) darray_init(&(v).da)
+#define da_free(v) darray_free(&(v).da)
+#define da_clear(v) ((v).num = 0)
+#define da_reserve(v, capacity) darray_ensure_capacity(sizeof(*(v).array), &(v).da, capacity)
+#define da_resize(v, size) darray_resize(sizeof(*(v).array), &(v).da, size)
+#define da_push_back(v, item) darray_push_back(sizeof(*(v).array), &(v).da, item)
+#define da_push_back_new(v) darray_push_back_new(sizeof(*(v).array), &(v).da)
+#define da_push_back_array(v, src, n) darray_push_back_array(sizeof(*(v).array), &(v).da, src, n)
+#define da_erase(v, idx) darray_erase(sizeof(*(v).array), &(v).da, idx)
+#define da_find(v, item, idx) darray_find(sizeof(*(v).array), &(v).da, item, idx)
+#define da_erase_item(v, item) da_erase(v, da_find(v, item, 0))
+
+#ifdef __cplusplus
+}
+#endif
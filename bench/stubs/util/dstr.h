@@ -0,0 +1,95 @@
+/*
+Match Counter for OBS
+Copyright (C) 2025 Yudai Udagawa
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include "bmem.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct dstr {
+	char *array;
+	size_t len;
+	size_t capacity;
+};
+
+static inline void dstr_init(struct dstr *dst)
+{
+	dst->array = NULL;
+	dst->len = 0;
+	dst->capacity = 0;
+}
+
+static inline void dstr_free(struct dstr *dst)
+{
+	bfree(dst->array);
+	dstr_init(dst);
+}
+
+static inline void dstr_ensure_capacity(struct dstr *dst, const size_t new_size)
+{
+	if (new_size <= dst->capacity)
+		return;
+
+	size_t new_cap = !dst->capacity ? new_size : dst->capacity * 2;
+	if (new_size > new_cap)
+		new_cap = new_size;
+
+	dst->array = (char *)brealloc(dst->array, new_cap);
+	dst->capacity = new_cap;
+}
+
+static inline void dstr_ncat(struct dstr *dst, const char *array, const size_t len)
+{
+	if (!array || !len)
+		return;
+
+	dstr_ensure_capacity(dst, dst->len + len + 1);
+	memcpy(dst->array + dst->len, array, len);
+	dst->len += len;
+	dst->array[dst->len] = 0;
+}
+
+static inline void dstr_cat(struct dstr *dst, const char *array)
+{
+	if (array)
+		dstr_ncat(dst, array, strlen(array));
+}
+
+static inline void dstr_copy(struct dstr *dst, const char *array)
+{
+	dst->len = 0;
+	if (dst->array)
+		dst->array[0] = 0;
+	dstr_cat(dst, array);
+}
+
+void dstr_vprintf(struct dstr *dst, const char *format, va_list args);
+void dstr_printf(struct dstr *dst, const char *format, ...);
+void dstr_catf(struct dstr *dst, const char *format, ...);
+
+static inline bool dstr_is_empty(const struct dstr *str)
+{
+	return !str->array || !str->len || !*str->array;
+}
+
+#ifdef __cplusplus
+}
+#endif
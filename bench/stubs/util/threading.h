@@ -0,0 +1,149 @@
+/*
+Match Counter for OBS
+Copyright (C) 2025 Yudai Udagawa
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include "c99defs.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef _WIN32
+// libobsはWindowsでもw32-pthreadsを使うが、ベンチマークではSRWLOCKで代用する
+typedef SRWLOCK pthread_mutex_t;
+
+static inline int pthread_mutex_init(pthread_mutex_t *mutex, const void *attr)
+{
+	UNUSED_PARAMETER(attr);
+	InitializeSRWLock(mutex);
+	return 0;
+}
+
+static inline int pthread_mutex_destroy(pthread_mutex_t *mutex)
+{
+	UNUSED_PARAMETER(mutex);
+	return 0;
+}
+
+static inline int pthread_mutex_lock(pthread_mutex_t *mutex)
+{
+	AcquireSRWLockExclusive(mutex);
+	return 0;
+}
+
+static inline int pthread_mutex_unlock(pthread_mutex_t *mutex)
+{
+	ReleaseSRWLockExclusive(mutex);
+	return 0;
+}
+
+static inline long os_atomic_inc_long(volatile long *val)
+{
+	return InterlockedIncrement(val);
+}
+
+static inline long os_atomic_dec_long(volatile long *val)
+{
+	return InterlockedDecrement(val);
+}
+
+static inline long os_atomic_set_long(volatile long *ptr, long val)
+{
+	return InterlockedExchange(ptr, val);
+}
+
+static inline long os_atomic_load_long(const volatile long *ptr)
+{
+	return InterlockedCompareExchange((volatile long *)ptr, 0, 0);
+}
+
+static inline bool os_atomic_compare_swap_long(volatile long *val, long old_val, long new_val)
+{
+	return InterlockedCompareExchange(val, new_val, old_val) == old_val;
+}
+
+static inline bool os_atomic_set_bool(volatile bool *ptr, bool val)
+{
+	return !!_InterlockedExchange8((volatile char *)ptr, (char)val);
+}
+
+static inline bool os_atomic_load_bool(const volatile bool *ptr)
+{
+	return !!_InterlockedCompareExchange8((volatile char *)ptr, 0, 0);
+}
+
+// 書き込みスレッドの起動用（obs-stubs.cでCreateThreadを使って実装する）
+typedef HANDLE pthread_t;
+
+int pthread_create(pthread_t *thread, const void *attr, void *(*start_routine)(void *), void *arg);
+int pthread_join(pthread_t thread, void **value);
+#else
+static inline long os_atomic_inc_long(volatile long *val)
+{
+	return __atomic_add_fetch(val, 1, __ATOMIC_SEQ_CST);
+}
+
+static inline long os_atomic_dec_long(volatile long *val)
+{
+	return __atomic_sub_fetch(val, 1, __ATOMIC_SEQ_CST);
+}
+
+static inline long os_atomic_set_long(volatile long *ptr, long val)
+{
+	return __atomic_exchange_n(ptr, val, __ATOMIC_SEQ_CST);
+}
+
+static inline long os_atomic_load_long(const volatile long *ptr)
+{
+	return __atomic_load_n(ptr, __ATOMIC_SEQ_CST);
+}
+
+static inline bool os_atomic_compare_swap_long(volatile long *val, long old_val, long new_val)
+{
+	return __atomic_compare_exchange_n(val, &old_val, new_val, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+static inline bool os_atomic_set_bool(volatile bool *ptr, bool val)
+{
+	return __atomic_exchange_n(ptr, val, __ATOMIC_SEQ_CST);
+}
+
+static inline bool os_atomic_load_bool(const volatile bool *ptr)
+{
+	return __atomic_load_n(ptr, __ATOMIC_SEQ_CST);
+}
+#endif
+
+// 書き込みスレッドを起こすためのセマフォ（obs-stubs.cで実装する）
+typedef struct os_sem_data os_sem_t;
+
+int os_sem_init(os_sem_t **sem, int value);
+void os_sem_destroy(os_sem_t *sem);
+int os_sem_post(os_sem_t *sem);
+int os_sem_wait(os_sem_t *sem);
+
+#ifdef __cplusplus
+}
+#endif
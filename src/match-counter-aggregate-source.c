@@ -0,0 +1,492 @@
+/*
+Match Counter for OBS
+Copyright (C) 2025 Yudai Udagawa
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include <obs-module.h>
+#include <util/darray.h>
+#include <util/threading.h>
+#include "match-counter.h"
+#include "match-counter-atomic.h"
+#include "match-counter-registry.h"
+#include "match-counter-text-pool.h"
+
+// 合計に含める共有カウンター1つ分
+struct match_counter_aggregate_member {
+	struct MatchCounterAggregateSource *context;
+	char *id;
+	match_counter_shared_t *shared; // IDのカウンターを表示するソースがなければNULL
+	int wins;                       // 合計に反映済みの勝利数（context->mutexで保護する）
+	int losses;                     // 合計に反映済みの敗北数（context->mutexで保護する）
+};
+
+struct MatchCounterAggregateSource {
+	obs_source_t *source;
+
+	// メンバーの勝敗数の合計（ジャーナルは持たず、メンバーの変化の差分だけで更新する）
+	match_counter_t *counter;
+	pthread_mutex_t mutex; // 各メンバーからの通知による更新を直列化する
+
+	// members_mutexで保護する（共有カウンターが作られたときの通知からも変更される）
+	pthread_mutex_t members_mutex;
+	DARRAY(struct match_counter_aggregate_member *) members;
+
+	match_counter_format_t *format;
+
+	// 合計が変わったときだけテクスチャに描き直す
+	match_counter_text_renderer_t *text_renderer;
+	gs_texrender_t *texrender;
+	char *font_name;
+	uint16_t font_size;
+	uint32_t font_flags;
+	volatile uint64_t extents; // get_width/get_height用に公開する大きさ（上位32bitが幅、下位32bitが高さ）
+	uint32_t cx;
+	uint32_t cy;
+	uint64_t rendered_generation;
+	bool text_dirty;
+	bool font_dirty;
+};
+
+static const char *match_counter_aggregate_get_name(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return obs_module_text("MatchCounterAggregateSource");
+}
+
+// 勝敗数だけを増減する（context->mutexを保持して呼ぶ）
+// メンバーの追加・削除や勝敗数の直接設定は試合ではないため、連勝数や直近N試合の集計には含めない
+static void match_counter_aggregate_adjust(struct MatchCounterAggregateSource *context, int delta_wins,
+					   int delta_losses)
+{
+	match_counter_t *counter = context->counter;
+
+	if (delta_wins)
+		match_counter_set_wins(counter, match_counter_get_wins(counter) + delta_wins);
+	if (delta_losses)
+		match_counter_set_losses(counter, match_counter_get_losses(counter) + delta_losses);
+}
+
+// メンバーに操作が1つ適用された（エントリのロックを保持したまま、操作を適用したスレッドから呼ばれる）
+// 試合の結果はそのまま合計にも適用し、他のメンバーは読み直さない
+static void match_counter_aggregate_member_event(void *data, enum match_counter_journal_event event,
+						 int64_t timestamp_ms, int wins, int losses)
+{
+	UNUSED_PARAMETER(timestamp_ms);
+	struct match_counter_aggregate_member *member = data;
+	struct MatchCounterAggregateSource *context = member->context;
+
+	pthread_mutex_lock(&context->mutex);
+
+	switch (event) {
+	case MATCH_COUNTER_JOURNAL_WIN:
+		match_counter_add_win(context->counter);
+		break;
+	case MATCH_COUNTER_JOURNAL_LOSS:
+		match_counter_add_loss(context->counter);
+		break;
+	case MATCH_COUNTER_JOURNAL_UNDO_WIN:
+		match_counter_subtract_win(context->counter);
+		break;
+	case MATCH_COUNTER_JOURNAL_UNDO_LOSS:
+		match_counter_subtract_loss(context->counter);
+		break;
+	default:
+		// 登録した時点の勝敗数（SNAPSHOT）・リセット・直接設定は前回からの差分だけを加える
+		match_counter_aggregate_adjust(context, wins - member->wins, losses - member->losses);
+		break;
+	}
+
+	member->wins = wins;
+	member->losses = losses;
+
+	pthread_mutex_unlock(&context->mutex);
+}
+
+// 参照を取った共有カウンターをメンバーに結び付ける（現在の勝敗数は最初の通知で合計に加わる）
+static void match_counter_aggregate_attach(struct match_counter_aggregate_member *member,
+					   match_counter_shared_t *shared)
+{
+	member->shared = shared;
+	match_counter_shared_listen_current(shared, match_counter_aggregate_member_event, member);
+}
+
+// 共有カウンターとの結び付きを外し、反映済みの勝敗数を合計から引いて参照を手放す（members_mutexを保持して呼ぶ）
+static void match_counter_aggregate_detach(struct match_counter_aggregate_member *member)
+{
+	struct MatchCounterAggregateSource *context = member->context;
+
+	// 登録を解除した後は通知が来ないため、最後に反映した値を合計から引けばよい
+	match_counter_shared_unlisten(member->shared, match_counter_aggregate_member_event, member);
+
+	pthread_mutex_lock(&context->mutex);
+	match_counter_aggregate_adjust(context, -member->wins, -member->losses);
+	member->wins = 0;
+	member->losses = 0;
+	pthread_mutex_unlock(&context->mutex);
+
+	match_counter_registry_release(member->shared, false);
+	member->shared = NULL;
+}
+
+// IDのカウンターを表示するソースがあれば結び付け、なくなっていれば外す（members_mutexを保持して呼ぶ）
+// 合計ソースの参照だけでエントリが残り続けないよう、購読者のいないカウンターの参照は持たない
+static void match_counter_aggregate_sync_member(struct match_counter_aggregate_member *member)
+{
+	if (member->shared) {
+		if (!match_counter_shared_has_subscribers(member->shared))
+			match_counter_aggregate_detach(member);
+		return;
+	}
+
+	// 共有カウンターは作らない（まだなければ、IDのソースが購読したときに結び付ける）
+	match_counter_shared_t *shared = match_counter_registry_find(member->id);
+	if (shared && match_counter_shared_has_subscribers(shared))
+		match_counter_aggregate_attach(member, shared);
+	else
+		match_counter_registry_release(shared, false);
+}
+
+// members_mutexを保持して呼ぶ
+static void match_counter_aggregate_add_member(struct MatchCounterAggregateSource *context, const char *counter_id)
+{
+	struct match_counter_aggregate_member *member = bzalloc(sizeof(struct match_counter_aggregate_member));
+	member->context = context;
+	member->id = bstrdup(counter_id);
+	da_push_back(context->members, &member);
+
+	match_counter_aggregate_sync_member(member);
+}
+
+// members_mutexを保持して呼ぶ
+static void match_counter_aggregate_remove_member(struct MatchCounterAggregateSource *context, size_t index)
+{
+	struct match_counter_aggregate_member *member = context->members.array[index];
+	da_erase(context->members, index);
+
+	if (member->shared)
+		match_counter_aggregate_detach(member);
+
+	bfree(member->id);
+	bfree(member);
+}
+
+// 共有カウンターに最初の購読者が付いたか、最後の購読者が外れた（購読・解除したスレッドから呼ばれる）
+// 通知の順序は入れ替わることがあるため、そのIDのメンバーを現在の状態に合わせ直す
+static void match_counter_aggregate_counter_changed(void *data, match_counter_shared_t *shared)
+{
+	struct MatchCounterAggregateSource *context = data;
+	const char *counter_id = match_counter_shared_get_id(shared);
+
+	pthread_mutex_lock(&context->members_mutex);
+
+	for (size_t i = 0; i < context->members.num; i++) {
+		struct match_counter_aggregate_member *member = context->members.array[i];
+		if (strcmp(member->id, counter_id) == 0) {
+			match_counter_aggregate_sync_member(member);
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&context->members_mutex);
+}
+
+static bool match_counter_aggregate_has_member(struct MatchCounterAggregateSource *context, const char *counter_id)
+{
+	for (size_t i = 0; i < context->members.num; i++) {
+		if (strcmp(context->members.array[i]->id, counter_id) == 0)
+			return true;
+	}
+	return false;
+}
+
+static bool match_counter_aggregate_list_contains(obs_data_array_t *ids, const char *counter_id)
+{
+	size_t count = obs_data_array_count(ids);
+	bool found = false;
+
+	for (size_t i = 0; i < count && !found; i++) {
+		obs_data_t *item = obs_data_array_item(ids, i);
+		found = strcmp(obs_data_get_string(item, "value"), counter_id) == 0;
+		obs_data_release(item);
+	}
+	return found;
+}
+
+// 一覧から外れたメンバーを引き、増えたメンバーを足す（変わらないメンバーは読み直さない）
+static void match_counter_aggregate_update_members(struct MatchCounterAggregateSource *context,
+						   obs_data_array_t *ids)
+{
+	pthread_mutex_lock(&context->members_mutex);
+
+	for (size_t i = context->members.num; i > 0; i--) {
+		if (!match_counter_aggregate_list_contains(ids, context->members.array[i - 1]->id))
+			match_counter_aggregate_remove_member(context, i - 1);
+	}
+
+	size_t count = obs_data_array_count(ids);
+	for (size_t i = 0; i < count; i++) {
+		obs_data_t *item = obs_data_array_item(ids, i);
+		const char *counter_id = obs_data_get_string(item, "value");
+
+		// 専用のカウンターは他のソースから参照できないため、IDのあるものだけを対象にする
+		if (counter_id && *counter_id && !match_counter_aggregate_has_member(context, counter_id))
+			match_counter_aggregate_add_member(context, counter_id);
+
+		obs_data_release(item);
+	}
+
+	pthread_mutex_unlock(&context->members_mutex);
+}
+
+static void match_counter_aggregate_update(void *data, obs_data_t *settings)
+{
+	struct MatchCounterAggregateSource *context = data;
+
+	if (match_counter_format_set(context->format, obs_data_get_string(settings, "format")))
+		context->text_dirty = true;
+
+	obs_data_t *font_obj = obs_data_get_obj(settings, "font");
+	const char *font_name = obs_data_get_string(font_obj, "face");
+	uint16_t font_size = (uint16_t)obs_data_get_int(font_obj, "size");
+	uint32_t font_flags = (uint32_t)obs_data_get_int(font_obj, "flags");
+
+	if (font_size <= 0)
+		font_size = 256;
+
+	if (!font_name || !strlen(font_name))
+		font_name = "Arial";
+
+	if (!context->font_name || strcmp(context->font_name, font_name) != 0 || context->font_size != font_size ||
+	    context->font_flags != font_flags) {
+		bfree(context->font_name);
+		context->font_name = bstrdup(font_name);
+		context->font_size = font_size;
+		context->font_flags = font_flags;
+		context->font_dirty = true;
+	}
+
+	obs_data_release(font_obj);
+
+	pthread_mutex_lock(&context->mutex);
+	match_counter_set_history_window(context->counter, (uint32_t)obs_data_get_int(settings, "history_window"));
+	pthread_mutex_unlock(&context->mutex);
+
+	obs_data_array_t *ids = obs_data_get_array(settings, "members");
+	match_counter_aggregate_update_members(context, ids);
+	obs_data_array_release(ids);
+}
+
+static void *match_counter_aggregate_create(obs_data_t *settings, obs_source_t *source)
+{
+	struct MatchCounterAggregateSource *context = bzalloc(sizeof(struct MatchCounterAggregateSource));
+	context->source = source;
+	context->counter = match_counter_create();
+	context->format = match_counter_format_create("%w-%l(%r)");
+	pthread_mutex_init(&context->mutex, NULL);
+	pthread_mutex_init(&context->members_mutex, NULL);
+	da_init(context->members);
+	context->text_dirty = true;
+
+	// メンバーのカウンターを表示するソースが現れたら結び付け、すべて削除されたら参照を手放す
+	match_counter_registry_watch(match_counter_aggregate_counter_changed, context);
+
+	match_counter_aggregate_update(context, settings);
+	return context;
+}
+
+static void match_counter_aggregate_destroy(void *data)
+{
+	struct MatchCounterAggregateSource *context = data;
+
+	match_counter_registry_unwatch(match_counter_aggregate_counter_changed, context);
+
+	pthread_mutex_lock(&context->members_mutex);
+	while (context->members.num)
+		match_counter_aggregate_remove_member(context, context->members.num - 1);
+	pthread_mutex_unlock(&context->members_mutex);
+	da_free(context->members);
+
+	obs_enter_graphics();
+	gs_texrender_destroy(context->texrender);
+	obs_leave_graphics();
+	match_counter_text_pool_release(context->text_renderer);
+
+	pthread_mutex_destroy(&context->mutex);
+	pthread_mutex_destroy(&context->members_mutex);
+	match_counter_format_destroy(context->format);
+	match_counter_destroy(context->counter);
+	bfree(context->font_name);
+	bfree(context);
+}
+
+// 合計のテキストを描画器で測り、テクスチャに写す（グラフィックスコンテキスト内で呼ぶ）
+static void match_counter_aggregate_refresh_text(struct MatchCounterAggregateSource *context)
+{
+	if (context->font_dirty || !context->text_renderer) {
+		match_counter_text_pool_release(context->text_renderer);
+		context->text_renderer =
+			match_counter_text_pool_acquire(context->font_name, context->font_size, context->font_flags);
+		context->font_dirty = false;
+	}
+
+	// メンバーからの通知は他のスレッドからも届くため、書式化の間は合計を更新させない
+	pthread_mutex_lock(&context->mutex);
+	context->rendered_generation = match_counter_get_generation(context->counter);
+	const char *text = match_counter_format_render(context->format, context->counter);
+	pthread_mutex_unlock(&context->mutex);
+
+	uint32_t cx = 0;
+	uint32_t cy = 0;
+	bool visible = context->text_renderer &&
+		       match_counter_text_renderer_prepare(context->text_renderer, text, &cx, &cy);
+
+	context->text_dirty = false;
+
+	if (visible) {
+		if (!context->texrender)
+			context->texrender = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+
+		gs_texrender_reset(context->texrender);
+		if (gs_texrender_begin(context->texrender, cx, cy)) {
+			struct vec4 clear_color;
+			vec4_zero(&clear_color);
+
+			gs_clear(GS_CLEAR_COLOR, &clear_color, 0.0f, 0);
+			gs_ortho(0.0f, (float)cx, 0.0f, (float)cy, -100.0f, 100.0f);
+
+			gs_blend_state_push();
+			gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
+			match_counter_text_renderer_render(context->text_renderer);
+			gs_blend_state_pop();
+
+			gs_texrender_end(context->texrender);
+		} else {
+			cx = 0;
+			cy = 0;
+		}
+	}
+
+	context->cx = cx;
+	context->cy = cy;
+	match_counter_atomic_store_u64(&context->extents, ((uint64_t)cx << 32) | cy);
+}
+
+static void match_counter_aggregate_video_tick(void *data, float seconds)
+{
+	UNUSED_PARAMETER(seconds);
+	struct MatchCounterAggregateSource *context = data;
+
+	// 合計が変わっていないフレームでは世代番号を読むだけで終わる
+	if (!obs_source_showing(context->source))
+		return;
+	if (!context->text_dirty && !context->font_dirty &&
+	    match_counter_get_generation(context->counter) == context->rendered_generation)
+		return;
+
+	obs_enter_graphics();
+	match_counter_aggregate_refresh_text(context);
+	obs_leave_graphics();
+}
+
+static void match_counter_aggregate_render(void *data, gs_effect_t *effect)
+{
+	UNUSED_PARAMETER(effect);
+	struct MatchCounterAggregateSource *context = data;
+
+	gs_texture_t *tex = context->texrender && context->cx ? gs_texrender_get_texture(context->texrender) : NULL;
+	if (!tex)
+		return;
+
+	gs_effect_t *default_effect = obs_get_base_effect(OBS_EFFECT_DEFAULT);
+	gs_effect_set_texture(gs_effect_get_param_by_name(default_effect, "image"), tex);
+	while (gs_effect_loop(default_effect, "Draw"))
+		gs_draw_sprite(tex, 0, context->cx, context->cy);
+}
+
+static void match_counter_aggregate_show(void *data)
+{
+	struct MatchCounterAggregateSource *context = data;
+
+	// 非表示の間の変化は反映していないため、次のtickで描き直す
+	context->text_dirty = true;
+}
+
+static uint32_t match_counter_aggregate_get_width(void *data)
+{
+	struct MatchCounterAggregateSource *context = data;
+	return (uint32_t)(match_counter_atomic_load_u64(&context->extents) >> 32);
+}
+
+static uint32_t match_counter_aggregate_get_height(void *data)
+{
+	struct MatchCounterAggregateSource *context = data;
+	return (uint32_t)match_counter_atomic_load_u64(&context->extents);
+}
+
+static obs_properties_t *match_counter_aggregate_get_properties(void *data, void *type_data)
+{
+	UNUSED_PARAMETER(data);
+	UNUSED_PARAMETER(type_data);
+
+	obs_properties_t *props = obs_properties_create();
+
+	// 合計するカウンターのID
+	obs_property_t *members = obs_properties_add_editable_list(props, "members", obs_module_text("Members"),
+								   OBS_EDITABLE_LIST_TYPE_STRINGS, NULL, NULL);
+	obs_property_set_long_description(members, obs_module_text("MembersTooltip"));
+
+	obs_properties_add_text(props, "format", obs_module_text("Format"), OBS_TEXT_MULTILINE);
+	obs_property_set_long_description(obs_properties_get(props, "format"), obs_module_text("FormatTooltip"));
+
+	obs_properties_add_int(props, "history_window", obs_module_text("HistoryWindow"), 1,
+			       MATCH_COUNTER_HISTORY_MAX_WINDOW, 1);
+
+	obs_properties_add_font(props, "font", obs_module_text("Font"));
+
+	return props;
+}
+
+static void match_counter_aggregate_get_defaults(void *type_data, obs_data_t *settings)
+{
+	UNUSED_PARAMETER(type_data);
+	obs_data_set_default_string(settings, "format", "%w-%l(%r)");
+	obs_data_set_default_int(settings, "history_window", MATCH_COUNTER_HISTORY_DEFAULT_WINDOW);
+
+	obs_data_t *font_obj = obs_data_create();
+	obs_data_set_string(font_obj, "face", "Arial");
+	obs_data_set_int(font_obj, "size", 256);
+	obs_data_set_int(font_obj, "flags", 0);
+	obs_data_set_default_obj(settings, "font", font_obj);
+	obs_data_release(font_obj);
+}
+
+struct obs_source_info match_counter_aggregate_source_info = {
+	.id = "match_counter_aggregate_source",
+	.type = OBS_SOURCE_TYPE_INPUT,
+	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_CUSTOM_DRAW | OBS_SOURCE_SRGB,
+	.icon_type = OBS_ICON_TYPE_TEXT,
+	.get_name = match_counter_aggregate_get_name,
+	.create = match_counter_aggregate_create,
+	.destroy = match_counter_aggregate_destroy,
+	.update = match_counter_aggregate_update,
+	.get_properties2 = match_counter_aggregate_get_properties,
+	.get_defaults2 = match_counter_aggregate_get_defaults,
+	.get_width = match_counter_aggregate_get_width,
+	.get_height = match_counter_aggregate_get_height,
+	.video_tick = match_counter_aggregate_video_tick,
+	.show = match_counter_aggregate_show,
+	.video_render = match_counter_aggregate_render,
+};
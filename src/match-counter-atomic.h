@@ -0,0 +1,94 @@
+/*
+Match Counter for OBS
+Copyright (C) 2025 Yudai Udagawa
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * libobsのos_atomic_*はlong（Windowsでは32bit）しか扱えないため、
+ * 勝敗数をまとめて公開するための64bitアトミック操作をここで定義する
+ */
+
+static inline uint64_t match_counter_atomic_load_u64(const volatile uint64_t *ptr)
+{
+#ifdef _MSC_VER
+	return (uint64_t)_InterlockedCompareExchange64((volatile __int64 *)ptr, 0, 0);
+#else
+	return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+#endif
+}
+
+static inline void match_counter_atomic_store_u64(volatile uint64_t *ptr, uint64_t val)
+{
+#ifdef _MSC_VER
+	_InterlockedExchange64((volatile __int64 *)ptr, (__int64)val);
+#else
+	__atomic_store_n(ptr, val, __ATOMIC_RELEASE);
+#endif
+}
+
+/**
+ * 値が*expectedと等しければdesiredに置き換える
+ * @return 置き換えた場合はtrue。失敗した場合は*expectedに現在の値が入る
+ */
+static inline bool match_counter_atomic_compare_exchange_u64(volatile uint64_t *ptr, uint64_t *expected,
+							     uint64_t desired)
+{
+#ifdef _MSC_VER
+	uint64_t prev = (uint64_t)_InterlockedCompareExchange64((volatile __int64 *)ptr, (__int64)desired,
+								(__int64)*expected);
+	if (prev == *expected)
+		return true;
+	*expected = prev;
+	return false;
+#else
+	return __atomic_compare_exchange_n(ptr, expected, desired, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+#endif
+}
+
+static inline uint64_t match_counter_atomic_inc_u64(volatile uint64_t *ptr)
+{
+#ifdef _MSC_VER
+	return (uint64_t)_InterlockedIncrement64((volatile __int64 *)ptr);
+#else
+	return __atomic_add_fetch(ptr, 1, __ATOMIC_ACQ_REL);
+#endif
+}
+
+static inline uint64_t match_counter_atomic_add_u64(volatile uint64_t *ptr, uint64_t val)
+{
+#ifdef _MSC_VER
+	return (uint64_t)_InterlockedExchangeAdd64((volatile __int64 *)ptr, (__int64)val) + val;
+#else
+	return __atomic_add_fetch(ptr, val, __ATOMIC_ACQ_REL);
+#endif
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,209 @@
+/*
+Match Counter for OBS
+Copyright (C) 2025 Yudai Udagawa
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include "match-counter-blend.h"
+#include <util/base.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MATCH_COUNTER_BLEND_SSE2
+#define MATCH_COUNTER_BLEND_AVX2
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define MATCH_COUNTER_TARGET_AVX2
+#else
+#define MATCH_COUNTER_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define MATCH_COUNTER_BLEND_NEON
+#include <arm_neon.h>
+#endif
+
+// d * (255 - a) / 255 を四捨五入した値（t = d * (255 - a) + 128 のとき (t + (t >> 8)) >> 8 で割り算を避ける）
+static inline uint8_t blend_scale(uint8_t d, uint8_t inv_alpha)
+{
+	uint32_t t = (uint32_t)d * inv_alpha + 128;
+	return (uint8_t)((t + (t >> 8)) >> 8);
+}
+
+static void blend_over_scalar(uint8_t *dst, const uint8_t *src, size_t count)
+{
+	for (size_t i = 0; i < count; i++, dst += 4, src += 4) {
+		uint8_t inv_alpha = (uint8_t)(255 - src[3]);
+
+		// 不正な（色がアルファより大きい）ピクセルでも桁あふれしないよう飽和させる
+		for (size_t c = 0; c < 4; c++) {
+			uint32_t value = (uint32_t)src[c] + blend_scale(dst[c], inv_alpha);
+			dst[c] = (uint8_t)(value > 255 ? 255 : value);
+		}
+	}
+}
+
+#ifdef MATCH_COUNTER_BLEND_SSE2
+// 16bitに広げた8画素分の d * inv / 255 を計算する
+static inline __m128i blend_scale_epi16(__m128i d, __m128i inv)
+{
+	__m128i t = _mm_add_epi16(_mm_mullo_epi16(d, inv), _mm_set1_epi16(128));
+	return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+static void blend_over_sse2(uint8_t *dst, const uint8_t *src, size_t count)
+{
+	const __m128i zero = _mm_setzero_si128();
+	size_t i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		__m128i s = _mm_loadu_si128((const __m128i *)(src + i * 4));
+		__m128i d = _mm_loadu_si128((const __m128i *)(dst + i * 4));
+
+		// 各画素のアルファを4バイトに広げ、255から引く
+		__m128i a = _mm_srli_epi32(s, 24);
+		a = _mm_or_si128(a, _mm_slli_epi32(a, 8));
+		a = _mm_or_si128(a, _mm_slli_epi32(a, 16));
+		__m128i inv = _mm_xor_si128(a, _mm_set1_epi32(-1));
+
+		__m128i lo = blend_scale_epi16(_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi8(inv, zero));
+		__m128i hi = blend_scale_epi16(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi8(inv, zero));
+		_mm_storeu_si128((__m128i *)(dst + i * 4), _mm_adds_epu8(s, _mm_packus_epi16(lo, hi)));
+	}
+
+	blend_over_scalar(dst + i * 4, src + i * 4, count - i);
+}
+
+MATCH_COUNTER_TARGET_AVX2 static inline __m256i blend_scale_epi16_avx2(__m256i d, __m256i inv)
+{
+	__m256i t = _mm256_add_epi16(_mm256_mullo_epi16(d, inv), _mm256_set1_epi16(128));
+	return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+}
+
+// unpackとpackは128bitのレーンごとに働くため、並びはSSE2版と同じく元に戻る
+MATCH_COUNTER_TARGET_AVX2 static void blend_over_avx2(uint8_t *dst, const uint8_t *src, size_t count)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m256i s = _mm256_loadu_si256((const __m256i *)(src + i * 4));
+		__m256i d = _mm256_loadu_si256((const __m256i *)(dst + i * 4));
+
+		__m256i a = _mm256_srli_epi32(s, 24);
+		a = _mm256_or_si256(a, _mm256_slli_epi32(a, 8));
+		a = _mm256_or_si256(a, _mm256_slli_epi32(a, 16));
+		__m256i inv = _mm256_xor_si256(a, _mm256_set1_epi32(-1));
+
+		__m256i lo = blend_scale_epi16_avx2(_mm256_unpacklo_epi8(d, zero), _mm256_unpacklo_epi8(inv, zero));
+		__m256i hi = blend_scale_epi16_avx2(_mm256_unpackhi_epi8(d, zero), _mm256_unpackhi_epi8(inv, zero));
+		_mm256_storeu_si256((__m256i *)(dst + i * 4), _mm256_adds_epu8(s, _mm256_packus_epi16(lo, hi)));
+	}
+
+	blend_over_sse2(dst + i * 4, src + i * 4, count - i);
+}
+
+static bool blend_cpu_has_avx2(void)
+{
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+
+	// OSがYMMレジスタを保存するか（OSXSAVEとXCR0）も確かめる
+	__cpuid(info, 1);
+	if (!(info[2] & (1 << 27)) || (_xgetbv(0) & 6) != 6)
+		return false;
+
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+#ifdef MATCH_COUNTER_BLEND_NEON
+static inline uint8x8_t blend_scale_u8x8(uint8x8_t d, uint8x8_t inv)
+{
+	uint16x8_t t = vaddq_u16(vmull_u8(d, inv), vdupq_n_u16(128));
+	return vshrn_n_u16(vaddq_u16(t, vshrq_n_u16(t, 8)), 8);
+}
+
+static void blend_over_neon(uint8_t *dst, const uint8_t *src, size_t count)
+{
+	size_t i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		uint8x16_t s = vld1q_u8(src + i * 4);
+		uint8x16_t d = vld1q_u8(dst + i * 4);
+
+		// 各画素のアルファを4バイトに広げ、255から引く
+		uint32x4_t a = vshrq_n_u32(vreinterpretq_u32_u8(s), 24);
+		uint8x16_t inv = vmvnq_u8(vreinterpretq_u8_u32(vmulq_n_u32(a, 0x01010101)));
+
+		uint8x8_t lo = blend_scale_u8x8(vget_low_u8(d), vget_low_u8(inv));
+		uint8x8_t hi = blend_scale_u8x8(vget_high_u8(d), vget_high_u8(inv));
+		vst1q_u8(dst + i * 4, vqaddq_u8(s, vcombine_u8(lo, hi)));
+	}
+
+	blend_over_scalar(dst + i * 4, src + i * 4, count - i);
+}
+#endif
+
+// 使えるカーネルを遅い順に並べる（初期化前はスカラー版だけ）
+static struct match_counter_blend_kernel blend_kernels[4] = {{"scalar", blend_over_scalar}};
+static size_t blend_kernel_count = 1;
+static match_counter_blend_func_t blend_over = blend_over_scalar;
+
+void match_counter_blend_init(void)
+{
+	blend_kernel_count = 1;
+
+#ifdef MATCH_COUNTER_BLEND_SSE2
+	blend_kernels[blend_kernel_count++] = (struct match_counter_blend_kernel){"sse2", blend_over_sse2};
+	if (blend_cpu_has_avx2())
+		blend_kernels[blend_kernel_count++] = (struct match_counter_blend_kernel){"avx2", blend_over_avx2};
+#endif
+#ifdef MATCH_COUNTER_BLEND_NEON
+	blend_kernels[blend_kernel_count++] = (struct match_counter_blend_kernel){"neon", blend_over_neon};
+#endif
+
+	blend_over = blend_kernels[blend_kernel_count - 1].over;
+	blog(LOG_INFO, "match_counter_blend_init: Using %s kernel", blend_kernels[blend_kernel_count - 1].name);
+}
+
+const struct match_counter_blend_kernel *match_counter_blend_get_kernels(size_t *count)
+{
+	*count = blend_kernel_count;
+	return blend_kernels;
+}
+
+void match_counter_blend_over(uint8_t *dst, const uint8_t *src, size_t count)
+{
+	blend_over(dst, src, count);
+}
+
+void match_counter_blend_premultiply(uint8_t *pixels, size_t count)
+{
+	for (size_t i = 0; i < count; i++, pixels += 4) {
+		uint32_t alpha = pixels[3];
+		for (size_t c = 0; c < 3; c++) {
+			uint32_t t = pixels[c] * alpha + 128;
+			pixels[c] = (uint8_t)((t + (t >> 8)) >> 8);
+		}
+	}
+}
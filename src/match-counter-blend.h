@@ -0,0 +1,79 @@
+/*
+Match Counter for OBS
+Copyright (C) 2025 Yudai Udagawa
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * テキストのビットマップの合成に使うアルファブレンド
+ *
+ * ピクセルは1画素4バイトで4バイト目をアルファとする（RGBA・BGRAのどちらでもよい）。
+ * CPUに合わせてSSE2・AVX2・NEONのカーネルを選び、どのカーネルでもスカラー版と同じ結果になる。
+ */
+
+/**
+ * 乗算済みアルファのsource-over合成（dst = src + dst * (255 - srcのアルファ) / 255）
+ * @param dst 合成先のピクセル
+ * @param src 重ねるピクセル
+ * @param count ピクセル数
+ */
+typedef void (*match_counter_blend_func_t)(uint8_t *dst, const uint8_t *src, size_t count);
+
+struct match_counter_blend_kernel {
+	const char *name;                // カーネルの名前（"scalar", "sse2", "avx2", "neon"）
+	match_counter_blend_func_t over; // source-over合成
+};
+
+/**
+ * CPUが対応している最も速いカーネルを選ぶ（モジュールの読み込み時に1回だけ呼ぶ）
+ *
+ * 呼ぶ前はスカラー版が使われる
+ */
+void match_counter_blend_init(void);
+
+/**
+ * このCPUで使えるカーネルの一覧を取得する
+ * @param count カーネルの数を受け取るポインタ
+ * @return カーネルの配列（先頭がスカラー版、末尾が選ばれているカーネル）
+ */
+const struct match_counter_blend_kernel *match_counter_blend_get_kernels(size_t *count);
+
+/**
+ * 選ばれているカーネルでsource-over合成する
+ * @param dst 合成先のピクセル
+ * @param src 重ねるピクセル（乗算済みアルファ）
+ * @param count ピクセル数
+ */
+void match_counter_blend_over(uint8_t *dst, const uint8_t *src, size_t count);
+
+/**
+ * ピクセルの色にアルファを掛けて乗算済みアルファにする
+ * @param pixels ピクセル
+ * @param count ピクセル数
+ */
+void match_counter_blend_premultiply(uint8_t *pixels, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
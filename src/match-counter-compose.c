@@ -0,0 +1,370 @@
+/*
+Match Counter for OBS
+Copyright (C) 2025 Yudai Udagawa
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include "match-counter-compose.h"
+#include "match-counter-blend.h"
+#include <util/darray.h>
+#include <util/threading.h>
+
+// CPU上のアトラス（合成中に差し替えられても壊れないよう参照カウントで共有する）
+struct compose_atlas {
+	volatile long refs;
+	uint8_t *pixels;
+	uint32_t linesize;
+	uint32_t cy;
+	size_t glyph_count;
+	struct match_counter_compose_glyph glyphs[];
+};
+
+struct compose_buffer {
+	uint8_t *data;
+	size_t capacity;
+	uint32_t cx;
+	uint32_t cy;
+};
+
+struct match_counter_composer {
+	volatile long refs; // 作成元と、ワーカーの待ち行列に入っている間の分
+
+	// mutexで保護する（ワーカーは入れ替えの間だけ、描画スレッドはアップロードの間だけ保持する）
+	pthread_mutex_t mutex;
+	struct compose_atlas *atlas;     // 最後に設定されたアトラス
+	struct compose_atlas *job_atlas; // 未着手の依頼のアトラス
+	DARRAY(uint32_t) job_indices;    // 未着手の依頼の文字
+	bool job_pending;                // 未着手の依頼があるか
+	struct compose_buffer *front;    // 合成済みでアップロード待ちのバッファ
+	volatile bool ready;             // frontがまだアップロードされていないか
+
+	struct compose_buffer *back; // ワーカーだけが書き込むバッファ
+	struct compose_buffer buffers[2];
+
+	// 描画スレッドだけが触る
+	gs_texture_t *texture;
+	uint32_t texture_cx;
+	uint32_t texture_cy;
+
+	bool queued; // compose_mutexで保護する
+};
+
+// すべての合成器で1つのワーカースレッドを共有する
+static pthread_t compose_thread;
+static bool compose_thread_active;
+static pthread_mutex_t compose_mutex;
+static os_sem_t *compose_sem;
+static DARRAY(match_counter_composer_t *) compose_queue;
+static volatile bool compose_stop;
+
+static void compose_atlas_release(struct compose_atlas *atlas)
+{
+	if (atlas && os_atomic_dec_long(&atlas->refs) == 0) {
+		bfree(atlas->pixels);
+		bfree(atlas);
+	}
+}
+
+static struct compose_atlas *compose_atlas_addref(struct compose_atlas *atlas)
+{
+	if (atlas)
+		os_atomic_inc_long(&atlas->refs);
+	return atlas;
+}
+
+static void composer_release(match_counter_composer_t *composer)
+{
+	if (os_atomic_dec_long(&composer->refs) != 0)
+		return;
+
+	compose_atlas_release(composer->atlas);
+	compose_atlas_release(composer->job_atlas);
+	da_free(composer->job_indices);
+	bfree(composer->buffers[0].data);
+	bfree(composer->buffers[1].data);
+	pthread_mutex_destroy(&composer->mutex);
+	bfree(composer);
+}
+
+// 文字の列をアトラスから切り出して横に並べ、改行ごとに次の行へ移る
+// 斜体などで右にはみ出した部分は次の文字に重ねて合成し、テキストの右端より外は切り捨てる
+static void compose_run(struct compose_buffer *buffer, const struct compose_atlas *atlas, const uint32_t *indices,
+			size_t count)
+{
+	uint32_t cx = 0;
+	uint32_t rows = 1;
+	uint32_t row_cx = 0;
+	for (size_t i = 0; i < count; i++) {
+		if (indices[i] == MATCH_COUNTER_COMPOSE_NEWLINE) {
+			rows++;
+			row_cx = 0;
+			continue;
+		}
+		row_cx += atlas->glyphs[indices[i]].cx;
+		if (row_cx > cx)
+			cx = row_cx;
+	}
+
+	uint32_t cy = atlas->cy * rows;
+	size_t size = (size_t)cx * cy * 4;
+	if (size > buffer->capacity) {
+		bfree(buffer->data);
+		buffer->data = bmalloc(size);
+		buffer->capacity = size;
+	}
+	buffer->cx = cx;
+	buffer->cy = cy;
+	if (!size)
+		return;
+	memset(buffer->data, 0, size);
+
+	size_t linesize = (size_t)cx * 4;
+	uint32_t x = 0;
+	uint32_t top = 0;
+	for (size_t i = 0; i < count; i++) {
+		if (indices[i] == MATCH_COUNTER_COMPOSE_NEWLINE) {
+			x = 0;
+			top += atlas->cy;
+			continue;
+		}
+
+		const struct match_counter_compose_glyph *glyph = &atlas->glyphs[indices[i]];
+		const uint8_t *src = atlas->pixels + (size_t)glyph->x * 4;
+		uint8_t *dst = buffer->data + (size_t)top * linesize + (size_t)x * 4;
+		uint32_t cell_cx = glyph->cell_cx < cx - x ? glyph->cell_cx : cx - x;
+
+		for (uint32_t y = 0; y < atlas->cy; y++)
+			match_counter_blend_over(dst + y * linesize, src + (size_t)y * atlas->linesize, cell_cx);
+
+		x += glyph->cx;
+	}
+}
+
+static void compose_process(match_counter_composer_t *composer)
+{
+	DARRAY(uint32_t) indices;
+	da_init(indices);
+
+	pthread_mutex_lock(&composer->mutex);
+	struct compose_atlas *atlas = composer->job_atlas;
+	bool pending = composer->job_pending;
+	composer->job_atlas = NULL;
+	composer->job_pending = false;
+	da_move(indices, composer->job_indices);
+	pthread_mutex_unlock(&composer->mutex);
+
+	if (pending && atlas) {
+		// ロックを取らずに裏のバッファへ合成し、入れ替えの間だけロックする
+		compose_run(composer->back, atlas, indices.array, indices.num);
+
+		pthread_mutex_lock(&composer->mutex);
+		struct compose_buffer *front = composer->front;
+		composer->front = composer->back;
+		composer->back = front;
+		os_atomic_set_bool(&composer->ready, true);
+		pthread_mutex_unlock(&composer->mutex);
+	}
+
+	compose_atlas_release(atlas);
+	da_free(indices);
+}
+
+static void *compose_thread_main(void *data)
+{
+	UNUSED_PARAMETER(data);
+	os_set_thread_name("match-counter: compose");
+
+	while (os_sem_wait(compose_sem) == 0) {
+		if (os_atomic_load_bool(&compose_stop))
+			break;
+
+		match_counter_composer_t *composer = NULL;
+		pthread_mutex_lock(&compose_mutex);
+		if (compose_queue.num) {
+			composer = compose_queue.array[0];
+			composer->queued = false;
+			da_erase(compose_queue, 0);
+		}
+		pthread_mutex_unlock(&compose_mutex);
+
+		if (!composer)
+			continue;
+
+		compose_process(composer);
+		composer_release(composer);
+	}
+
+	return NULL;
+}
+
+void match_counter_compose_init(void)
+{
+	match_counter_blend_init();
+
+	pthread_mutex_init(&compose_mutex, NULL);
+	da_init(compose_queue);
+	os_atomic_set_bool(&compose_stop, false);
+
+	if (os_sem_init(&compose_sem, 0) != 0) {
+		blog(LOG_ERROR, "match_counter_compose_init: Failed to create semaphore");
+		return;
+	}
+
+	compose_thread_active = pthread_create(&compose_thread, NULL, compose_thread_main, NULL) == 0;
+	if (!compose_thread_active)
+		blog(LOG_ERROR, "match_counter_compose_init: Failed to create compose thread");
+}
+
+void match_counter_compose_free(void)
+{
+	if (compose_thread_active) {
+		os_atomic_set_bool(&compose_stop, true);
+		os_sem_post(compose_sem);
+		pthread_join(compose_thread, NULL);
+		compose_thread_active = false;
+	}
+
+	// ソースはモジュールの解放前にすべて破棄されているため、残っているのは参照だけ
+	for (size_t i = 0; i < compose_queue.num; i++)
+		composer_release(compose_queue.array[i]);
+
+	da_free(compose_queue);
+	os_sem_destroy(compose_sem);
+	compose_sem = NULL;
+	pthread_mutex_destroy(&compose_mutex);
+}
+
+match_counter_composer_t *match_counter_composer_create(void)
+{
+	match_counter_composer_t *composer = bzalloc(sizeof(match_counter_composer_t));
+	composer->refs = 1;
+	pthread_mutex_init(&composer->mutex, NULL);
+	da_init(composer->job_indices);
+	composer->front = &composer->buffers[0];
+	composer->back = &composer->buffers[1];
+	return composer;
+}
+
+void match_counter_composer_destroy(match_counter_composer_t *composer)
+{
+	if (!composer)
+		return;
+
+	gs_texture_destroy(composer->texture);
+	composer->texture = NULL;
+	composer_release(composer);
+}
+
+void match_counter_composer_set_atlas(match_counter_composer_t *composer, const uint8_t *pixels, uint32_t linesize,
+				      uint32_t cx, uint32_t cy, const struct match_counter_compose_glyph *glyphs,
+				      size_t glyph_count)
+{
+	struct compose_atlas *atlas =
+		bzalloc(sizeof(struct compose_atlas) + sizeof(struct match_counter_compose_glyph) * glyph_count);
+	atlas->refs = 1;
+	atlas->linesize = cx * 4;
+	atlas->cy = cy;
+	atlas->glyph_count = glyph_count;
+	memcpy(atlas->glyphs, glyphs, sizeof(struct match_counter_compose_glyph) * glyph_count);
+
+	// 切り出す幅がアトラスの右端を越えないようにする
+	for (size_t i = 0; i < glyph_count; i++) {
+		struct match_counter_compose_glyph *glyph = &atlas->glyphs[i];
+		uint32_t max_cx = glyph->x < cx ? cx - glyph->x : 0;
+		if (glyph->cell_cx > max_cx)
+			glyph->cell_cx = max_cx;
+	}
+
+	// ステージングサーフェスの行には余白があることがあるため、詰めてコピーする
+	atlas->pixels = bmalloc((size_t)atlas->linesize * cy);
+	for (uint32_t y = 0; y < cy; y++)
+		memcpy(atlas->pixels + (size_t)y * atlas->linesize, pixels + (size_t)y * linesize, atlas->linesize);
+
+	// 合成のたびに掛けないよう、乗算済みアルファにしておく
+	match_counter_blend_premultiply(atlas->pixels, (size_t)cx * cy);
+
+	pthread_mutex_lock(&composer->mutex);
+	struct compose_atlas *old = composer->atlas;
+	composer->atlas = atlas;
+	pthread_mutex_unlock(&composer->mutex);
+
+	compose_atlas_release(old);
+}
+
+void match_counter_composer_request(match_counter_composer_t *composer, const uint32_t *indices, size_t count)
+{
+	pthread_mutex_lock(&composer->mutex);
+	struct compose_atlas *old = composer->job_atlas;
+	composer->job_atlas = compose_atlas_addref(composer->atlas);
+	composer->job_pending = composer->job_atlas != NULL;
+	da_resize(composer->job_indices, count);
+	if (count)
+		memcpy(composer->job_indices.array, indices, sizeof(uint32_t) * count);
+
+	// 範囲外の番号は合成時に読み出さないよう、依頼の時点で捨てる
+	for (size_t i = 0; composer->job_pending && i < count; i++) {
+		if (indices[i] >= composer->job_atlas->glyph_count && indices[i] != MATCH_COUNTER_COMPOSE_NEWLINE)
+			composer->job_pending = false;
+	}
+	pthread_mutex_unlock(&composer->mutex);
+
+	compose_atlas_release(old);
+
+	if (!compose_thread_active)
+		return;
+
+	pthread_mutex_lock(&compose_mutex);
+	if (!composer->queued) {
+		composer->queued = true;
+		os_atomic_inc_long(&composer->refs);
+		da_push_back(compose_queue, &composer);
+		os_sem_post(compose_sem);
+	}
+	pthread_mutex_unlock(&compose_mutex);
+}
+
+gs_texture_t *match_counter_composer_get_texture(match_counter_composer_t *composer, uint32_t *cx, uint32_t *cy)
+{
+	// ワーカーが入れ替え中なら待たずに前のテクスチャを使う
+	if (os_atomic_load_bool(&composer->ready) && pthread_mutex_trylock(&composer->mutex) == 0) {
+		struct compose_buffer *front = composer->front;
+
+		if (front->cx && front->cy) {
+			if (!composer->texture || composer->texture_cx != front->cx ||
+			    composer->texture_cy != front->cy) {
+				gs_texture_destroy(composer->texture);
+				composer->texture =
+					gs_texture_create(front->cx, front->cy, GS_RGBA, 1, NULL, GS_DYNAMIC);
+				composer->texture_cx = front->cx;
+				composer->texture_cy = front->cy;
+			}
+			if (composer->texture)
+				gs_texture_set_image(composer->texture, front->data, front->cx * 4, false);
+		} else {
+			// 空のテキストは何も描画しない
+			gs_texture_destroy(composer->texture);
+			composer->texture = NULL;
+			composer->texture_cx = 0;
+			composer->texture_cy = 0;
+		}
+
+		os_atomic_set_bool(&composer->ready, false);
+		pthread_mutex_unlock(&composer->mutex);
+	}
+
+	*cx = composer->texture_cx;
+	*cy = composer->texture_cy;
+	return composer->texture;
+}
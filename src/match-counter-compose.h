@@ -0,0 +1,109 @@
+/*
+Match Counter for OBS
+Copyright (C) 2025 Yudai Udagawa
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include <obs-module.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * グリフアトラスからテキストのビットマップをワーカースレッドで合成し、描画スレッドでアップロードする
+ *
+ * 合成はCPU上の2枚のバッファで行い、描画スレッドは合成済みのバッファをアップロードするだけで、
+ * 合成が終わるまでは前のテクスチャを描画し続ける。
+ * 文字は乗算済みアルファで重ねるため、テクスチャはGS_BLEND_ONE/GS_BLEND_INVSRCALPHAで描画する。
+ */
+typedef struct match_counter_composer match_counter_composer_t;
+
+// 合成を依頼する文字の番号のうち、改行を表すもの（次の文字からアトラスの高さ分だけ下の行に並べる）
+#define MATCH_COUNTER_COMPOSE_NEWLINE UINT32_MAX
+
+// アトラス内の1文字分の位置
+struct match_counter_compose_glyph {
+	uint32_t x;       // アトラス内のX座標
+	uint32_t cx;      // 文字幅（次の文字までの間隔）
+	uint32_t cell_cx; // 右にはみ出した部分を含めて切り出す幅（cx以上）
+};
+
+/**
+ * ワーカースレッドを開始する（モジュールの読み込み時に1回だけ呼ぶ）
+ */
+void match_counter_compose_init(void);
+
+/**
+ * ワーカースレッドを停止する（モジュールの解放時に1回だけ呼ぶ）
+ */
+void match_counter_compose_free(void);
+
+/**
+ * 合成器を作成する
+ * @return 合成器
+ */
+match_counter_composer_t *match_counter_composer_create(void);
+
+/**
+ * 合成器を破棄する
+ * @param composer 合成器（NULLなら何もしない）
+ *
+ * グラフィックスコンテキスト内で呼ぶ。合成中の場合、バッファは合成が終わってから解放される
+ */
+void match_counter_composer_destroy(match_counter_composer_t *composer);
+
+/**
+ * 合成に使うアトラスを設定する（ピクセルと文字の情報はコピーされる）
+ * @param composer 合成器
+ * @param pixels アトラスのRGBAピクセル
+ * @param linesize 1行のバイト数
+ * @param cx アトラスの幅
+ * @param cy アトラスの高さ
+ * @param glyphs 文字の位置
+ * @param glyph_count 文字数
+ */
+void match_counter_composer_set_atlas(match_counter_composer_t *composer, const uint8_t *pixels, uint32_t linesize,
+				      uint32_t cx, uint32_t cy, const struct match_counter_compose_glyph *glyphs,
+				      size_t glyph_count);
+
+/**
+ * 文字を並べたビットマップの合成を依頼する（前の依頼がまだ始まっていなければ置き換える）
+ * @param composer 合成器
+ * @param indices 左から並べる文字の、最後に設定したアトラスでの番号（MATCH_COUNTER_COMPOSE_NEWLINEで改行する）
+ * @param count 文字数
+ *
+ * 依頼した時点のアトラスで合成されるため、後からアトラスを設定し直しても結果は崩れない。
+ * 幅は最も長い行の幅、高さは行数分のアトラスの高さになる
+ */
+void match_counter_composer_request(match_counter_composer_t *composer, const uint32_t *indices, size_t count);
+
+/**
+ * 最後に合成が終わったテキストのテクスチャを取得する
+ * @param composer 合成器
+ * @param cx 幅を受け取るポインタ
+ * @param cy 高さを受け取るポインタ
+ * @return テクスチャ（まだ一度も合成が終わっていなければNULL）
+ *
+ * グラフィックスコンテキスト内で呼ぶ。新しい合成結果があればアップロードしてから返す。
+ * ワーカースレッドがバッファを入れ替えている最中であれば待たずに前のテクスチャを返す
+ */
+gs_texture_t *match_counter_composer_get_texture(match_counter_composer_t *composer, uint32_t *cx, uint32_t *cy);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,783 @@
+/*
+Match Counter for OBS
+Copyright (C) 2025 Yudai Udagawa
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include "match-counter-control.h"
+#include "match-counter-queue.h"
+#include "match-counter-registry.h"
+#include <util/darray.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <limits.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+// 1行（1バッチ）の最大バイト数
+#define CONTROL_LINE_MAX 4096
+// 同時に接続できるクライアントの数
+#define CONTROL_MAX_CLIENTS 8
+// 適用待ちにできるコマンドの数（積みきれずに残っている分も含め、これを超えるバッチは拒否する）
+#define CONTROL_PENDING_MAX 8192
+// addの1回で追加・取り消しできる試合数
+#define CONTROL_ADD_MAX 64
+
+struct control_command {
+	char *id;
+	enum match_counter_journal_event event;
+	int wins;
+	int losses;
+};
+
+// 1行分のコマンド。すべて解釈できてから適用待ちに移し、キューにも分けずに積む
+struct control_batch {
+	DARRAY(struct control_command) commands;
+};
+
+// バッチの宛先のカウンターごとのコマンド数
+struct control_target {
+	const char *id;
+	match_counter_shared_t *shared; // 削除済みか、購読しているソースがなければNULL
+	size_t count;
+	uint64_t pos; // キューに確保した位置
+};
+
+struct control_client {
+#ifndef _WIN32
+	int fd; // 未接続なら-1
+#endif
+	char buffer[CONTROL_LINE_MAX];
+	size_t len;
+};
+
+// 受信スレッドが積み、描画スレッドのmatch_counter_control_tickで取り出す
+static pthread_mutex_t control_mutex;
+static DARRAY(struct control_batch) control_pending;
+static size_t control_queued_commands; // control_pendingとcontrol_applyingのコマンドの総数
+
+// 以下は描画スレッドだけが触る
+static DARRAY(struct control_batch) control_applying; // 積みきれなかったバッチが残る
+static DARRAY(struct control_target) control_targets;
+static DARRAY(struct match_counter_command) control_posting;
+
+static pthread_t control_thread;
+static bool control_active;
+static volatile bool control_stop;
+static char *control_endpoint;
+
+#ifdef _WIN32
+static HANDLE control_stop_event;
+#else
+static int control_listen_fd = -1;
+static int control_wake_fds[2] = {-1, -1};
+#endif
+
+static void control_free_commands(struct control_command *commands, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		bfree(commands[i].id);
+}
+
+static void control_free_batches(struct control_batch *batches, size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		control_free_commands(batches[i].commands.array, batches[i].commands.num);
+		da_free(batches[i].commands);
+	}
+}
+
+// 空白を読み飛ばして次の語を切り出す（"で囲まれていればその中身）。語がなければNULL
+static char *control_next_token(char **cursor)
+{
+	char *p = *cursor;
+	while (*p == ' ' || *p == '\t')
+		p++;
+
+	if (!*p) {
+		*cursor = p;
+		return NULL;
+	}
+
+	char *token = p;
+	if (*p == '"') {
+		token = ++p;
+		while (*p && *p != '"')
+			p++;
+	} else {
+		while (*p && *p != ' ' && *p != '\t')
+			p++;
+	}
+
+	if (*p)
+		*p++ = '\0';
+
+	*cursor = p;
+	return token;
+}
+
+static bool control_parse_int(char **cursor, int min, int max, int *value)
+{
+	char *token = control_next_token(cursor);
+	if (!token)
+		return false;
+
+	char *end;
+	long parsed = strtol(token, &end, 10);
+	if (end == token || *end || parsed < min || parsed > max)
+		return false;
+
+	*value = (int)parsed;
+	return true;
+}
+
+static void control_push(struct control_batch *batch, const char *id, enum match_counter_journal_event event,
+			 int wins, int losses)
+{
+	struct control_command *command = da_push_back_new(batch->commands);
+	command->id = bstrdup(id);
+	command->event = event;
+	command->wins = wins;
+	command->losses = losses;
+}
+
+static void control_push_repeated(struct control_batch *batch, const char *id, int count,
+				  enum match_counter_journal_event add, enum match_counter_journal_event undo)
+{
+	for (int i = 0; i < abs(count); i++)
+		control_push(batch, id, count > 0 ? add : undo, 0, 0);
+}
+
+// 1つのコマンドを解釈してbatchに追加し、空でなければstatementsを数える。誤りがあればその理由を返す
+static const char *control_parse_statement(char *statement, struct control_batch *batch, size_t *statements,
+					   bool *is_get, struct dstr *response)
+{
+	char *cursor = statement;
+	char *op = control_next_token(&cursor);
+	if (!op)
+		return NULL;
+
+	char *id = control_next_token(&cursor);
+	if (!id || !*id)
+		return "missing counter id";
+
+	// 存在しないIDは、積む前にクライアントへ知らせる
+	match_counter_shared_t *shared = match_counter_registry_find(id);
+	if (!shared)
+		return "unknown counter id";
+
+	// 表示するソースがない（合計ソースだけが参照している）カウンターには積まない
+	bool subscribed = match_counter_shared_has_subscribers(shared);
+
+	const char *error = NULL;
+	int wins = 0;
+	int losses = 0;
+
+	if (strcmp(op, "get") != 0 && !subscribed) {
+		error = "counter has no source";
+	} else if (strcmp(op, "win") == 0) {
+		control_push(batch, id, MATCH_COUNTER_JOURNAL_WIN, 0, 0);
+	} else if (strcmp(op, "loss") == 0) {
+		control_push(batch, id, MATCH_COUNTER_JOURNAL_LOSS, 0, 0);
+	} else if (strcmp(op, "undo_win") == 0) {
+		control_push(batch, id, MATCH_COUNTER_JOURNAL_UNDO_WIN, 0, 0);
+	} else if (strcmp(op, "undo_loss") == 0) {
+		control_push(batch, id, MATCH_COUNTER_JOURNAL_UNDO_LOSS, 0, 0);
+	} else if (strcmp(op, "reset") == 0) {
+		control_push(batch, id, MATCH_COUNTER_JOURNAL_RESET, 0, 0);
+	} else if (strcmp(op, "set") == 0) {
+		if (control_parse_int(&cursor, 0, INT_MAX, &wins) && control_parse_int(&cursor, 0, INT_MAX, &losses))
+			control_push(batch, id, MATCH_COUNTER_JOURNAL_SET, wins, losses);
+		else
+			error = "set needs <wins> <losses>";
+	} else if (strcmp(op, "add") == 0) {
+		if (control_parse_int(&cursor, -CONTROL_ADD_MAX, CONTROL_ADD_MAX, &wins) &&
+		    control_parse_int(&cursor, -CONTROL_ADD_MAX, CONTROL_ADD_MAX, &losses)) {
+			control_push_repeated(batch, id, wins, MATCH_COUNTER_JOURNAL_WIN,
+					      MATCH_COUNTER_JOURNAL_UNDO_WIN);
+			control_push_repeated(batch, id, losses, MATCH_COUNTER_JOURNAL_LOSS,
+					      MATCH_COUNTER_JOURNAL_UNDO_LOSS);
+		} else {
+			error = "add needs <wins> <losses>";
+		}
+	} else if (strcmp(op, "get") == 0) {
+		// 勝利数と敗北数が同じ時点の値になるよう、スナップショットから読む
+		match_counter_snapshot_t snapshot;
+		match_counter_get_snapshot(match_counter_shared_get_counter(shared), &snapshot);
+		dstr_catf(response, "score %d %d\n", snapshot.wins, snapshot.losses);
+		*is_get = true;
+	} else {
+		error = "unknown command";
+	}
+
+	match_counter_registry_release(shared, false);
+
+	if (!error && control_next_token(&cursor))
+		error = "too many arguments";
+
+	// add <ID> 0 0のように操作が1つもなくてもコマンドとして数え、応答を返す
+	if (!error)
+		(*statements)++;
+	return error;
+}
+
+// 1行を1つのバッチとして解釈し、誤りがなければまとめて適用待ちに積む
+static void control_handle_line(char *line, struct dstr *response)
+{
+	struct control_batch batch;
+	da_init(batch.commands);
+
+	struct dstr score = {0};
+	const char *error = NULL;
+	size_t statements = 0;
+	bool is_get = false;
+
+	// ';'で区切る（"の中の';'はIDの一部として扱う）
+	char *statement = line;
+	bool quoted = false;
+	for (char *p = line;; p++) {
+		if (*p == '"') {
+			quoted = !quoted;
+			continue;
+		}
+		if (*p && (*p != ';' || quoted))
+			continue;
+
+		bool last = !*p;
+		*p = '\0';
+
+		error = control_parse_statement(statement, &batch, &statements, &is_get, &score);
+		if (error)
+			break;
+
+		if (last)
+			break;
+		statement = p + 1;
+	}
+
+	if (!error && is_get && statements > 1)
+		error = "get must be sent alone";
+	if (!error && batch.commands.num > MATCH_COUNTER_QUEUE_CAPACITY)
+		error = "batch too large";
+
+	size_t count = batch.commands.num;
+	if (!error && count) {
+		// バッチは配列ごと適用待ちに移す
+		pthread_mutex_lock(&control_mutex);
+		if (control_queued_commands + count <= CONTROL_PENDING_MAX) {
+			da_push_back(control_pending, &batch);
+			control_queued_commands += count;
+			da_init(batch.commands);
+		} else {
+			error = "busy";
+		}
+		pthread_mutex_unlock(&control_mutex);
+	}
+
+	if (error) {
+		control_free_commands(batch.commands.array, batch.commands.num);
+		dstr_catf(response, "error %s\n", error);
+	} else if (is_get) {
+		dstr_cat(response, score.array);
+	} else if (statements) {
+		dstr_catf(response, "ok %zu\n", count);
+	}
+
+	da_free(batch.commands);
+	dstr_free(&score);
+}
+
+// 受信済みのデータを改行ごとに処理する。改行のないまま一杯になった場合はfalse
+static bool control_consume(struct control_client *client, struct dstr *response)
+{
+	size_t start = 0;
+
+	for (size_t i = 0; i < client->len; i++) {
+		if (client->buffer[i] != '\n')
+			continue;
+
+		client->buffer[i] = '\0';
+		if (i > start && client->buffer[i - 1] == '\r')
+			client->buffer[i - 1] = '\0';
+
+		control_handle_line(client->buffer + start, response);
+		start = i + 1;
+	}
+
+	memmove(client->buffer, client->buffer + start, client->len - start);
+	client->len -= start;
+
+	if (client->len == sizeof(client->buffer)) {
+		dstr_cat(response, "error line too long\n");
+		return false;
+	}
+	return true;
+}
+
+#ifdef _WIN32
+// 重なったI/Oの完了か停止を待つ。停止した場合や失敗した場合はfalse
+static bool control_complete(HANDLE pipe, OVERLAPPED *ov, BOOL started, DWORD *bytes)
+{
+	if (!started && GetLastError() != ERROR_IO_PENDING)
+		return false;
+
+	HANDLE handles[2] = {control_stop_event, ov->hEvent};
+	if (WaitForMultipleObjects(2, handles, FALSE, INFINITE) != WAIT_OBJECT_0 + 1) {
+		CancelIo(pipe);
+		GetOverlappedResult(pipe, ov, bytes, TRUE);
+		return false;
+	}
+	return GetOverlappedResult(pipe, ov, bytes, FALSE);
+}
+
+// 名前付きパイプで1クライアントずつ受け付ける
+static void *control_thread_main(void *data)
+{
+	UNUSED_PARAMETER(data);
+	os_set_thread_name("match-counter: control");
+
+	struct control_client *client = bzalloc(sizeof(struct control_client));
+	struct dstr response = {0};
+	OVERLAPPED ov = {0};
+	ov.hEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+
+	while (!os_atomic_load_bool(&control_stop)) {
+		HANDLE pipe = CreateNamedPipeA(control_endpoint, PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED,
+					       PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT |
+						       PIPE_REJECT_REMOTE_CLIENTS,
+					       1, CONTROL_LINE_MAX, CONTROL_LINE_MAX, 0, NULL);
+		if (pipe == INVALID_HANDLE_VALUE) {
+			blog(LOG_ERROR, "match_counter_control: Failed to create pipe '%s' (%lu)", control_endpoint,
+			     GetLastError());
+			break;
+		}
+
+		DWORD bytes = 0;
+		BOOL started = ConnectNamedPipe(pipe, &ov);
+		bool connected = started || GetLastError() == ERROR_PIPE_CONNECTED ||
+				 control_complete(pipe, &ov, started, &bytes);
+
+		client->len = 0;
+		while (connected) {
+			started = ReadFile(pipe, client->buffer + client->len,
+					   (DWORD)(sizeof(client->buffer) - client->len), NULL, &ov);
+			if (!control_complete(pipe, &ov, started, &bytes) || !bytes)
+				break;
+
+			client->len += bytes;
+			dstr_copy(&response, "");
+			bool keep = control_consume(client, &response);
+
+			if (response.len) {
+				started = WriteFile(pipe, response.array, (DWORD)response.len, NULL, &ov);
+				if (!control_complete(pipe, &ov, started, &bytes))
+					break;
+			}
+			if (!keep)
+				break;
+		}
+
+		DisconnectNamedPipe(pipe);
+		CloseHandle(pipe);
+	}
+
+	CloseHandle(ov.hEvent);
+	dstr_free(&response);
+	bfree(client);
+	return NULL;
+}
+
+static bool control_listen(const char *endpoint)
+{
+	UNUSED_PARAMETER(endpoint);
+	control_stop_event = CreateEventW(NULL, TRUE, FALSE, NULL);
+	return control_stop_event != NULL;
+}
+
+static void control_close(void)
+{
+	CloseHandle(control_stop_event);
+	control_stop_event = NULL;
+}
+
+static void control_wake(void)
+{
+	SetEvent(control_stop_event);
+}
+#else
+static void control_close_client(struct control_client *client)
+{
+	close(client->fd);
+	client->fd = -1;
+	client->len = 0;
+}
+
+static void control_accept(struct control_client *clients)
+{
+	int fd = accept(control_listen_fd, NULL, NULL);
+	if (fd < 0)
+		return;
+
+	for (size_t i = 0; i < CONTROL_MAX_CLIENTS; i++) {
+		if (clients[i].fd >= 0)
+			continue;
+
+		// 応答を読まないクライアントで受信スレッドが止まらないようにする
+		struct timeval timeout = {1, 0};
+		setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+#ifdef SO_NOSIGPIPE
+		int on = 1;
+		setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+		fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+		clients[i].fd = fd;
+		clients[i].len = 0;
+		return;
+	}
+
+	blog(LOG_WARNING, "match_counter_control: Too many clients, closing connection");
+	close(fd);
+}
+
+static bool control_send(int fd, const char *data, size_t len)
+{
+#ifdef MSG_NOSIGNAL
+	int flags = MSG_NOSIGNAL;
+#else
+	int flags = 0;
+#endif
+	while (len) {
+		ssize_t sent = send(fd, data, len, flags);
+		if (sent < 0 && errno == EINTR)
+			continue;
+		if (sent <= 0)
+			return false;
+		data += sent;
+		len -= (size_t)sent;
+	}
+	return true;
+}
+
+// 受信したデータを処理し、応答を返す。切断する場合はfalse
+static bool control_receive(struct control_client *client, struct dstr *response)
+{
+	ssize_t received = recv(client->fd, client->buffer + client->len, sizeof(client->buffer) - client->len, 0);
+	if (received < 0 && errno == EINTR)
+		return true;
+	if (received <= 0)
+		return false;
+
+	client->len += (size_t)received;
+	dstr_copy(response, "");
+	bool keep = control_consume(client, response);
+
+	if (response->len && !control_send(client->fd, response->array, response->len))
+		return false;
+	return keep;
+}
+
+// ソケットの待ち受けと接続中のクライアントをpollで1つのスレッドが処理する
+static void *control_thread_main(void *data)
+{
+	UNUSED_PARAMETER(data);
+	os_set_thread_name("match-counter: control");
+
+	struct control_client *clients = bzalloc(sizeof(struct control_client) * CONTROL_MAX_CLIENTS);
+	for (size_t i = 0; i < CONTROL_MAX_CLIENTS; i++)
+		clients[i].fd = -1;
+
+	struct dstr response = {0};
+	struct pollfd fds[2 + CONTROL_MAX_CLIENTS];
+	size_t owners[2 + CONTROL_MAX_CLIENTS];
+
+	while (!os_atomic_load_bool(&control_stop)) {
+		fds[0] = (struct pollfd){.fd = control_wake_fds[0], .events = POLLIN};
+		fds[1] = (struct pollfd){.fd = control_listen_fd, .events = POLLIN};
+		nfds_t count = 2;
+		for (size_t i = 0; i < CONTROL_MAX_CLIENTS; i++) {
+			if (clients[i].fd < 0)
+				continue;
+			owners[count] = i;
+			fds[count++] = (struct pollfd){.fd = clients[i].fd, .events = POLLIN};
+		}
+
+		if (poll(fds, count, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			blog(LOG_ERROR, "match_counter_control: poll failed (%d)", errno);
+			break;
+		}
+
+		if (fds[0].revents)
+			break;
+
+		for (nfds_t i = 2; i < count; i++) {
+			struct control_client *client = &clients[owners[i]];
+			if (fds[i].revents && !control_receive(client, &response))
+				control_close_client(client);
+		}
+
+		if (fds[1].revents & POLLIN)
+			control_accept(clients);
+	}
+
+	for (size_t i = 0; i < CONTROL_MAX_CLIENTS; i++) {
+		if (clients[i].fd >= 0)
+			control_close_client(&clients[i]);
+	}
+
+	dstr_free(&response);
+	bfree(clients);
+	return NULL;
+}
+
+static bool control_listen(const char *endpoint)
+{
+	struct sockaddr_un addr = {0};
+	addr.sun_family = AF_UNIX;
+	if (strlen(endpoint) >= sizeof(addr.sun_path)) {
+		blog(LOG_ERROR, "match_counter_control: Socket path is too long: '%s'", endpoint);
+		return false;
+	}
+	strcpy(addr.sun_path, endpoint);
+
+	// 前回の異常終了で残ったソケットファイルは作り直す
+	unlink(endpoint);
+
+	control_listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (control_listen_fd < 0 || pipe(control_wake_fds) != 0) {
+		blog(LOG_ERROR, "match_counter_control: Failed to create socket (%d)", errno);
+		return false;
+	}
+	fcntl(control_listen_fd, F_SETFD, FD_CLOEXEC);
+	fcntl(control_wake_fds[0], F_SETFD, FD_CLOEXEC);
+	fcntl(control_wake_fds[1], F_SETFD, FD_CLOEXEC);
+
+	if (bind(control_listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+	    listen(control_listen_fd, CONTROL_MAX_CLIENTS) != 0) {
+		blog(LOG_ERROR, "match_counter_control: Failed to listen on '%s' (%d)", endpoint, errno);
+		return false;
+	}
+
+	// 同じユーザーのプロセスからだけ接続できるようにする
+	chmod(endpoint, S_IRUSR | S_IWUSR);
+	return true;
+}
+
+static void control_close(void)
+{
+	if (control_listen_fd >= 0)
+		close(control_listen_fd);
+	for (size_t i = 0; i < 2; i++) {
+		if (control_wake_fds[i] >= 0)
+			close(control_wake_fds[i]);
+		control_wake_fds[i] = -1;
+	}
+	control_listen_fd = -1;
+
+	if (control_endpoint)
+		unlink(control_endpoint);
+}
+
+static void control_wake(void)
+{
+	char byte = 0;
+	if (write(control_wake_fds[1], &byte, 1) < 0)
+		blog(LOG_WARNING, "match_counter_control: Failed to wake control thread (%d)", errno);
+}
+#endif
+
+bool match_counter_control_start(const char *endpoint)
+{
+	if (control_active || !endpoint || !*endpoint)
+		return false;
+
+	pthread_mutex_init(&control_mutex, NULL);
+	da_init(control_pending);
+	da_init(control_applying);
+	control_queued_commands = 0;
+	control_endpoint = bstrdup(endpoint);
+	os_atomic_set_bool(&control_stop, false);
+
+	if (!control_listen(endpoint) || pthread_create(&control_thread, NULL, control_thread_main, NULL) != 0) {
+		blog(LOG_ERROR, "match_counter_control: Failed to start control endpoint '%s'", endpoint);
+		control_close();
+		bfree(control_endpoint);
+		control_endpoint = NULL;
+		pthread_mutex_destroy(&control_mutex);
+		return false;
+	}
+
+	control_active = true;
+	blog(LOG_INFO, "match_counter_control: Listening on '%s'", endpoint);
+	return true;
+}
+
+void match_counter_control_stop(void)
+{
+	if (!control_active)
+		return;
+
+	os_atomic_set_bool(&control_stop, true);
+	control_wake();
+	pthread_join(control_thread, NULL);
+	control_close();
+	control_active = false;
+
+	control_free_batches(control_pending.array, control_pending.num);
+	control_free_batches(control_applying.array, control_applying.num);
+	da_free(control_pending);
+	da_free(control_applying);
+	da_free(control_targets);
+	da_free(control_posting);
+	bfree(control_endpoint);
+	control_endpoint = NULL;
+	pthread_mutex_destroy(&control_mutex);
+}
+
+static struct control_target *control_find_target(const char *id)
+{
+	for (size_t i = 0; i < control_targets.num; i++) {
+		if (strcmp(control_targets.array[i].id, id) == 0)
+			return &control_targets.array[i];
+	}
+	return NULL;
+}
+
+// バッチを宛先ごとにまとめて積む。すべての宛先のキューに空きを確保してから書き込むため、
+// 一部の宛先にだけ積まれることはない。確保できなければ何も積まずにfalse
+static bool control_post_batch(struct control_batch *batch, size_t *posted, size_t *skipped)
+{
+	da_resize(control_targets, 0);
+
+	for (size_t i = 0; i < batch->commands.num; i++) {
+		const char *id = batch->commands.array[i].id;
+		struct control_target *target = control_find_target(id);
+		if (!target) {
+			target = da_push_back_new(control_targets);
+			target->id = id;
+			target->shared = match_counter_registry_find(id);
+
+			// 受け付けた後にカウンターを表示するソースが削除された場合は捨てる
+			if (target->shared && !match_counter_shared_has_subscribers(target->shared)) {
+				match_counter_registry_release(target->shared, false);
+				target->shared = NULL;
+			}
+		}
+		target->count++;
+	}
+
+	// 途中の宛先で空きが足りなければ、それまでに確保した分を取り消す
+	size_t reserved = 0;
+	for (; reserved < control_targets.num; reserved++) {
+		struct control_target *target = &control_targets.array[reserved];
+		if (target->shared && !match_counter_shared_reserve(target->shared, target->count, &target->pos))
+			break;
+	}
+
+	bool complete = reserved == control_targets.num;
+	int64_t now = match_counter_history_now_ms();
+
+	for (size_t i = 0; i < reserved; i++) {
+		struct control_target *target = &control_targets.array[i];
+		if (!target->shared)
+			continue;
+
+		if (!complete) {
+			match_counter_shared_commit(target->shared, target->pos, NULL, target->count);
+			continue;
+		}
+
+		da_resize(control_posting, 0);
+		for (size_t j = 0; j < batch->commands.num; j++) {
+			const struct control_command *command = &batch->commands.array[j];
+			if (strcmp(command->id, target->id) != 0)
+				continue;
+
+			struct match_counter_command *posting = da_push_back_new(control_posting);
+			posting->event = command->event;
+			posting->wins = command->wins;
+			posting->losses = command->losses;
+			posting->timestamp_ms = now;
+		}
+
+		match_counter_shared_commit(target->shared, target->pos, control_posting.array, control_posting.num);
+		*posted += target->count;
+	}
+
+	if (complete) {
+		for (size_t i = 0; i < control_targets.num; i++) {
+			if (!control_targets.array[i].shared)
+				*skipped += control_targets.array[i].count;
+		}
+	}
+
+	for (size_t i = 0; i < control_targets.num; i++)
+		match_counter_registry_release(control_targets.array[i].shared, false);
+	return complete;
+}
+
+size_t match_counter_control_tick(void)
+{
+	if (!control_active)
+		return 0;
+
+	// 前のフレームで積みきれなかったバッチの後ろに足す。ロックの間は配列のコピーしかしない
+	// 上限を数えるコマンドの総数は、積み終えるか捨てるまで減らさない
+	pthread_mutex_lock(&control_mutex);
+	da_push_back_array(control_applying, control_pending.array, control_pending.num);
+	da_resize(control_pending, 0);
+	pthread_mutex_unlock(&control_mutex);
+
+	size_t posted = 0;
+	size_t skipped = 0;
+	size_t done = 0;
+
+	// キューに空きがなければ、順序を保つためにそのバッチから後は次のフレームに回す
+	for (; done < control_applying.num; done++) {
+		if (!control_post_batch(&control_applying.array[done], &posted, &skipped))
+			break;
+	}
+
+	if (skipped)
+		blog(LOG_WARNING, "match_counter_control: Skipped %zu commands for counters without a source", skipped);
+
+	if (posted || skipped) {
+		pthread_mutex_lock(&control_mutex);
+		control_queued_commands -= posted + skipped;
+		pthread_mutex_unlock(&control_mutex);
+	}
+
+	if (done) {
+		control_free_batches(control_applying.array, done);
+		memmove(control_applying.array, control_applying.array + done,
+			sizeof(struct control_batch) * (control_applying.num - done));
+		da_resize(control_applying, control_applying.num - done);
+	}
+	return posted;
+}
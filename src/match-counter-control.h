@@ -0,0 +1,66 @@
+/*
+Match Counter for OBS
+Copyright (C) 2025 Yudai Udagawa
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include <obs-module.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * 外部ツールから勝敗数を操作するためのローカルな制御用エンドポイント
+ *
+ * Unixではソケットファイル、Windowsでは名前付きパイプで待ち受ける。
+ * 1行が1つのバッチで、';'で区切った複数のコマンドを含められる。
+ *   win <id> / loss <id> / undo_win <id> / undo_loss <id> / reset <id>
+ *   set <id> <wins> <losses>   勝敗数を直接設定する
+ *   add <id> <wins> <losses>   勝利・敗北を1試合ずつ追加する（負の値なら取り消す）
+ *   get <id>                   現在の勝敗数を返す（単独の行でのみ使える）
+ * <id>はソースの「カウンターID」で、空白を含む場合は"で囲む。
+ * 各行に対して「ok <積んだコマンド数>」「score <wins> <losses>」「error <理由>」のいずれかを1行で返す。
+ * バッチは途中に誤りがあれば何も積まれず、受け付けたものは届いた順にフレームの先頭でキューに積まれる。
+ * 購読しているソースがないカウンターへの操作は受け付けず、受け付けた後にソースがなくなった分は捨てる。
+ */
+
+/**
+ * 制御用エンドポイントで待ち受けるスレッドを開始する
+ * @param endpoint ソケットファイルのパス（Windowsでは名前付きパイプの名前）
+ * @return 開始できた場合はtrue
+ */
+bool match_counter_control_start(const char *endpoint);
+
+/**
+ * 待ち受けを停止し、接続中のクライアントを切断する
+ */
+void match_counter_control_stop(void);
+
+/**
+ * 受信済みのバッチを共有カウンターのキューに積む
+ * @return 積んだコマンドの数
+ *
+ * 描画スレッドのobs_add_tick_callbackで、match_counter_registry_drain_allより前に呼ぶ。
+ * バッチは宛先のキューすべてに全体を積める場合だけ積み、分けて積むことはない。
+ * 空きが足りない場合、そのバッチから後は順序を保ったまま次の呼び出しに回す
+ */
+size_t match_counter_control_tick(void);
+
+#ifdef __cplusplus
+}
+#endif
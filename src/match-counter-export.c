@@ -0,0 +1,289 @@
+/*
+Match Counter for OBS
+Copyright (C) 2025 Yudai Udagawa
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include "match-counter-export.h"
+#include "match-counter-writer.h"
+#include <time.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+#include <util/threading.h>
+
+// 書き出し待ちの操作を保持する数（これ以上溜まった分は捨てる）
+#define EXPORT_RING_CAPACITY 1024
+
+struct export_event {
+	int64_t timestamp_ms;
+	enum match_counter_journal_event event;
+	int wins;
+	int losses;
+};
+
+struct match_counter_exporter {
+	char *path;
+	char *label;
+	enum match_counter_export_format format;
+	uint64_t max_bytes;
+	uint32_t max_files;
+
+	// mutexで保護する
+	pthread_mutex_t mutex;
+	struct export_event ring[EXPORT_RING_CAPACITY];
+	size_t ring_head;  // 最も古い操作の位置
+	size_t ring_count; // 書き出し待ちの数
+	uint64_t dropped;  // リングバッファが一杯で捨てた数
+
+	// 書き込みスレッドだけが触る
+	struct export_event batch[EXPORT_RING_CAPACITY];
+	FILE *file;
+	uint64_t file_size;
+	struct dstr line;
+
+	struct match_counter_writer_job job;
+};
+
+static const char *export_event_name(enum match_counter_journal_event event)
+{
+	switch (event) {
+	case MATCH_COUNTER_JOURNAL_SNAPSHOT:
+		return "snapshot";
+	case MATCH_COUNTER_JOURNAL_WIN:
+		return "win";
+	case MATCH_COUNTER_JOURNAL_LOSS:
+		return "loss";
+	case MATCH_COUNTER_JOURNAL_UNDO_WIN:
+		return "undo_win";
+	case MATCH_COUNTER_JOURNAL_UNDO_LOSS:
+		return "undo_loss";
+	case MATCH_COUNTER_JOURNAL_RESET:
+		return "reset";
+	case MATCH_COUNTER_JOURNAL_SET:
+		return "set";
+	}
+	return "unknown";
+}
+
+// ISO 8601形式（UTC、ミリ秒まで）の時刻を追加する
+static void export_cat_timestamp(struct dstr *dst, int64_t timestamp_ms)
+{
+	time_t seconds = (time_t)(timestamp_ms / 1000);
+	struct tm tm;
+#ifdef _WIN32
+	gmtime_s(&tm, &seconds);
+#else
+	gmtime_r(&seconds, &tm);
+#endif
+	dstr_catf(dst, "%04d-%02d-%02dT%02d:%02d:%02d.%03dZ", tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
+		  tm.tm_hour, tm.tm_min, tm.tm_sec, (int)(timestamp_ms % 1000));
+}
+
+static void export_cat_csv_string(struct dstr *dst, const char *str)
+{
+	if (!strpbrk(str, ",\"\r\n")) {
+		dstr_cat(dst, str);
+		return;
+	}
+
+	dstr_cat(dst, "\"");
+	for (const char *p = str; *p; p++)
+		dstr_catf(dst, *p == '"' ? "\"\"" : "%c", *p);
+	dstr_cat(dst, "\"");
+}
+
+static void export_cat_json_string(struct dstr *dst, const char *str)
+{
+	dstr_cat(dst, "\"");
+	for (const unsigned char *p = (const unsigned char *)str; *p; p++) {
+		if (*p == '"' || *p == '\\')
+			dstr_catf(dst, "\\%c", *p);
+		else if (*p < 0x20)
+			dstr_catf(dst, "\\u%04x", *p);
+		else
+			dstr_catf(dst, "%c", *p);
+	}
+	dstr_cat(dst, "\"");
+}
+
+static void export_format_line(match_counter_exporter_t *exporter, const struct export_event *event)
+{
+	struct dstr *line = &exporter->line;
+	dstr_copy(line, "");
+
+	if (exporter->format == MATCH_COUNTER_EXPORT_CSV) {
+		export_cat_timestamp(line, event->timestamp_ms);
+		dstr_cat(line, ",");
+		export_cat_csv_string(line, exporter->label);
+		dstr_catf(line, ",%s,%d,%d\n", export_event_name(event->event), event->wins, event->losses);
+	} else {
+		dstr_cat(line, "{\"timestamp\":\"");
+		export_cat_timestamp(line, event->timestamp_ms);
+		dstr_catf(line, "\",\"timestamp_ms\":%lld,\"counter\":", (long long)event->timestamp_ms);
+		export_cat_json_string(line, exporter->label);
+		dstr_catf(line, ",\"event\":\"%s\",\"wins\":%d,\"losses\":%d}\n", export_event_name(event->event),
+			  event->wins, event->losses);
+	}
+}
+
+static bool export_open(match_counter_exporter_t *exporter)
+{
+	exporter->file = os_fopen(exporter->path, "ab");
+	if (!exporter->file) {
+		blog(LOG_WARNING, "match_counter_export: Failed to open '%s'", exporter->path);
+		return false;
+	}
+
+	int64_t size = os_fgetsize(exporter->file);
+	exporter->file_size = size > 0 ? (uint64_t)size : 0;
+
+	// 新しいCSVファイルには見出しを書く
+	if (!exporter->file_size && exporter->format == MATCH_COUNTER_EXPORT_CSV) {
+		static const char header[] = "timestamp,counter,event,wins,losses\n";
+		fwrite(header, 1, sizeof(header) - 1, exporter->file);
+		exporter->file_size = sizeof(header) - 1;
+	}
+	return true;
+}
+
+// 古いファイルを1つずつずらし、現在のファイルを「パス.1」にして新しいファイルを開く
+static bool export_rotate(match_counter_exporter_t *exporter)
+{
+	fclose(exporter->file);
+	exporter->file = NULL;
+
+	struct dstr from = {0};
+	struct dstr to = {0};
+
+	if (exporter->max_files) {
+		dstr_printf(&to, "%s.%u", exporter->path, exporter->max_files);
+		os_unlink(to.array);
+
+		for (uint32_t i = exporter->max_files - 1; i > 0; i--) {
+			dstr_printf(&from, "%s.%u", exporter->path, i);
+			dstr_printf(&to, "%s.%u", exporter->path, i + 1);
+			os_rename(from.array, to.array);
+		}
+
+		dstr_printf(&to, "%s.1", exporter->path);
+		os_rename(exporter->path, to.array);
+	} else {
+		os_unlink(exporter->path);
+	}
+
+	dstr_free(&from);
+	dstr_free(&to);
+	return export_open(exporter);
+}
+
+// 溜まっている操作をまとめて書き出す（書き込みスレッドから呼ぶ）
+static void export_flush(void *data)
+{
+	match_counter_exporter_t *exporter = data;
+
+	pthread_mutex_lock(&exporter->mutex);
+	size_t count = exporter->ring_count;
+	for (size_t i = 0; i < count; i++)
+		exporter->batch[i] = exporter->ring[(exporter->ring_head + i) % EXPORT_RING_CAPACITY];
+	uint64_t dropped = exporter->dropped;
+	exporter->ring_head = 0;
+	exporter->ring_count = 0;
+	exporter->dropped = 0;
+	pthread_mutex_unlock(&exporter->mutex);
+
+	if (dropped)
+		blog(LOG_WARNING, "match_counter_export: Dropped %llu events for '%s'", (unsigned long long)dropped,
+		     exporter->path);
+
+	if (!count)
+		return;
+
+	if (!exporter->file && !export_open(exporter))
+		return;
+
+	for (size_t i = 0; i < count; i++) {
+		export_format_line(exporter, &exporter->batch[i]);
+
+		if (exporter->file_size + exporter->line.len > exporter->max_bytes && !export_rotate(exporter))
+			return;
+
+		if (fwrite(exporter->line.array, 1, exporter->line.len, exporter->file) != exporter->line.len) {
+			blog(LOG_WARNING, "match_counter_export: Failed to write '%s'", exporter->path);
+			break;
+		}
+		exporter->file_size += exporter->line.len;
+	}
+
+	fflush(exporter->file);
+}
+
+match_counter_exporter_t *match_counter_exporter_create(const char *path, enum match_counter_export_format format,
+							const char *label, uint64_t max_bytes, uint32_t max_files)
+{
+	if (!path || !*path || format == MATCH_COUNTER_EXPORT_NONE)
+		return NULL;
+
+	match_counter_exporter_t *exporter = bzalloc(sizeof(match_counter_exporter_t));
+	exporter->path = bstrdup(path);
+	exporter->label = bstrdup(label ? label : "");
+	exporter->format = format;
+	exporter->max_bytes = max_bytes;
+	exporter->max_files = max_files;
+	pthread_mutex_init(&exporter->mutex, NULL);
+	match_counter_writer_job_init(&exporter->job, export_flush, exporter);
+	return exporter;
+}
+
+void match_counter_exporter_destroy(match_counter_exporter_t *exporter)
+{
+	if (!exporter)
+		return;
+
+	match_counter_writer_finish(&exporter->job);
+
+	if (exporter->file)
+		fclose(exporter->file);
+
+	pthread_mutex_destroy(&exporter->mutex);
+	dstr_free(&exporter->line);
+	bfree(exporter->label);
+	bfree(exporter->path);
+	bfree(exporter);
+}
+
+void match_counter_exporter_push(match_counter_exporter_t *exporter, enum match_counter_journal_event event,
+				 int64_t timestamp_ms, int wins, int losses)
+{
+	pthread_mutex_lock(&exporter->mutex);
+
+	if (exporter->ring_count < EXPORT_RING_CAPACITY) {
+		struct export_event *slot =
+			&exporter->ring[(exporter->ring_head + exporter->ring_count) % EXPORT_RING_CAPACITY];
+		slot->timestamp_ms = timestamp_ms;
+		slot->event = event;
+		slot->wins = wins;
+		slot->losses = losses;
+		exporter->ring_count++;
+	} else {
+		exporter->dropped++;
+	}
+
+	// 空だったところに積んだときだけ依頼する（書き出すまでに積まれた分は同じ依頼でまとめて書き出す）
+	bool wake = exporter->ring_count == 1;
+	pthread_mutex_unlock(&exporter->mutex);
+
+	if (wake)
+		match_counter_writer_signal(&exporter->job);
+}
@@ -0,0 +1,77 @@
+/*
+Match Counter for OBS
+Copyright (C) 2025 Yudai Udagawa
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include "match-counter-journal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * 書き出すファイルの形式
+ */
+enum match_counter_export_format {
+	MATCH_COUNTER_EXPORT_NONE,   // 書き出さない
+	MATCH_COUNTER_EXPORT_CSV,    // 1行目に見出しを持つCSV
+	MATCH_COUNTER_EXPORT_NDJSON, // 1行1件のJSON
+};
+
+/**
+ * 勝敗の操作をタイムスタンプ付きでファイルに書き出すエクスポーター
+ *
+ * 操作は固定長のリングバッファに積むだけで、整形と書き込みは共有の書き込みスレッド（match-counter-writer.h）がまとめて行う。
+ * ファイルが上限の大きさを超えると「パス.1」「パス.2」…とずらして新しいファイルに切り替える。
+ */
+typedef struct match_counter_exporter match_counter_exporter_t;
+
+/**
+ * エクスポーターを作成する
+ * @param path 書き出すファイルのパス
+ * @param format ファイルの形式（CSVまたはNDJSON）
+ * @param label 各行に書き出すカウンターの名前
+ * @param max_bytes 1ファイルの大きさの上限（バイト）
+ * @param max_files 残しておく古いファイルの数（0なら上限を超えたら作り直す）
+ * @return エクスポーター（作成できなかった場合はNULL）
+ */
+match_counter_exporter_t *match_counter_exporter_create(const char *path, enum match_counter_export_format format,
+							const char *label, uint64_t max_bytes, uint32_t max_files);
+
+/**
+ * 積まれている操作を書き出してからエクスポーターを破棄する
+ * @param exporter エクスポーター（NULLなら何もしない）
+ */
+void match_counter_exporter_destroy(match_counter_exporter_t *exporter);
+
+/**
+ * 操作を書き出し待ちに積む（ファイルへの書き込みを待たない）
+ * @param exporter エクスポーター
+ * @param event 適用された操作
+ * @param timestamp_ms 操作の時刻（UNIX時間のミリ秒）
+ * @param wins 適用後の勝利数
+ * @param losses 適用後の敗北数
+ *
+ * リングバッファが一杯の場合は捨て、捨てた数を次の書き込み時にログへ出力する
+ */
+void match_counter_exporter_push(match_counter_exporter_t *exporter, enum match_counter_journal_event event,
+				 int64_t timestamp_ms, int wins, int losses);
+
+#ifdef __cplusplus
+}
+#endif
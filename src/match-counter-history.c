@@ -0,0 +1,263 @@
+/*
+Match Counter for OBS
+Copyright (C) 2025 Yudai Udagawa
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include "match-counter-history.h"
+#include "match-counter-atomic.h"
+#include <time.h>
+
+#define MATCH_COUNTER_HISTORY_MASK (MATCH_COUNTER_HISTORY_CAPACITY - 1)
+
+static inline struct match_counter_history_entry *entry_at(match_counter_history_t *history, uint64_t seq)
+{
+	return &history->entries[seq & MATCH_COUNTER_HISTORY_MASK];
+}
+
+// 最後からn試合より前の時点の累計勝利数（mutexを取った状態で呼ぶ）
+static uint32_t wins_total_before(match_counter_history_t *history, size_t n_from_last)
+{
+	if (n_from_last >= history->count)
+		return history->base_wins_total;
+
+	return entry_at(history, history->next - 1 - n_from_last)->wins_total;
+}
+
+// 集計値を読み手向けに公開する（mutexを取った状態で呼ぶ）
+static void publish_stats(match_counter_history_t *history)
+{
+	int32_t streak = history->base_streak;
+	uint32_t best = history->base_best_streak;
+	uint32_t recent_wins = 0;
+	size_t recent_total = history->count < history->window ? history->count : history->window;
+
+	if (history->count) {
+		const struct match_counter_history_entry *last = entry_at(history, history->next - 1);
+		streak = last->streak;
+		best = last->best_streak;
+
+		// 直近N試合の勝利数は累計値の差で求める
+		recent_wins = last->wins_total - wins_total_before(history, recent_total);
+	}
+
+	match_counter_atomic_store_u64(&history->streak_state, (uint64_t)(uint32_t)streak | ((uint64_t)best << 32));
+	os_atomic_set_long(&history->recent_state, (long)(recent_wins | ((uint32_t)recent_total << 16)));
+}
+
+match_counter_history_t *match_counter_history_create(uint32_t window)
+{
+	match_counter_history_t *history = bzalloc(sizeof(match_counter_history_t));
+	pthread_mutex_init(&history->mutex, NULL);
+	history->window = MATCH_COUNTER_HISTORY_DEFAULT_WINDOW;
+	match_counter_history_set_window(history, window);
+	return history;
+}
+
+void match_counter_history_destroy(match_counter_history_t *history)
+{
+	if (!history)
+		return;
+
+	pthread_mutex_destroy(&history->mutex);
+	bfree(history);
+}
+
+void match_counter_history_push(match_counter_history_t *history, enum match_result result, int64_t timestamp_ms)
+{
+	if (!history)
+		return;
+
+	pthread_mutex_lock(&history->mutex);
+
+	uint32_t wins_total = history->base_wins_total;
+	int32_t streak = history->base_streak;
+	uint32_t best = history->base_best_streak;
+
+	if (history->count) {
+		const struct match_counter_history_entry *last = entry_at(history, history->next - 1);
+		wins_total = last->wins_total;
+		streak = last->streak;
+		best = last->best_streak;
+	}
+
+	// 容量いっぱいなら最も古い試合を捨て、その値を基準として残す
+	if (history->count == MATCH_COUNTER_HISTORY_CAPACITY) {
+		const struct match_counter_history_entry *oldest = entry_at(history, history->next);
+		history->base_wins_total = oldest->wins_total;
+		history->base_streak = oldest->streak;
+		history->base_best_streak = oldest->best_streak;
+		history->count--;
+	}
+
+	struct match_counter_history_entry *entry = entry_at(history, history->next);
+	entry->timestamp_ms = timestamp_ms;
+	entry->result = (uint8_t)result;
+
+	if (result == MATCH_RESULT_WIN) {
+		entry->wins_total = wins_total + 1;
+		entry->streak = streak > 0 ? streak + 1 : 1;
+		entry->best_streak = (uint32_t)entry->streak > best ? (uint32_t)entry->streak : best;
+	} else {
+		entry->wins_total = wins_total;
+		entry->streak = streak < 0 ? streak - 1 : -1;
+		entry->best_streak = best;
+	}
+
+	history->next++;
+	history->count++;
+
+	publish_stats(history);
+	pthread_mutex_unlock(&history->mutex);
+}
+
+bool match_counter_history_pop(match_counter_history_t *history, enum match_result result)
+{
+	if (!history)
+		return false;
+
+	bool popped = false;
+
+	pthread_mutex_lock(&history->mutex);
+
+	if (history->count && entry_at(history, history->next - 1)->result == (uint8_t)result) {
+		// 各試合が時点の累計値を持っているので、1つ戻すだけで集計も元に戻る
+		history->next--;
+		history->count--;
+		publish_stats(history);
+		popped = true;
+	}
+
+	pthread_mutex_unlock(&history->mutex);
+	return popped;
+}
+
+void match_counter_history_clear(match_counter_history_t *history)
+{
+	if (!history)
+		return;
+
+	pthread_mutex_lock(&history->mutex);
+
+	history->count = 0;
+	history->base_wins_total = 0;
+	history->base_streak = 0;
+	history->base_best_streak = 0;
+	publish_stats(history);
+
+	pthread_mutex_unlock(&history->mutex);
+}
+
+bool match_counter_history_set_window(match_counter_history_t *history, uint32_t window)
+{
+	if (!history)
+		return false;
+
+	if (window < 1)
+		window = 1;
+	if (window > MATCH_COUNTER_HISTORY_MAX_WINDOW)
+		window = MATCH_COUNTER_HISTORY_MAX_WINDOW;
+
+	pthread_mutex_lock(&history->mutex);
+	bool changed = history->window != window;
+	history->window = window;
+	publish_stats(history);
+	pthread_mutex_unlock(&history->mutex);
+
+	return changed;
+}
+
+uint32_t match_counter_history_get_window(match_counter_history_t *history)
+{
+	if (!history)
+		return 0;
+
+	pthread_mutex_lock(&history->mutex);
+	uint32_t window = history->window;
+	pthread_mutex_unlock(&history->mutex);
+
+	return window;
+}
+
+void match_counter_history_get_stats(match_counter_history_t *history, struct match_counter_history_stats *stats)
+{
+	if (!history) {
+		memset(stats, 0, sizeof(*stats));
+		return;
+	}
+
+	uint64_t streak_state = match_counter_atomic_load_u64(&history->streak_state);
+	unsigned long recent_state = (unsigned long)os_atomic_load_long(&history->recent_state);
+
+	stats->streak = (int32_t)(uint32_t)(streak_state & 0xFFFFFFFFu);
+	stats->best_streak = (int)(uint32_t)(streak_state >> 32);
+	stats->recent_wins = (int)(recent_state & 0xFFFF);
+	stats->recent_total = (int)((recent_state >> 16) & 0xFFFF);
+}
+
+size_t match_counter_history_get_entries(match_counter_history_t *history,
+					 struct match_counter_history_entry *entries)
+{
+	if (!history)
+		return 0;
+
+	pthread_mutex_lock(&history->mutex);
+
+	size_t count = history->count;
+	uint64_t first = history->next - count;
+	for (size_t i = 0; i < count; i++)
+		entries[i] = *entry_at(history, first + i);
+
+	pthread_mutex_unlock(&history->mutex);
+	return count;
+}
+
+void match_counter_history_get_base(match_counter_history_t *history, struct match_counter_history_base *base)
+{
+	if (!history) {
+		memset(base, 0, sizeof(*base));
+		return;
+	}
+
+	pthread_mutex_lock(&history->mutex);
+	base->wins_total = history->base_wins_total;
+	base->streak = history->base_streak;
+	base->best_streak = history->base_best_streak;
+	pthread_mutex_unlock(&history->mutex);
+}
+
+void match_counter_history_set_base(match_counter_history_t *history, const struct match_counter_history_base *base)
+{
+	if (!history)
+		return;
+
+	pthread_mutex_lock(&history->mutex);
+
+	if (!history->count) {
+		history->base_wins_total = base->wins_total;
+		history->base_streak = base->streak;
+		history->base_best_streak = base->best_streak;
+		publish_stats(history);
+	}
+
+	pthread_mutex_unlock(&history->mutex);
+}
+
+int64_t match_counter_history_now_ms(void)
+{
+	struct timespec ts;
+	timespec_get(&ts, TIME_UTC);
+	return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
@@ -0,0 +1,200 @@
+/*
+Match Counter for OBS
+Copyright (C) 2025 Yudai Udagawa
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include <obs-module.h>
+#include <util/threading.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * 保持する試合結果の最大数（2のべき乗）
+ */
+#define MATCH_COUNTER_HISTORY_CAPACITY 256
+
+/**
+ * 直近N試合の集計に使えるNの最大値
+ */
+#define MATCH_COUNTER_HISTORY_MAX_WINDOW (MATCH_COUNTER_HISTORY_CAPACITY - 1)
+
+/**
+ * 直近N試合のデフォルト値
+ */
+#define MATCH_COUNTER_HISTORY_DEFAULT_WINDOW 10
+
+/**
+ * 試合結果
+ */
+enum match_result {
+	MATCH_RESULT_WIN,
+	MATCH_RESULT_LOSS,
+};
+
+/**
+ * 履歴の1試合分
+ *
+ * 集計をO(1)で求められるよう、その試合時点の累計値を一緒に持つ
+ */
+struct match_counter_history_entry {
+	int64_t timestamp_ms; // 試合結果を記録したUNIX時刻（ミリ秒）
+	uint32_t wins_total;  // 履歴の記録開始からこの試合までの勝利数
+	int32_t streak;       // この試合後の連勝数（正）または連敗数（負）
+	uint32_t best_streak; // この試合時点での最長連勝数
+	uint8_t result;       // enum match_result
+};
+
+/**
+ * 履歴から求めた集計値
+ */
+struct match_counter_history_stats {
+	int streak;       // 現在の連勝数（正）または連敗数（負）
+	int best_streak;  // 最長連勝数
+	int recent_wins;  // 直近N試合の勝利数
+	int recent_total; // 直近N試合の試合数（履歴がN未満ならその数）
+};
+
+/**
+ * 履歴の最も古い試合より前から引き継ぐ基準値
+ */
+struct match_counter_history_base {
+	uint32_t wins_total;  // それまでの累計勝利数
+	int32_t streak;       // それまでの連勝数（正）または連敗数（負）
+	uint32_t best_streak; // それまでの最長連勝数
+};
+
+/**
+ * 試合結果の履歴（固定長のリングバッファ）
+ *
+ * 書き込みはmutexで直列化し、集計値はアトミックに公開するため読み出しはロックを取らない
+ */
+typedef struct match_counter_history {
+	struct match_counter_history_entry entries[MATCH_COUNTER_HISTORY_CAPACITY];
+	uint64_t next;   // 次に書き込む通し番号
+	size_t count;    // 保持している試合数
+	uint32_t window; // 直近何試合を集計するか
+
+	// 容量を超えて捨てた最後の試合の値（履歴が空になったときの基準）
+	uint32_t base_wins_total;
+	int32_t base_streak;
+	uint32_t base_best_streak;
+
+	pthread_mutex_t mutex;
+
+	// 公開中の集計値
+	volatile uint64_t streak_state; // 下位32bit: 連勝/連敗数, 上位32bit: 最長連勝数
+	volatile long recent_state;     // 下位16bit: 直近の勝利数, 上位16bit: 直近の試合数
+} match_counter_history_t;
+
+/**
+ * 履歴を作成する
+ * @param window 直近何試合を集計するか
+ * @return 作成した履歴
+ */
+match_counter_history_t *match_counter_history_create(uint32_t window);
+
+/**
+ * 履歴を破棄する
+ * @param history 履歴
+ */
+void match_counter_history_destroy(match_counter_history_t *history);
+
+/**
+ * 試合結果を追加する
+ * @param history 履歴
+ * @param result 試合結果
+ * @param timestamp_ms 試合結果を記録したUNIX時刻（ミリ秒）
+ *
+ * 容量を超えた場合は最も古い試合を捨てる
+ */
+void match_counter_history_push(match_counter_history_t *history, enum match_result result, int64_t timestamp_ms);
+
+/**
+ * 最後の試合結果を取り消す
+ * @param history 履歴
+ * @param result 取り消す試合結果
+ * @return 最後の試合がresultで、取り消した場合はtrue
+ */
+bool match_counter_history_pop(match_counter_history_t *history, enum match_result result);
+
+/**
+ * 履歴を空にする
+ * @param history 履歴
+ */
+void match_counter_history_clear(match_counter_history_t *history);
+
+/**
+ * 直近何試合を集計するかを設定する
+ * @param history 履歴
+ * @param window 試合数（1～MATCH_COUNTER_HISTORY_MAX_WINDOW）
+ * @return 値が変わった場合はtrue
+ */
+bool match_counter_history_set_window(match_counter_history_t *history, uint32_t window);
+
+/**
+ * 直近何試合を集計するかを取得する
+ * @param history 履歴
+ * @return 試合数
+ */
+uint32_t match_counter_history_get_window(match_counter_history_t *history);
+
+/**
+ * 集計値を取得する
+ * @param history 履歴
+ * @param stats 集計値の格納先
+ *
+ * 履歴の長さに関係なくO(1)で、ロックも取らない
+ */
+void match_counter_history_get_stats(match_counter_history_t *history, struct match_counter_history_stats *stats);
+
+/**
+ * 保持している試合結果を古い順にコピーする
+ * @param history 履歴
+ * @param entries コピー先（MATCH_COUNTER_HISTORY_CAPACITY個分の領域）
+ * @return コピーした試合数
+ */
+size_t match_counter_history_get_entries(match_counter_history_t *history,
+					 struct match_counter_history_entry *entries);
+
+/**
+ * 容量を超えて捨てた試合から引き継いでいる基準値を取得する
+ * @param history 履歴
+ * @param base 基準値の格納先
+ */
+void match_counter_history_get_base(match_counter_history_t *history, struct match_counter_history_base *base);
+
+/**
+ * 基準値を設定する（保存していた履歴を復元するときに使う）
+ * @param history 履歴
+ * @param base 基準値
+ *
+ * 以降に追加する試合の集計の起点になるため、試合を追加する前の空の履歴に対して呼ぶ（空でなければ何もしない）
+ */
+void match_counter_history_set_base(match_counter_history_t *history, const struct match_counter_history_base *base);
+
+/**
+ * 現在のUNIX時刻をミリ秒で取得する
+ * @return UNIX時刻（ミリ秒）
+ */
+int64_t match_counter_history_now_ms(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,395 @@
+/*
+Match Counter for OBS
+Copyright (C) 2025 Yudai Udagawa
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include "match-counter-journal.h"
+#include "match-counter-writer.h"
+#include <util/darray.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+#include <util/threading.h>
+
+// レコードの識別子（"MCJ1"）
+#define JOURNAL_MAGIC 0x314A434Du
+// この数のレコードを追記したらファイルを圧縮する
+#define JOURNAL_COMPACT_THRESHOLD 4096
+// 圧縮したファイルの先頭に置く、履歴の基準値のレコードの種類（enum match_counter_journal_eventとは重ならない）
+// winsに累計勝利数、lossesに連勝数、reservedに最長連勝数を入れる
+#define JOURNAL_RECORD_HISTORY_BASE 0x100u
+
+// ファイルに書き込む固定長（32バイト）のレコード
+struct journal_record {
+	uint32_t magic;
+	uint32_t type; // enum match_counter_journal_event
+	int64_t timestamp_ms;
+	int32_t wins;   // イベント適用後の勝利数
+	int32_t losses; // イベント適用後の敗北数
+	uint32_t reserved;
+	uint32_t checksum; // checksumより前のバイトのFNV-1a
+};
+
+struct match_counter_journal {
+	char *path;
+
+	// 書き込みスレッドだけが触る
+	FILE *file;
+	size_t records;                        // 前回の圧縮以降に追記したレコード数
+	match_counter_history_t *history;      // 圧縮に使う、書き出したレコードまでの履歴
+	int wins;                              // 書き出した最後のレコードの勝利数
+	int losses;                            // 書き出した最後のレコードの敗北数
+	DARRAY(struct journal_record) writing; // pendingから受け取って書き出し中のレコード
+
+	pthread_mutex_t mutex;
+	DARRAY(struct journal_record) pending; // 書き込みスレッドに渡すレコード（mutexで保護）
+	bool batching; // match_counter_journal_begin_batchからend_batchまでの間は書き込みスレッドを起こさない
+
+	struct match_counter_writer_job job;
+};
+
+static uint32_t record_checksum(const struct journal_record *record)
+{
+	const uint8_t *bytes = (const uint8_t *)record;
+	uint32_t hash = 2166136261u;
+
+	for (size_t i = 0; i < offsetof(struct journal_record, checksum); i++) {
+		hash ^= bytes[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+static void fill_record(struct journal_record *record, enum match_counter_journal_event event, int64_t timestamp_ms,
+			int wins, int losses)
+{
+	memset(record, 0, sizeof(*record));
+	record->magic = JOURNAL_MAGIC;
+	record->type = (uint32_t)event;
+	record->timestamp_ms = timestamp_ms;
+	record->wins = wins;
+	record->losses = losses;
+	record->checksum = record_checksum(record);
+}
+
+static void fill_base_record(struct journal_record *record, const struct match_counter_history_base *base)
+{
+	memset(record, 0, sizeof(*record));
+	record->magic = JOURNAL_MAGIC;
+	record->type = JOURNAL_RECORD_HISTORY_BASE;
+	record->timestamp_ms = match_counter_history_now_ms();
+	record->wins = (int32_t)base->wins_total;
+	record->losses = base->streak;
+	record->reserved = base->best_streak;
+	record->checksum = record_checksum(record);
+}
+
+static bool write_record(FILE *file, const struct journal_record *record)
+{
+	return fwrite(record, sizeof(*record), 1, file) == 1;
+}
+
+// レコードのイベントを履歴に反映する
+static void apply_record(match_counter_history_t *history, const struct journal_record *record)
+{
+	switch ((enum match_counter_journal_event)record->type) {
+	case MATCH_COUNTER_JOURNAL_WIN:
+		match_counter_history_push(history, MATCH_RESULT_WIN, record->timestamp_ms);
+		break;
+	case MATCH_COUNTER_JOURNAL_LOSS:
+		match_counter_history_push(history, MATCH_RESULT_LOSS, record->timestamp_ms);
+		break;
+	case MATCH_COUNTER_JOURNAL_UNDO_WIN:
+		match_counter_history_pop(history, MATCH_RESULT_WIN);
+		break;
+	case MATCH_COUNTER_JOURNAL_UNDO_LOSS:
+		match_counter_history_pop(history, MATCH_RESULT_LOSS);
+		break;
+	case MATCH_COUNTER_JOURNAL_RESET:
+		match_counter_history_clear(history);
+		break;
+	case MATCH_COUNTER_JOURNAL_SNAPSHOT:
+	case MATCH_COUNTER_JOURNAL_SET:
+		break;
+	}
+}
+
+// ジャーナルを先頭から再生してcounterに反映する
+static bool replay(const char *path, match_counter_t *counter)
+{
+	FILE *file = os_fopen(path, "rb");
+	if (!file)
+		return false;
+
+	struct journal_record record;
+	size_t count = 0;
+	int wins = 0;
+	int losses = 0;
+
+	while (fread(&record, sizeof(record), 1, file) == 1) {
+		// 書き込み途中で落ちた末尾のレコードは捨てる
+		if (record.magic != JOURNAL_MAGIC || record.checksum != record_checksum(&record)) {
+			blog(LOG_WARNING, "match_counter_journal: Ignoring invalid record %zu in '%s'", count, path);
+			break;
+		}
+
+		count++;
+
+		// 容量を超えて捨てた試合の連勝数や最長連勝数は、履歴より先に基準値として戻す
+		if (record.type == JOURNAL_RECORD_HISTORY_BASE) {
+			struct match_counter_history_base base;
+			base.wins_total = (uint32_t)record.wins;
+			base.streak = record.losses;
+			base.best_streak = record.reserved;
+			match_counter_history_set_base(counter->history, &base);
+			continue;
+		}
+
+		apply_record(counter->history, &record);
+		wins = record.wins;
+		losses = record.losses;
+	}
+
+	fclose(file);
+
+	if (!count)
+		return false;
+
+	match_counter_set_wins(counter, wins);
+	match_counter_set_losses(counter, losses);
+
+	blog(LOG_INFO, "match_counter_journal: Replayed %zu records from '%s' (wins=%d, losses=%d)", count, path, wins,
+	     losses);
+	return true;
+}
+
+// 履歴の基準値と履歴、スナップショットだけのファイルに書き直す（書き込みスレッドか、書き出しを依頼する前に呼ぶ）
+static bool compact(match_counter_journal_t *journal, match_counter_history_t *history, int wins, int losses)
+{
+	struct dstr tmp_path = {0};
+	dstr_printf(&tmp_path, "%s.tmp", journal->path);
+
+	FILE *file = os_fopen(tmp_path.array, "wb");
+	if (!file) {
+		blog(LOG_WARNING, "match_counter_journal: Failed to create '%s'", tmp_path.array);
+		dstr_free(&tmp_path);
+		return false;
+	}
+
+	struct match_counter_history_entry *entries =
+		bmalloc(sizeof(struct match_counter_history_entry) * MATCH_COUNTER_HISTORY_CAPACITY);
+	size_t num_entries = match_counter_history_get_entries(history, entries);
+
+	struct match_counter_history_base base;
+	match_counter_history_get_base(history, &base);
+
+	// 基準値、履歴を古い順に書き出し、最後にスナップショットを置く
+	struct journal_record record;
+	fill_base_record(&record, &base);
+	bool success = write_record(file, &record);
+
+	for (size_t i = 0; i < num_entries && success; i++) {
+		enum match_counter_journal_event event = entries[i].result == MATCH_RESULT_WIN
+								 ? MATCH_COUNTER_JOURNAL_WIN
+								 : MATCH_COUNTER_JOURNAL_LOSS;
+		fill_record(&record, event, entries[i].timestamp_ms, wins, losses);
+		success = write_record(file, &record);
+	}
+
+	fill_record(&record, MATCH_COUNTER_JOURNAL_SNAPSHOT, match_counter_history_now_ms(), wins, losses);
+	success = success && write_record(file, &record) && fflush(file) == 0;
+	fclose(file);
+	bfree(entries);
+
+	if (success) {
+		if (journal->file) {
+			fclose(journal->file);
+			journal->file = NULL;
+		}
+		success = os_rename(tmp_path.array, journal->path) == 0;
+	}
+
+	if (!success) {
+		blog(LOG_WARNING, "match_counter_journal: Failed to compact '%s'", journal->path);
+		os_unlink(tmp_path.array);
+	}
+
+	dstr_free(&tmp_path);
+
+	if (!journal->file)
+		journal->file = os_fopen(journal->path, "ab");
+
+	journal->records = 0;
+	return success && journal->file;
+}
+
+// 渡されたレコードをまとめて書き出す（書き込みスレッドから呼ぶ）
+static void journal_flush(void *data)
+{
+	match_counter_journal_t *journal = data;
+
+	// 書き出し中も追記を止めないよう、配列ごと受け取る
+	pthread_mutex_lock(&journal->mutex);
+	struct darray swap = journal->writing.da;
+	journal->writing.da = journal->pending.da;
+	journal->pending.da = swap;
+	pthread_mutex_unlock(&journal->mutex);
+
+	if (!journal->writing.num)
+		return;
+
+	bool success = true;
+	for (size_t i = 0; i < journal->writing.num; i++) {
+		const struct journal_record *record = &journal->writing.array[i];
+
+		apply_record(journal->history, record);
+		journal->wins = record->wins;
+		journal->losses = record->losses;
+
+		if (!journal->file)
+			continue;
+
+		success = write_record(journal->file, record) && success;
+
+		if (++journal->records >= JOURNAL_COMPACT_THRESHOLD)
+			compact(journal, journal->history, journal->wins, journal->losses);
+	}
+
+	// クラッシュしても失われないよう、受け取った単位でOSに渡す
+	if (!journal->file || !success || fflush(journal->file) != 0)
+		blog(LOG_WARNING, "match_counter_journal: Failed to append to '%s'", journal->path);
+
+	da_resize(journal->writing, 0);
+}
+
+static void journal_free(match_counter_journal_t *journal)
+{
+	if (journal->file)
+		fclose(journal->file);
+
+	match_counter_history_destroy(journal->history);
+	da_free(journal->writing);
+	da_free(journal->pending);
+	pthread_mutex_destroy(&journal->mutex);
+	bfree(journal->path);
+	bfree(journal);
+}
+
+match_counter_journal_t *match_counter_journal_open(const char *path, match_counter_t *counter)
+{
+	if (!path || !counter)
+		return NULL;
+
+	match_counter_journal_t *journal = bzalloc(sizeof(match_counter_journal_t));
+	journal->path = bstrdup(path);
+	journal->history = match_counter_history_create(1);
+	pthread_mutex_init(&journal->mutex, NULL);
+	match_counter_writer_job_init(&journal->job, journal_flush, journal);
+
+	replay(path, counter);
+
+	// 以降の圧縮は書き込みスレッドが受け取ったレコードから行うので、再生した履歴を基準値ごと写しておく
+	struct match_counter_history_base base;
+	match_counter_history_get_base(counter->history, &base);
+	match_counter_history_set_base(journal->history, &base);
+
+	struct match_counter_history_entry *entries =
+		bmalloc(sizeof(struct match_counter_history_entry) * MATCH_COUNTER_HISTORY_CAPACITY);
+	size_t num_entries = match_counter_history_get_entries(counter->history, entries);
+	for (size_t i = 0; i < num_entries; i++)
+		match_counter_history_push(journal->history, entries[i].result, entries[i].timestamp_ms);
+	bfree(entries);
+
+	journal->wins = match_counter_get_wins(counter);
+	journal->losses = match_counter_get_losses(counter);
+
+	// 再生済みの内容を圧縮して、以降は追記だけにする
+	if (!compact(journal, journal->history, journal->wins, journal->losses)) {
+		blog(LOG_WARNING, "match_counter_journal: Failed to open '%s'", path);
+		journal_free(journal);
+		return NULL;
+	}
+
+	return journal;
+}
+
+void match_counter_journal_close(match_counter_journal_t *journal)
+{
+	if (!journal)
+		return;
+
+	match_counter_writer_finish(&journal->job);
+	journal_free(journal);
+}
+
+void match_counter_journal_delete(match_counter_journal_t *journal)
+{
+	if (!journal)
+		return;
+
+	match_counter_writer_finish(&journal->job);
+
+	if (journal->file) {
+		fclose(journal->file);
+		journal->file = NULL;
+	}
+
+	os_unlink(journal->path);
+	journal_free(journal);
+}
+
+void match_counter_journal_append(match_counter_journal_t *journal, enum match_counter_journal_event event,
+				  match_counter_t *counter)
+{
+	if (!journal || !counter)
+		return;
+
+	struct journal_record record;
+	fill_record(&record, event, match_counter_history_now_ms(), match_counter_get_wins(counter),
+		    match_counter_get_losses(counter));
+
+	pthread_mutex_lock(&journal->mutex);
+	da_push_back(journal->pending, &record);
+	// 空だったところに積んだときだけ依頼する（それ以外は依頼済みか、end_batchで依頼する）
+	bool wake = !journal->batching && journal->pending.num == 1;
+	pthread_mutex_unlock(&journal->mutex);
+
+	if (wake)
+		match_counter_writer_signal(&journal->job);
+}
+
+void match_counter_journal_begin_batch(match_counter_journal_t *journal)
+{
+	if (!journal)
+		return;
+
+	pthread_mutex_lock(&journal->mutex);
+	journal->batching = true;
+	pthread_mutex_unlock(&journal->mutex);
+}
+
+void match_counter_journal_end_batch(match_counter_journal_t *journal)
+{
+	if (!journal)
+		return;
+
+	pthread_mutex_lock(&journal->mutex);
+	journal->batching = false;
+	bool wake = journal->pending.num > 0;
+	pthread_mutex_unlock(&journal->mutex);
+
+	if (wake)
+		match_counter_writer_signal(&journal->job);
+}
@@ -0,0 +1,101 @@
+/*
+Match Counter for OBS
+Copyright (C) 2025 Yudai Udagawa
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include "match-counter.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * ジャーナルに記録するイベントの種類
+ */
+enum match_counter_journal_event {
+	MATCH_COUNTER_JOURNAL_SNAPSHOT,  // 圧縮時点の勝敗数
+	MATCH_COUNTER_JOURNAL_WIN,       // 勝利を追加
+	MATCH_COUNTER_JOURNAL_LOSS,      // 敗北を追加
+	MATCH_COUNTER_JOURNAL_UNDO_WIN,  // 勝利を取り消し
+	MATCH_COUNTER_JOURNAL_UNDO_LOSS, // 敗北を取り消し
+	MATCH_COUNTER_JOURNAL_RESET,     // リセット
+	MATCH_COUNTER_JOURNAL_SET,       // プロパティなどから勝敗数を直接設定
+};
+
+/**
+ * 試合カウンターの変更を追記していくジャーナル
+ *
+ * 各イベントは固定長のバイナリレコードとしてファイル末尾に追記され、
+ * 読み込み時は最後に圧縮したスナップショットから再生して勝敗数と履歴を復元する。
+ * ファイルへの書き込みと圧縮は、すべてのジャーナルで共有する書き込みスレッドで行う（match-counter-writer.h）。
+ */
+typedef struct match_counter_journal match_counter_journal_t;
+
+/**
+ * ジャーナルを開く
+ * @param path ジャーナルファイルのパス
+ * @param counter 復元先の試合カウンター
+ * @return 開いたジャーナル。開けなかった場合はNULL
+ *
+ * ファイルが存在すれば内容を再生してcounterに反映し、その後ファイルを圧縮する。
+ * 存在しなければcounterの現在の値をスナップショットとして新しく作成する。
+ */
+match_counter_journal_t *match_counter_journal_open(const char *path, match_counter_t *counter);
+
+/**
+ * ジャーナルを閉じる
+ * @param journal ジャーナル
+ *
+ * 書き込みスレッドに渡したレコードをすべて書き出してから閉じる
+ */
+void match_counter_journal_close(match_counter_journal_t *journal);
+
+/**
+ * ジャーナルを閉じてファイルを削除する
+ * @param journal ジャーナル
+ */
+void match_counter_journal_delete(match_counter_journal_t *journal);
+
+/**
+ * イベントを追記する
+ * @param journal ジャーナル
+ * @param event イベントの種類
+ * @param counter イベント適用後の試合カウンター
+ *
+ * 固定長のレコードを1つ書き込みスレッドに渡すだけで、ファイルの書き込みや圧縮は待たない
+ */
+void match_counter_journal_append(match_counter_journal_t *journal, enum match_counter_journal_event event,
+				  match_counter_t *counter);
+
+/**
+ * 以降の追記をまとめて書き込むようにする
+ * @param journal ジャーナル
+ *
+ * match_counter_journal_end_batchまでの追記では書き込みスレッドを起こさず、end_batchでまとめて書き出させる
+ */
+void match_counter_journal_begin_batch(match_counter_journal_t *journal);
+
+/**
+ * まとめていた追記を書き込みスレッドに書き出させる
+ * @param journal ジャーナル
+ */
+void match_counter_journal_end_batch(match_counter_journal_t *journal);
+
+#ifdef __cplusplus
+}
+#endif
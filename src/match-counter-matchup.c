@@ -0,0 +1,398 @@
+/*
+Match Counter for OBS
+Copyright (C) 2025 Yudai Udagawa
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include "match-counter-matchup.h"
+#include "match-counter-writer.h"
+#include <util/darray.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <stdio.h>
+
+// 最初に確保するスロット数（2のべき乗）
+#define MATCHUP_INITIAL_CAPACITY 64
+// レコードの識別子（"MCM1"）
+#define MATCHUP_MAGIC 0x314D434Du
+// 前回の書き直し以降の追記がこの数と記録の数の両方を超えたら書き直す
+#define MATCHUP_COMPACT_THRESHOLD 4096
+
+// ファイルに書き込む固定長（48バイト）のレコード
+struct matchup_record {
+	uint32_t magic;
+	int32_t wins;
+	int32_t losses;
+	uint8_t key_len;
+	char key[MATCH_COUNTER_MATCHUP_KEY_SIZE - 1];
+	uint32_t checksum; // checksumより前のバイトのFNV-1a
+};
+
+struct match_counter_matchup_store {
+	char *path;
+
+	// 書き込みスレッドだけが触る
+	FILE *file;
+	match_counter_matchup_table_t table;           // 書き直しに使う、書き出した記録までのテーブルの写し
+	size_t records;                                // 前回の書き直し以降に追記したレコード数
+	DARRAY(struct match_counter_matchup) writing; // pendingから受け取って書き出し中の記録
+
+	pthread_mutex_t mutex;
+	DARRAY(struct match_counter_matchup) pending; // 書き込みスレッドに渡す記録（mutexで保護）
+
+	struct match_counter_writer_job job;
+};
+
+void match_counter_matchup_table_init(match_counter_matchup_table_t *table)
+{
+	memset(table, 0, sizeof(*table));
+}
+
+void match_counter_matchup_table_free(match_counter_matchup_table_t *table)
+{
+	bfree(table->slots);
+	memset(table, 0, sizeof(*table));
+}
+
+uint32_t match_counter_matchup_hash(const char *key, size_t len)
+{
+	uint32_t hash = 2166136261u;
+
+	for (size_t i = 0; i < len; i++) {
+		hash ^= (unsigned char)key[i];
+		hash *= 16777619u;
+	}
+
+	// 0は空きスロットの印に使う
+	return hash ? hash : 1;
+}
+
+static inline bool matchup_equals(const struct match_counter_matchup *slot, const char *key, size_t len,
+				  uint32_t hash)
+{
+	return slot->hash == hash && slot->key_len == len && memcmp(slot->key, key, len) == 0;
+}
+
+struct match_counter_matchup *match_counter_matchup_find(match_counter_matchup_table_t *table, const char *key,
+							 size_t len, uint32_t hash)
+{
+	if (!table->capacity)
+		return NULL;
+
+	uint32_t mask = table->capacity - 1;
+	for (uint32_t i = hash & mask;; i = (i + 1) & mask) {
+		struct match_counter_matchup *slot = &table->slots[i];
+		if (!slot->hash)
+			return NULL;
+		if (matchup_equals(slot, key, len, hash))
+			return slot;
+	}
+}
+
+// 空きスロットを探して置く（同じキーがないことは呼び出し側で確認済み）
+static struct match_counter_matchup *matchup_place(struct match_counter_matchup *slots, uint32_t capacity,
+						   const struct match_counter_matchup *matchup)
+{
+	uint32_t mask = capacity - 1;
+	uint32_t i = matchup->hash & mask;
+	while (slots[i].hash)
+		i = (i + 1) & mask;
+
+	slots[i] = *matchup;
+	return &slots[i];
+}
+
+// 使用率が3/4を超えないよう、スロット数を倍にして置き直す
+static void matchup_grow(match_counter_matchup_table_t *table)
+{
+	uint32_t capacity = table->capacity ? table->capacity * 2 : MATCHUP_INITIAL_CAPACITY;
+	struct match_counter_matchup *slots = bzalloc(sizeof(struct match_counter_matchup) * capacity);
+
+	for (uint32_t i = 0; i < table->capacity; i++) {
+		if (table->slots[i].hash)
+			matchup_place(slots, capacity, &table->slots[i]);
+	}
+
+	bfree(table->slots);
+	table->slots = slots;
+	table->capacity = capacity;
+}
+
+struct match_counter_matchup *match_counter_matchup_insert(match_counter_matchup_table_t *table, const char *key,
+							   size_t len, uint32_t hash)
+{
+	if (len >= MATCH_COUNTER_MATCHUP_KEY_SIZE)
+		return NULL;
+
+	struct match_counter_matchup *found = match_counter_matchup_find(table, key, len, hash);
+	if (found)
+		return found;
+
+	if ((table->count + 1) * 4 > table->capacity * 3)
+		matchup_grow(table);
+
+	struct match_counter_matchup matchup = {0};
+	matchup.hash = hash;
+	matchup.key_len = (uint8_t)len;
+	memcpy(matchup.key, key, len);
+
+	table->count++;
+	return matchup_place(table->slots, table->capacity, &matchup);
+}
+
+static uint32_t record_checksum(const struct matchup_record *record)
+{
+	const uint8_t *bytes = (const uint8_t *)record;
+	uint32_t hash = 2166136261u;
+
+	for (size_t i = 0; i < offsetof(struct matchup_record, checksum); i++) {
+		hash ^= bytes[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+static bool write_record(FILE *file, const struct match_counter_matchup *matchup)
+{
+	struct matchup_record record;
+	memset(&record, 0, sizeof(record));
+	record.magic = MATCHUP_MAGIC;
+	record.wins = matchup->wins;
+	record.losses = matchup->losses;
+	record.key_len = matchup->key_len;
+	memcpy(record.key, matchup->key, matchup->key_len);
+	record.checksum = record_checksum(&record);
+
+	return fwrite(&record, sizeof(record), 1, file) == 1;
+}
+
+// ファイルのレコードをテーブルに読み込む（同じキーは後のレコードで上書きする）
+static size_t load(const char *path, match_counter_matchup_table_t *table)
+{
+	FILE *file = os_fopen(path, "rb");
+	if (!file)
+		return 0;
+
+	struct matchup_record record;
+	size_t count = 0;
+
+	while (fread(&record, sizeof(record), 1, file) == 1) {
+		// 書き込み途中で落ちた末尾のレコードは捨てる
+		if (record.magic != MATCHUP_MAGIC || record.checksum != record_checksum(&record) ||
+		    record.key_len >= MATCH_COUNTER_MATCHUP_KEY_SIZE) {
+			blog(LOG_WARNING, "match_counter_matchup: Ignoring invalid record %zu in '%s'", count, path);
+			break;
+		}
+
+		uint32_t hash = match_counter_matchup_hash(record.key, record.key_len);
+		struct match_counter_matchup *matchup =
+			match_counter_matchup_insert(table, record.key, record.key_len, hash);
+		matchup->wins = record.wins < 0 ? 0 : record.wins;
+		matchup->losses = record.losses < 0 ? 0 : record.losses;
+		count++;
+	}
+
+	fclose(file);
+	return count;
+}
+
+// キーごとに1レコードのファイルに書き直す（書き込みスレッドか、書き出しを依頼する前に呼ぶ）
+static bool compact(match_counter_matchup_store_t *store)
+{
+	struct dstr tmp_path = {0};
+	dstr_printf(&tmp_path, "%s.tmp", store->path);
+
+	FILE *file = os_fopen(tmp_path.array, "wb");
+	bool success = file != NULL;
+
+	const match_counter_matchup_table_t *table = &store->table;
+	for (uint32_t i = 0; i < table->capacity && success; i++) {
+		if (table->slots[i].hash)
+			success = write_record(file, &table->slots[i]);
+	}
+
+	if (file) {
+		success = success && fflush(file) == 0;
+		fclose(file);
+	}
+
+	if (success) {
+		if (store->file) {
+			fclose(store->file);
+			store->file = NULL;
+		}
+		success = os_rename(tmp_path.array, store->path) == 0;
+	}
+
+	if (!success) {
+		blog(LOG_WARNING, "match_counter_matchup: Failed to compact '%s'", store->path);
+		os_unlink(tmp_path.array);
+	}
+
+	dstr_free(&tmp_path);
+
+	if (!store->file)
+		store->file = os_fopen(store->path, "ab");
+
+	store->records = 0;
+	return success && store->file;
+}
+
+// 渡された記録をまとめて書き出す（書き込みスレッドから呼ぶ）
+static void store_flush(void *data)
+{
+	match_counter_matchup_store_t *store = data;
+
+	// 書き出し中も追記を止めないよう、配列ごと受け取る
+	pthread_mutex_lock(&store->mutex);
+	struct darray swap = store->writing.da;
+	store->writing.da = store->pending.da;
+	store->pending.da = swap;
+	pthread_mutex_unlock(&store->mutex);
+
+	if (!store->writing.num)
+		return;
+
+	bool success = true;
+	for (size_t i = 0; i < store->writing.num; i++) {
+		const struct match_counter_matchup *matchup = &store->writing.array[i];
+
+		struct match_counter_matchup *copy =
+			match_counter_matchup_insert(&store->table, matchup->key, matchup->key_len, matchup->hash);
+		if (copy) {
+			copy->wins = matchup->wins;
+			copy->losses = matchup->losses;
+		}
+
+		if (!store->file)
+			continue;
+
+		success = write_record(store->file, matchup) && success;
+
+		// 同じキーの古いレコードが溜まったら書き直す
+		if (++store->records >= MATCHUP_COMPACT_THRESHOLD && store->records >= store->table.count)
+			compact(store);
+	}
+
+	if (!store->file || !success || fflush(store->file) != 0)
+		blog(LOG_WARNING, "match_counter_matchup: Failed to append to '%s'", store->path);
+
+	da_resize(store->writing, 0);
+}
+
+static void store_free(match_counter_matchup_store_t *store)
+{
+	if (store->file)
+		fclose(store->file);
+
+	match_counter_matchup_table_free(&store->table);
+	da_free(store->writing);
+	da_free(store->pending);
+	pthread_mutex_destroy(&store->mutex);
+	bfree(store->path);
+	bfree(store);
+}
+
+match_counter_matchup_store_t *match_counter_matchup_store_open(const char *path,
+								 match_counter_matchup_table_t *table)
+{
+	if (!path || !table)
+		return NULL;
+
+	match_counter_matchup_store_t *store = bzalloc(sizeof(match_counter_matchup_store_t));
+	store->path = bstrdup(path);
+	pthread_mutex_init(&store->mutex, NULL);
+	match_counter_writer_job_init(&store->job, store_flush, store);
+
+	size_t count = load(path, table);
+	if (count)
+		blog(LOG_INFO, "match_counter_matchup: Loaded %u matchups from %zu records in '%s'", table->count,
+		     count, path);
+
+	// 以降の書き直しは書き込みスレッドが受け取った記録から行うので、読み込んだテーブルを写しておく
+	for (uint32_t i = 0; i < table->capacity; i++) {
+		const struct match_counter_matchup *matchup = &table->slots[i];
+		if (!matchup->hash)
+			continue;
+
+		struct match_counter_matchup *copy =
+			match_counter_matchup_insert(&store->table, matchup->key, matchup->key_len, matchup->hash);
+		copy->wins = matchup->wins;
+		copy->losses = matchup->losses;
+	}
+
+	// 読み込んだ時点で重複のないファイルにしておく
+	if (count > table->count)
+		compact(store);
+	else
+		store->file = os_fopen(path, "ab");
+
+	if (!store->file) {
+		blog(LOG_WARNING, "match_counter_matchup: Failed to open '%s'", path);
+		store_free(store);
+		return NULL;
+	}
+
+	return store;
+}
+
+void match_counter_matchup_store_close(match_counter_matchup_store_t *store)
+{
+	if (!store)
+		return;
+
+	match_counter_writer_finish(&store->job);
+	store_free(store);
+}
+
+void match_counter_matchup_store_delete(match_counter_matchup_store_t *store)
+{
+	if (!store)
+		return;
+
+	match_counter_writer_finish(&store->job);
+
+	if (store->file) {
+		fclose(store->file);
+		store->file = NULL;
+	}
+	os_unlink(store->path);
+	store_free(store);
+}
+
+void match_counter_matchup_store_append(match_counter_matchup_store_t *store,
+					const struct match_counter_matchup *matchup)
+{
+	if (!store || !matchup)
+		return;
+
+	pthread_mutex_lock(&store->mutex);
+	da_push_back(store->pending, matchup);
+	pthread_mutex_unlock(&store->mutex);
+}
+
+void match_counter_matchup_store_flush(match_counter_matchup_store_t *store)
+{
+	if (!store)
+		return;
+
+	pthread_mutex_lock(&store->mutex);
+	bool wake = store->pending.num > 0;
+	pthread_mutex_unlock(&store->mutex);
+
+	if (wake)
+		match_counter_writer_signal(&store->job);
+}
@@ -0,0 +1,150 @@
+/*
+Match Counter for OBS
+Copyright (C) 2025 Yudai Udagawa
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include <obs-module.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// キーの最大バイト数（終端の'\0'を含む）
+#define MATCH_COUNTER_MATCHUP_KEY_SIZE 32
+
+/**
+ * キー（対戦相手・キャラクターなど）ごとの勝敗の記録
+ *
+ * キーはエントリの中に直接持つため、検索や切り替えでメモリを確保しない
+ */
+struct match_counter_matchup {
+	uint32_t hash; // キーのハッシュ値（0なら空きスロット）
+	int32_t wins;
+	int32_t losses;
+	uint8_t key_len;
+	char key[MATCH_COUNTER_MATCHUP_KEY_SIZE];
+};
+
+/**
+ * キーごとの記録のハッシュテーブル（オープンアドレス法・線形探索）
+ *
+ * 記録は削除しないため、削除済みの印は持たない。更新は1つのスレッドからのみ行う。
+ */
+typedef struct match_counter_matchup_table {
+	struct match_counter_matchup *slots;
+	uint32_t capacity; // スロット数（0または2のべき乗）
+	uint32_t count;    // 使用中のスロット数
+} match_counter_matchup_table_t;
+
+/**
+ * 記録をファイルに追記していくストア
+ *
+ * 記録が変わるたびにそのキーの固定長のレコードを1つ追記し、読み込み時は後のレコードを優先する。
+ * 追記が記録の数より十分多くなったら、キーごとに1レコードのファイルに書き直す。
+ * ファイルへの書き込みと書き直しは、すべてのストアで共有する書き込みスレッドで行う（match-counter-writer.h）。
+ */
+typedef struct match_counter_matchup_store match_counter_matchup_store_t;
+
+/**
+ * テーブルを初期化する（最初に記録を追加するまでメモリを確保しない）
+ * @param table テーブル
+ */
+void match_counter_matchup_table_init(match_counter_matchup_table_t *table);
+
+/**
+ * テーブルを解放する
+ * @param table テーブル
+ */
+void match_counter_matchup_table_free(match_counter_matchup_table_t *table);
+
+/**
+ * キーのハッシュ値を求める
+ * @param key キー
+ * @param len キーのバイト数
+ * @return ハッシュ値（0にはならない）
+ */
+uint32_t match_counter_matchup_hash(const char *key, size_t len);
+
+/**
+ * キーの記録を探す
+ * @param table テーブル
+ * @param key キー
+ * @param len キーのバイト数
+ * @param hash match_counter_matchup_hashで求めたハッシュ値
+ * @return 記録（なければNULL。テーブルに記録を追加すると無効になる）
+ */
+struct match_counter_matchup *match_counter_matchup_find(match_counter_matchup_table_t *table, const char *key,
+							 size_t len, uint32_t hash);
+
+/**
+ * キーの記録を探し、なければ0勝0敗で追加する
+ * @param table テーブル
+ * @param key キー（MATCH_COUNTER_MATCHUP_KEY_SIZE未満のバイト数）
+ * @param len キーのバイト数
+ * @param hash match_counter_matchup_hashで求めたハッシュ値
+ * @return 記録（キーが長すぎる場合はNULL。テーブルに記録を追加すると無効になる）
+ */
+struct match_counter_matchup *match_counter_matchup_insert(match_counter_matchup_table_t *table, const char *key,
+							   size_t len, uint32_t hash);
+
+/**
+ * ストアを開き、ファイルの記録をテーブルに読み込む
+ * @param path ファイルのパス
+ * @param table 読み込み先のテーブル
+ * @return ストア（開けなかった場合はNULL）
+ *
+ * ストアは読み込んだテーブルの写しを持ち、以降はmatch_counter_matchup_store_appendで渡された記録で更新する
+ */
+match_counter_matchup_store_t *match_counter_matchup_store_open(const char *path,
+								 match_counter_matchup_table_t *table);
+
+/**
+ * ストアを閉じる
+ * @param store ストア（NULLなら何もしない）
+ *
+ * 書き込みスレッドに渡した記録をすべて書き出してから閉じる
+ */
+void match_counter_matchup_store_close(match_counter_matchup_store_t *store);
+
+/**
+ * ストアを閉じてファイルを削除する
+ * @param store ストア（NULLなら何もしない）
+ */
+void match_counter_matchup_store_delete(match_counter_matchup_store_t *store);
+
+/**
+ * 変わった記録を追記する
+ * @param store ストア（NULLなら何もしない）
+ * @param matchup 変わった後の記録
+ *
+ * テーブルを更新するスレッドから呼ぶ。記録を書き込みスレッドに渡すのはmatch_counter_matchup_store_flushの時
+ */
+void match_counter_matchup_store_append(match_counter_matchup_store_t *store,
+					const struct match_counter_matchup *matchup);
+
+/**
+ * 追記した記録の書き出しを書き込みスレッドに頼む
+ * @param store ストア（NULLなら何もしない）
+ *
+ * ファイルの書き込みを待たずに戻る
+ */
+void match_counter_matchup_store_flush(match_counter_matchup_store_t *store);
+
+#ifdef __cplusplus
+}
+#endif
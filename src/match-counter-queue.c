@@ -0,0 +1,147 @@
+/*
+Match Counter for OBS
+Copyright (C) 2025 Yudai Udagawa
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include "match-counter-queue.h"
+#include "match-counter-atomic.h"
+
+struct queue_cell {
+	// push待ちならセルの位置、pop待ちなら位置+1
+	volatile uint64_t seq;
+	struct match_counter_command command;
+};
+
+struct match_counter_queue {
+	volatile uint64_t push_pos; // 積む側が奪い合う位置
+	uint64_t pop_pos;           // 取り出す側だけが触る位置
+	struct queue_cell cells[MATCH_COUNTER_QUEUE_CAPACITY];
+};
+
+match_counter_queue_t *match_counter_queue_create(void)
+{
+	match_counter_queue_t *queue = bzalloc(sizeof(match_counter_queue_t));
+
+	for (uint64_t i = 0; i < MATCH_COUNTER_QUEUE_CAPACITY; i++)
+		queue->cells[i].seq = i;
+
+	return queue;
+}
+
+void match_counter_queue_destroy(match_counter_queue_t *queue)
+{
+	bfree(queue);
+}
+
+// 連続したcount個のセルが空いているかを調べる。空いていればtrue、一杯ならfalse、
+// 他のスレッドが先に積んでいた場合は*posを最新の位置にして調べ直す
+static inline int queue_check_room(match_counter_queue_t *queue, uint64_t *pos, size_t count)
+{
+	// 取り出しは位置の順に進むので、最後のセルが空いていればその前のセルもすべて空いている
+	uint64_t last = *pos + count - 1;
+	struct queue_cell *cell = &queue->cells[last & (MATCH_COUNTER_QUEUE_CAPACITY - 1)];
+	int64_t diff = (int64_t)(match_counter_atomic_load_u64(&cell->seq) - last);
+
+	if (diff < 0)
+		return 0;
+	if (diff > 0) {
+		*pos = match_counter_atomic_load_u64(&queue->push_pos);
+		return -1;
+	}
+	return 1;
+}
+
+bool match_counter_queue_push(match_counter_queue_t *queue, const struct match_counter_command *command)
+{
+	return match_counter_queue_push_many(queue, command, 1);
+}
+
+bool match_counter_queue_push_many(match_counter_queue_t *queue, const struct match_counter_command *commands,
+				   size_t count)
+{
+	uint64_t pos;
+	if (!commands || !match_counter_queue_reserve(queue, count, &pos))
+		return false;
+
+	match_counter_queue_commit(queue, pos, commands, count);
+	return true;
+}
+
+bool match_counter_queue_reserve(match_counter_queue_t *queue, size_t count, uint64_t *pos)
+{
+	if (!queue || !count || count > MATCH_COUNTER_QUEUE_CAPACITY)
+		return false;
+
+	*pos = match_counter_atomic_load_u64(&queue->push_pos);
+
+	for (;;) {
+		int room = queue_check_room(queue, pos, count);
+		if (room == 0)
+			return false;
+
+		// count個のセルをまとめて確保する。失敗した場合はposに最新の位置が入る
+		if (room > 0 && match_counter_atomic_compare_exchange_u64(&queue->push_pos, pos, *pos + count))
+			return true;
+	}
+}
+
+void match_counter_queue_commit(match_counter_queue_t *queue, uint64_t pos,
+				const struct match_counter_command *commands, size_t count)
+{
+	// commandsがなければ、取り出す側が読み飛ばすSNAPSHOTで埋めて確保を取り消す
+	for (size_t i = 0; i < count; i++) {
+		struct queue_cell *cell = &queue->cells[(pos + i) & (MATCH_COUNTER_QUEUE_CAPACITY - 1)];
+		struct match_counter_command *command = &cell->command;
+		if (commands) {
+			*command = commands[i];
+		} else {
+			memset(command, 0, sizeof(*command));
+			command->event = MATCH_COUNTER_JOURNAL_SNAPSHOT;
+		}
+	}
+
+	// 後ろのセルから渡し、先頭のセルを最後にすることで、取り出す側には全部がそろってから見える
+	for (size_t i = count; i > 0; i--) {
+		struct queue_cell *cell = &queue->cells[(pos + i - 1) & (MATCH_COUNTER_QUEUE_CAPACITY - 1)];
+		match_counter_atomic_store_u64(&cell->seq, pos + i);
+	}
+}
+
+bool match_counter_queue_empty(match_counter_queue_t *queue)
+{
+	if (!queue)
+		return true;
+
+	struct queue_cell *cell = &queue->cells[queue->pop_pos & (MATCH_COUNTER_QUEUE_CAPACITY - 1)];
+	return match_counter_atomic_load_u64(&cell->seq) != queue->pop_pos + 1;
+}
+
+bool match_counter_queue_pop(match_counter_queue_t *queue, struct match_counter_command *command)
+{
+	if (!queue)
+		return false;
+
+	struct queue_cell *cell = &queue->cells[queue->pop_pos & (MATCH_COUNTER_QUEUE_CAPACITY - 1)];
+	if (match_counter_atomic_load_u64(&cell->seq) != queue->pop_pos + 1)
+		return false;
+
+	*command = cell->command;
+
+	// 次の周で積めるようにセルを空ける
+	match_counter_atomic_store_u64(&cell->seq, queue->pop_pos + MATCH_COUNTER_QUEUE_CAPACITY);
+	queue->pop_pos++;
+	return true;
+}
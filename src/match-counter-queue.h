@@ -0,0 +1,121 @@
+/*
+Match Counter for OBS
+Copyright (C) 2025 Yudai Udagawa
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include "match-counter-journal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// コマンドキューの容量（2のべき乗）
+#define MATCH_COUNTER_QUEUE_CAPACITY 256
+
+/**
+ * カウンターへの操作コマンド
+ */
+struct match_counter_command {
+	enum match_counter_journal_event event; // WIN, LOSS, UNDO_WIN, UNDO_LOSS, RESET, SET
+	int wins;                               // SETの場合の勝利数
+	int losses;                             // SETの場合の敗北数
+	int64_t timestamp_ms;                   // 積んだ時刻（UNIX時間のミリ秒）
+};
+
+/**
+ * 複数のスレッドから積み、1つのスレッドだけが取り出す固定長のコマンドキュー
+ *
+ * 積む側も取り出す側もロックを取らない。各セルの通し番号で、書き込みが終わったセルだけを取り出す。
+ */
+typedef struct match_counter_queue match_counter_queue_t;
+
+/**
+ * コマンドキューを作成する
+ * @return コマンドキュー
+ */
+match_counter_queue_t *match_counter_queue_create(void);
+
+/**
+ * コマンドキューを破棄する
+ * @param queue コマンドキュー
+ */
+void match_counter_queue_destroy(match_counter_queue_t *queue);
+
+/**
+ * コマンドを積む（任意のスレッドから呼べる）
+ * @param queue コマンドキュー
+ * @param command コマンド
+ * @return 積めた場合はtrue。キューが一杯の場合はfalse
+ */
+bool match_counter_queue_push(match_counter_queue_t *queue, const struct match_counter_command *command);
+
+/**
+ * 複数のコマンドをまとめて積む（任意のスレッドから呼べる）
+ * @param queue コマンドキュー
+ * @param commands コマンドの配列
+ * @param count コマンドの数（1～MATCH_COUNTER_QUEUE_CAPACITY）
+ * @return すべて積めた場合はtrue。空きが足りない場合は1つも積まずにfalse
+ *
+ * 取り出す側には、すべてのコマンドが書き込まれてから先頭のコマンドが見えるようになる
+ */
+bool match_counter_queue_push_many(match_counter_queue_t *queue, const struct match_counter_command *commands,
+				   size_t count);
+
+/**
+ * 複数のコマンドを積むセルを、書き込まずに確保する（任意のスレッドから呼べる）
+ * @param queue コマンドキュー
+ * @param count コマンドの数（1～MATCH_COUNTER_QUEUE_CAPACITY）
+ * @param pos 確保した先頭の位置の格納先
+ * @return 確保できた場合はtrue。空きが足りない場合は何も確保せずにfalse
+ *
+ * 確保したセルは必ずmatch_counter_queue_commitで渡す。渡すまでは、その位置から後ろは取り出せない
+ */
+bool match_counter_queue_reserve(match_counter_queue_t *queue, size_t count, uint64_t *pos);
+
+/**
+ * 確保したセルにコマンドを書き込んで取り出す側に渡す
+ * @param queue コマンドキュー
+ * @param pos match_counter_queue_reserveで確保した先頭の位置
+ * @param commands コマンドの配列（NULLなら、確保を取り消すために何もしないSNAPSHOTを渡す）
+ * @param count 確保したときのコマンドの数
+ *
+ * 取り出す側には、すべてのコマンドが書き込まれてから先頭のコマンドが見えるようになる
+ */
+void match_counter_queue_commit(match_counter_queue_t *queue, uint64_t pos,
+				const struct match_counter_command *commands, size_t count);
+
+/**
+ * 取り出せるコマンドがあるかを調べる（取り出すスレッドから呼ぶ）
+ * @param queue コマンドキュー
+ * @return 取り出せるコマンドがなければtrue
+ *
+ * ロックも書き込みもしないため、毎フレーム呼んでもほとんど負荷がない
+ */
+bool match_counter_queue_empty(match_counter_queue_t *queue);
+
+/**
+ * コマンドを1つ取り出す（取り出すスレッドは常に1つでなければならない）
+ * @param queue コマンドキュー
+ * @param command 取り出したコマンドの格納先
+ * @return 取り出せた場合はtrue。空の場合はfalse
+ */
+bool match_counter_queue_pop(match_counter_queue_t *queue, struct match_counter_command *command);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,627 @@
+/*
+Match Counter for OBS
+Copyright (C) 2025 Yudai Udagawa
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include "match-counter-registry.h"
+#include "match-counter-queue.h"
+#include <util/darray.h>
+#include <util/dstr.h>
+#include <util/threading.h>
+
+// ハッシュテーブルの初期バケット数（2のべき乗）
+#define REGISTRY_INITIAL_BUCKETS 64
+
+struct shared_subscriber {
+	match_counter_shared_callback_t callback;
+	void *data;
+};
+
+struct shared_listener {
+	match_counter_shared_event_callback_t callback;
+	void *data;
+};
+
+struct registry_watcher {
+	match_counter_shared_callback_t callback;
+	void *data;
+};
+
+struct match_counter_shared {
+	char *id;
+	uint32_t hash;
+	bool registered;     // レジストリのハッシュテーブルに登録されているか
+	size_t refs;         // registry_mutexで保護する
+	bool delete_journal; // 最後の参照を手放したときにジャーナルも削除する（registry_mutexで保護する）
+
+	match_counter_t *counter;
+	match_counter_journal_t *journal;
+	match_counter_matchup_store_t *matchups; // キーごとの勝敗の記録
+
+	// 各スレッドから積まれ、描画スレッドのmatch_counter_registry_drain_allでまとめて適用される操作
+	match_counter_queue_t *commands;
+	int applied; // 直前のdrainで値が変わった操作の数（描画スレッドだけが触る）
+
+	// 適用・追記と操作ごとのコールバックの変更を直列化する
+	pthread_mutex_t mutex;
+	DARRAY(struct shared_listener) listeners;
+	volatile bool changed; // 選択中のキーか集計する試合数が変わり、次のdrainで購読者に通知する
+
+	// 購読者への通知と購読者の変更を直列化する（mutexを放してから通知するため別のロックにする）
+	pthread_mutex_t notify_mutex;
+	DARRAY(struct shared_subscriber) subscribers;
+
+	struct match_counter_shared *next; // 同じバケット内の次のエントリ
+};
+
+// IDからエントリへのハッシュテーブル（チェイン法）
+static pthread_mutex_t registry_mutex;
+static match_counter_shared_t **registry_buckets;
+static size_t registry_bucket_count;
+static size_t registry_count;
+static DARRAY(match_counter_shared_t *) registry_entries; // 専用のものも含むすべてのエントリ
+static DARRAY(match_counter_shared_t *) registry_draining; // drain_allで適用するエントリ（描画スレッドだけが触る）
+
+// IDのある共有カウンターに最初の購読者が付いたとき・最後の購読者が外れたときに呼ぶコールバック
+static pthread_mutex_t registry_watch_mutex;
+static DARRAY(struct registry_watcher) registry_watchers;
+
+static uint32_t registry_hash(const char *id)
+{
+	uint32_t hash = 2166136261u;
+
+	for (const unsigned char *p = (const unsigned char *)id; *p; p++) {
+		hash ^= *p;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+static match_counter_shared_t **registry_bucket(uint32_t hash)
+{
+	return &registry_buckets[hash & (registry_bucket_count - 1)];
+}
+
+// エントリ数がバケット数の3/4を超えたらバケット数を倍にする
+static void registry_grow(void)
+{
+	size_t old_count = registry_bucket_count;
+	match_counter_shared_t **old_buckets = registry_buckets;
+
+	registry_bucket_count = old_count * 2;
+	registry_buckets = bzalloc(sizeof(match_counter_shared_t *) * registry_bucket_count);
+
+	for (size_t i = 0; i < old_count; i++) {
+		match_counter_shared_t *shared = old_buckets[i];
+		while (shared) {
+			match_counter_shared_t *next = shared->next;
+			match_counter_shared_t **bucket = registry_bucket(shared->hash);
+			shared->next = *bucket;
+			*bucket = shared;
+			shared = next;
+		}
+	}
+
+	bfree(old_buckets);
+}
+
+static match_counter_shared_t *registry_find(const char *id, uint32_t hash)
+{
+	for (match_counter_shared_t *shared = *registry_bucket(hash); shared; shared = shared->next) {
+		if (shared->hash == hash && strcmp(shared->id, id) == 0)
+			return shared;
+	}
+	return NULL;
+}
+
+static void registry_insert(match_counter_shared_t *shared)
+{
+	if ((registry_count + 1) * 4 > registry_bucket_count * 3)
+		registry_grow();
+
+	match_counter_shared_t **bucket = registry_bucket(shared->hash);
+	shared->next = *bucket;
+	*bucket = shared;
+	shared->registered = true;
+	registry_count++;
+}
+
+static void registry_remove(match_counter_shared_t *shared)
+{
+	for (match_counter_shared_t **link = registry_bucket(shared->hash); *link; link = &(*link)->next) {
+		if (*link == shared) {
+			*link = shared->next;
+			registry_count--;
+			return;
+		}
+	}
+}
+
+void match_counter_registry_init(void)
+{
+	pthread_mutex_init(&registry_mutex, NULL);
+	pthread_mutex_init(&registry_watch_mutex, NULL);
+	da_init(registry_watchers);
+	registry_bucket_count = REGISTRY_INITIAL_BUCKETS;
+	registry_buckets = bzalloc(sizeof(match_counter_shared_t *) * registry_bucket_count);
+	registry_count = 0;
+	da_init(registry_entries);
+	da_init(registry_draining);
+}
+
+void match_counter_registry_free(void)
+{
+	// ソースはモジュールの解放前にすべて破棄されているはず
+	if (registry_count)
+		blog(LOG_WARNING, "match_counter_registry: %zu shared counters still referenced", registry_count);
+
+	bfree(registry_buckets);
+	registry_buckets = NULL;
+	registry_bucket_count = 0;
+	registry_count = 0;
+	da_free(registry_entries);
+	da_free(registry_draining);
+	pthread_mutex_destroy(&registry_mutex);
+
+	da_free(registry_watchers);
+	pthread_mutex_destroy(&registry_watch_mutex);
+}
+
+static match_counter_shared_t *shared_create(const char *id, uint32_t hash, const char *journal_path, int wins,
+					     int losses)
+{
+	match_counter_shared_t *shared = bzalloc(sizeof(match_counter_shared_t));
+	shared->id = bstrdup(id);
+	shared->hash = hash;
+	shared->counter = match_counter_create();
+	shared->commands = match_counter_queue_create();
+	pthread_mutex_init(&shared->mutex, NULL);
+	pthread_mutex_init(&shared->notify_mutex, NULL);
+	da_init(shared->subscribers);
+	da_init(shared->listeners);
+
+	match_counter_set_wins(shared->counter, wins);
+	match_counter_set_losses(shared->counter, losses);
+
+	if (journal_path) {
+		shared->journal = match_counter_journal_open(journal_path, shared->counter);
+
+		// キーごとの記録はジャーナルと同じ場所の別のファイルに置く
+		struct dstr matchup_path = {0};
+		dstr_printf(&matchup_path, "%s.matchups", journal_path);
+		shared->matchups = match_counter_matchup_store_open(matchup_path.array, &shared->counter->matchups);
+		dstr_free(&matchup_path);
+	}
+
+	return shared;
+}
+
+static void shared_destroy(match_counter_shared_t *shared, bool delete_journal)
+{
+	// 最後の参照なので、まだ適用されていない操作はここで反映してジャーナルに残す
+	match_counter_shared_drain(shared);
+	match_counter_queue_destroy(shared->commands);
+
+	if (delete_journal) {
+		match_counter_journal_delete(shared->journal);
+		match_counter_matchup_store_delete(shared->matchups);
+	} else {
+		match_counter_journal_close(shared->journal);
+		match_counter_matchup_store_close(shared->matchups);
+	}
+
+	match_counter_destroy(shared->counter);
+	pthread_mutex_destroy(&shared->mutex);
+	pthread_mutex_destroy(&shared->notify_mutex);
+	da_free(shared->subscribers);
+	da_free(shared->listeners);
+	bfree(shared->id);
+	bfree(shared);
+}
+
+match_counter_shared_t *match_counter_registry_acquire(const char *id, const char *journal_path, int wins,
+							int losses, bool *created_out)
+{
+	if (!id)
+		id = "";
+
+	// 専用のエントリは他のソースから見つからないよう登録せず、毎フレームの適用の対象にだけ加える
+	if (!*id) {
+		match_counter_shared_t *shared = shared_create(id, 0, journal_path, wins, losses);
+		shared->refs = 1;
+
+		pthread_mutex_lock(&registry_mutex);
+		da_push_back(registry_entries, &shared);
+		pthread_mutex_unlock(&registry_mutex);
+
+		if (created_out)
+			*created_out = true;
+		return shared;
+	}
+
+	uint32_t hash = registry_hash(id);
+
+	pthread_mutex_lock(&registry_mutex);
+
+	match_counter_shared_t *shared = registry_find(id, hash);
+	bool created = !shared;
+	if (created) {
+		shared = shared_create(id, hash, journal_path, wins, losses);
+		registry_insert(shared);
+		da_push_back(registry_entries, &shared);
+	}
+	shared->refs++;
+
+	pthread_mutex_unlock(&registry_mutex);
+
+	if (created_out)
+		*created_out = created;
+
+	return shared;
+}
+
+void match_counter_registry_watch(match_counter_shared_callback_t callback, void *data)
+{
+	struct registry_watcher watcher = {callback, data};
+
+	pthread_mutex_lock(&registry_watch_mutex);
+	da_push_back(registry_watchers, &watcher);
+	pthread_mutex_unlock(&registry_watch_mutex);
+}
+
+void match_counter_registry_unwatch(match_counter_shared_callback_t callback, void *data)
+{
+	pthread_mutex_lock(&registry_watch_mutex);
+
+	for (size_t i = 0; i < registry_watchers.num; i++) {
+		struct registry_watcher *watcher = &registry_watchers.array[i];
+		if (watcher->callback == callback && watcher->data == data) {
+			da_erase(registry_watchers, i);
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&registry_watch_mutex);
+}
+
+match_counter_shared_t *match_counter_registry_find(const char *id)
+{
+	if (!id || !*id)
+		return NULL;
+
+	uint32_t hash = registry_hash(id);
+
+	pthread_mutex_lock(&registry_mutex);
+
+	match_counter_shared_t *shared = registry_find(id, hash);
+	if (shared)
+		shared->refs++;
+
+	pthread_mutex_unlock(&registry_mutex);
+	return shared;
+}
+
+void match_counter_registry_release(match_counter_shared_t *shared, bool delete_journal)
+{
+	if (!shared)
+		return;
+
+	pthread_mutex_lock(&registry_mutex);
+
+	// 共有カウンターのジャーナルは、同じIDを再び使うときのために残す。
+	// 専用のエントリは、drain_allが参照を持っている間に手放されても最後に削除する
+	if (delete_journal && !shared->registered)
+		shared->delete_journal = true;
+
+	bool last = --shared->refs == 0;
+	if (last) {
+		if (shared->registered)
+			registry_remove(shared);
+		da_erase_item(registry_entries, &shared);
+	}
+
+	pthread_mutex_unlock(&registry_mutex);
+
+	if (last)
+		shared_destroy(shared, shared->delete_journal);
+}
+
+const char *match_counter_shared_get_id(match_counter_shared_t *shared)
+{
+	return shared ? shared->id : "";
+}
+
+match_counter_t *match_counter_shared_get_counter(match_counter_shared_t *shared)
+{
+	return shared ? shared->counter : NULL;
+}
+
+// 購読者の有無が変わったことを知らせる（呼び出し元が参照を持っている間に、どのロックも持たずに呼ぶ）
+// コールバックが並んで呼ばれても順序は保証しないため、受け取る側はmatch_counter_shared_has_subscribersで現在の状態を見る
+static void registry_notify_watchers(match_counter_shared_t *shared)
+{
+	if (!shared->registered)
+		return;
+
+	pthread_mutex_lock(&registry_watch_mutex);
+	for (size_t i = 0; i < registry_watchers.num; i++)
+		registry_watchers.array[i].callback(registry_watchers.array[i].data, shared);
+	pthread_mutex_unlock(&registry_watch_mutex);
+}
+
+void match_counter_shared_subscribe(match_counter_shared_t *shared, match_counter_shared_callback_t callback,
+				    void *data)
+{
+	if (!shared || !callback)
+		return;
+
+	struct shared_subscriber subscriber = {callback, data};
+
+	pthread_mutex_lock(&shared->notify_mutex);
+	da_push_back(shared->subscribers, &subscriber);
+	bool first = shared->subscribers.num == 1;
+	pthread_mutex_unlock(&shared->notify_mutex);
+
+	if (first)
+		registry_notify_watchers(shared);
+}
+
+
+void match_counter_shared_unsubscribe(match_counter_shared_t *shared, match_counter_shared_callback_t callback,
+				      void *data)
+{
+	if (!shared)
+		return;
+
+	pthread_mutex_lock(&shared->notify_mutex);
+
+	bool last = false;
+	for (size_t i = 0; i < shared->subscribers.num; i++) {
+		struct shared_subscriber *subscriber = &shared->subscribers.array[i];
+		if (subscriber->callback == callback && subscriber->data == data) {
+			da_erase(shared->subscribers, i);
+			last = shared->subscribers.num == 0;
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&shared->notify_mutex);
+
+	if (last)
+		registry_notify_watchers(shared);
+}
+
+bool match_counter_shared_has_subscribers(match_counter_shared_t *shared)
+{
+	if (!shared)
+		return false;
+
+	pthread_mutex_lock(&shared->notify_mutex);
+	bool subscribed = shared->subscribers.num > 0;
+	pthread_mutex_unlock(&shared->notify_mutex);
+	return subscribed;
+}
+
+static bool shared_mutate(match_counter_t *counter, enum match_counter_journal_event event, int wins, int losses)
+{
+	switch (event) {
+	case MATCH_COUNTER_JOURNAL_WIN:
+		return match_counter_add_win(counter);
+	case MATCH_COUNTER_JOURNAL_LOSS:
+		return match_counter_add_loss(counter);
+	case MATCH_COUNTER_JOURNAL_UNDO_WIN:
+		return match_counter_subtract_win(counter);
+	case MATCH_COUNTER_JOURNAL_UNDO_LOSS:
+		return match_counter_subtract_loss(counter);
+	case MATCH_COUNTER_JOURNAL_RESET:
+		return match_counter_reset(counter);
+	case MATCH_COUNTER_JOURNAL_SET: {
+		bool changed = match_counter_set_wins(counter, wins);
+		changed |= match_counter_set_losses(counter, losses);
+		return changed;
+	}
+	case MATCH_COUNTER_JOURNAL_SNAPSHOT:
+		break;
+	}
+	return false;
+}
+
+void match_counter_shared_listen(match_counter_shared_t *shared, match_counter_shared_event_callback_t callback,
+				 void *data)
+{
+	if (!shared || !callback)
+		return;
+
+	struct shared_listener listener = {callback, data};
+
+	pthread_mutex_lock(&shared->mutex);
+	da_push_back(shared->listeners, &listener);
+	pthread_mutex_unlock(&shared->mutex);
+}
+
+void match_counter_shared_listen_current(match_counter_shared_t *shared,
+					 match_counter_shared_event_callback_t callback, void *data)
+{
+	if (!shared || !callback)
+		return;
+
+	struct shared_listener listener = {callback, data};
+
+	// 以降の操作と同じロックの中で現在の値を渡すため、値の取りこぼしや前後の入れ替わりが起きない
+	pthread_mutex_lock(&shared->mutex);
+	da_push_back(shared->listeners, &listener);
+	callback(data, MATCH_COUNTER_JOURNAL_SNAPSHOT, match_counter_history_now_ms(),
+		 match_counter_get_wins(shared->counter), match_counter_get_losses(shared->counter));
+	pthread_mutex_unlock(&shared->mutex);
+}
+
+void match_counter_shared_unlisten(match_counter_shared_t *shared, match_counter_shared_event_callback_t callback,
+				   void *data)
+{
+	if (!shared)
+		return;
+
+	pthread_mutex_lock(&shared->mutex);
+
+	for (size_t i = 0; i < shared->listeners.num; i++) {
+		struct shared_listener *listener = &shared->listeners.array[i];
+		if (listener->callback == callback && listener->data == data) {
+			da_erase(shared->listeners, i);
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&shared->mutex);
+}
+
+bool match_counter_shared_post(match_counter_shared_t *shared, enum match_counter_journal_event event, int wins,
+			       int losses)
+{
+	if (!shared)
+		return false;
+
+	struct match_counter_command command = {event, wins, losses, match_counter_history_now_ms()};
+	return match_counter_queue_push(shared->commands, &command);
+}
+
+bool match_counter_shared_reserve(match_counter_shared_t *shared, size_t count, uint64_t *pos)
+{
+	return shared && match_counter_queue_reserve(shared->commands, count, pos);
+}
+
+void match_counter_shared_commit(match_counter_shared_t *shared, uint64_t pos,
+				 const struct match_counter_command *commands, size_t count)
+{
+	match_counter_queue_commit(shared->commands, pos, commands, count);
+}
+
+// 適用する操作か、通知するキーの変更があるか（ロックを取らずに調べる）
+static bool shared_has_work(match_counter_shared_t *shared)
+{
+	return !match_counter_queue_empty(shared->commands) || os_atomic_load_bool(&shared->changed);
+}
+
+int match_counter_shared_drain(match_counter_shared_t *shared)
+{
+	if (!shared)
+		return 0;
+
+	shared->applied = 0;
+	if (!shared_has_work(shared))
+		return 0;
+
+	pthread_mutex_lock(&shared->mutex);
+	match_counter_journal_begin_batch(shared->journal);
+
+	// 1回に適用する数はキューの容量までにして、1フレームの処理量を抑える
+	struct match_counter_command command;
+	int applied = 0;
+	for (int i = 0; i < MATCH_COUNTER_QUEUE_CAPACITY && match_counter_queue_pop(shared->commands, &command); i++) {
+		if (!shared_mutate(shared->counter, command.event, command.wins, command.losses))
+			continue;
+
+		match_counter_journal_append(shared->journal, command.event, shared->counter);
+		applied++;
+
+		// 選択中のキーの記録も勝敗と一緒に変わる
+		if (command.event != MATCH_COUNTER_JOURNAL_RESET && command.event != MATCH_COUNTER_JOURNAL_SET)
+			match_counter_matchup_store_append(shared->matchups,
+							   match_counter_get_current_matchup(shared->counter));
+
+		int wins = match_counter_get_wins(shared->counter);
+		int losses = match_counter_get_losses(shared->counter);
+		for (size_t j = 0; j < shared->listeners.num; j++) {
+			struct shared_listener *listener = &shared->listeners.array[j];
+			listener->callback(listener->data, command.event, command.timestamp_ms, wins, losses);
+		}
+	}
+
+	match_counter_journal_end_batch(shared->journal);
+	match_counter_matchup_store_flush(shared->matchups);
+
+	bool changed = os_atomic_set_bool(&shared->changed, false);
+	shared->applied = applied;
+	pthread_mutex_unlock(&shared->mutex);
+
+	// 購読者はmatch_counter_shared_set_matchupなどを呼べるよう、ロックを放してから呼ぶ。
+	// 何回操作されても通知は1回だけ
+	if (applied || changed) {
+		pthread_mutex_lock(&shared->notify_mutex);
+		for (size_t i = 0; i < shared->subscribers.num; i++) {
+			struct shared_subscriber *subscriber = &shared->subscribers.array[i];
+			subscriber->callback(subscriber->data, shared);
+		}
+		pthread_mutex_unlock(&shared->notify_mutex);
+	}
+
+	return applied;
+}
+
+bool match_counter_shared_set_matchup(match_counter_shared_t *shared, const char *key)
+{
+	if (!shared)
+		return false;
+
+	pthread_mutex_lock(&shared->mutex);
+
+	// 呼び出し元がロックを持っていても購読者が呼ばれないよう、通知は次のdrainで行う
+	bool changed = match_counter_set_matchup(shared->counter, key);
+	if (changed)
+		os_atomic_set_bool(&shared->changed, true);
+
+	pthread_mutex_unlock(&shared->mutex);
+	return changed;
+}
+
+bool match_counter_shared_set_history_window(match_counter_shared_t *shared, uint32_t window)
+{
+	if (!shared)
+		return false;
+
+	pthread_mutex_lock(&shared->mutex);
+
+	bool changed = match_counter_set_history_window(shared->counter, window);
+	if (changed)
+		os_atomic_set_bool(&shared->changed, true);
+
+	pthread_mutex_unlock(&shared->mutex);
+	return changed;
+}
+
+int match_counter_shared_get_applied(match_counter_shared_t *shared)
+{
+	return shared ? shared->applied : 0;
+}
+
+void match_counter_registry_drain_all(void)
+{
+	// ロックの間は適用するものがあるエントリの参照を取るだけにし、適用と通知はロックを放してから行う
+	pthread_mutex_lock(&registry_mutex);
+	for (size_t i = 0; i < registry_entries.num; i++) {
+		match_counter_shared_t *shared = registry_entries.array[i];
+		if (shared_has_work(shared)) {
+			shared->refs++;
+			da_push_back(registry_draining, &shared);
+		}
+	}
+	pthread_mutex_unlock(&registry_mutex);
+
+	for (size_t i = 0; i < registry_draining.num; i++) {
+		match_counter_shared_drain(registry_draining.array[i]);
+		match_counter_registry_release(registry_draining.array[i], false);
+	}
+	da_resize(registry_draining, 0);
+}
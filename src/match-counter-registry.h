@@ -0,0 +1,287 @@
+/*
+Match Counter for OBS
+Copyright (C) 2025 Yudai Udagawa
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include "match-counter.h"
+#include "match-counter-journal.h"
+#include "match-counter-queue.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * 複数のソースから共有される試合カウンター
+ *
+ * 同じカウンターIDを設定したソースは1つの勝敗数・履歴・ジャーナルを共有する。
+ * IDが空のソースは自分専用のエントリを持ち、レジストリには登録されない。
+ */
+typedef struct match_counter_shared match_counter_shared_t;
+
+/**
+ * 共有カウンターが変化したときに呼ばれるコールバック
+ * @param data 購読時に渡したポインタ
+ * @param shared 変化した共有カウンター
+ *
+ * match_counter_registry_drain_allを呼んだ描画スレッドから、エントリのロックを放した後に呼ばれる。
+ * コールバックの中で操作を積んだりmatch_counter_shared_set_matchupを呼んだりしてもよいが、
+ * 購読の登録・解除はしてはいけない
+ */
+typedef void (*match_counter_shared_callback_t)(void *data, match_counter_shared_t *shared);
+
+/**
+ * 共有カウンターに操作が1つ適用されるたびに呼ばれるコールバック
+ * @param data 登録時に渡したポインタ
+ * @param event 適用された操作
+ * @param timestamp_ms 操作が積まれた時刻（UNIX時間のミリ秒）
+ * @param wins 適用後の勝利数
+ * @param losses 適用後の敗北数
+ *
+ * 描画スレッドから、エントリのロックを保持したまま呼ばれるため、ブロックしてはいけない
+ */
+typedef void (*match_counter_shared_event_callback_t)(void *data, enum match_counter_journal_event event,
+						      int64_t timestamp_ms, int wins, int losses);
+
+/**
+ * レジストリを初期化する（モジュールの読み込み時に1回だけ呼ぶ）
+ */
+void match_counter_registry_init(void);
+
+/**
+ * レジストリを解放する（モジュールの解放時に1回だけ呼ぶ）
+ */
+void match_counter_registry_free(void);
+
+/**
+ * 共有カウンターを取得する。なければ作成する
+ * @param id カウンターID（NULLまたは空文字列なら専用のエントリを作成する）
+ * @param journal_path 作成時に開くジャーナルのパス（NULLならジャーナルを使わない）
+ * @param wins 作成時の勝利数
+ * @param losses 作成時の敗北数
+ * @param created この呼び出しで作成したかどうかの格納先（NULLなら格納しない）
+ * @return 参照カウントを1つ増やした共有カウンター
+ *
+ * 作成時はwins/lossesを設定した後にジャーナルを再生するため、ジャーナルの方が新しければそちらが優先される。
+ * 集計する試合数や選択中のキーのようなカウンターごとの設定は、作成した呼び出し元だけが与えるようにする
+ */
+match_counter_shared_t *match_counter_registry_acquire(const char *id, const char *journal_path, int wins,
+							int losses, bool *created);
+
+/**
+ * 登録済みの共有カウンターを探す（なければ作成しない）
+ * @param id カウンターID
+ * @return 参照カウントを1つ増やした共有カウンター（見つからなければNULL）
+ */
+match_counter_shared_t *match_counter_registry_find(const char *id);
+
+/**
+ * IDのある共有カウンターに最初の購読者が付いたとき・最後の購読者が外れたときに呼ばれるコールバックを登録する
+ * @param callback 購読者の有無が変わった共有カウンターを受け取るコールバック
+ * @param data コールバックに渡すポインタ
+ *
+ * コールバックは購読・解除したスレッドから、レジストリとエントリのロックを放した後に呼ばれる。
+ * 別々のスレッドで続けて変わった場合は順序が入れ替わることがあるため、コールバックでは
+ * match_counter_shared_has_subscribersで現在の状態を調べる。
+ * 共有カウンターはコールバックの間だけ有効なため、使い続ける場合はmatch_counter_registry_findで参照を取る。
+ * 購読者がいなくなったカウンターの参照を持ち続けると、表示するソースがなくなってもエントリが残り続ける
+ */
+void match_counter_registry_watch(match_counter_shared_callback_t callback, void *data);
+
+/**
+ * 登録したコールバックを解除する
+ * @param callback 登録時に渡したコールバック
+ * @param data 登録時に渡したポインタ
+ *
+ * 戻った時点で、このコールバックが実行中でないことが保証される
+ */
+void match_counter_registry_unwatch(match_counter_shared_callback_t callback, void *data);
+
+/**
+ * 共有カウンターの参照を手放す
+ * @param shared 共有カウンター
+ * @param delete_journal 専用のエントリの場合にジャーナルファイルも削除するか
+ *
+ * 共有カウンターは最後の参照を手放すと破棄されるが、ジャーナルファイルは常に残す
+ */
+void match_counter_registry_release(match_counter_shared_t *shared, bool delete_journal);
+
+/**
+ * 共有カウンターのIDを取得する
+ * @param shared 共有カウンター
+ * @return カウンターID（専用のエントリでは空文字列）
+ */
+const char *match_counter_shared_get_id(match_counter_shared_t *shared);
+
+/**
+ * 共有カウンターの試合カウンターを取得する
+ * @param shared 共有カウンター
+ * @return 試合カウンター（sharedを手放すまで有効）
+ */
+match_counter_t *match_counter_shared_get_counter(match_counter_shared_t *shared);
+
+/**
+ * 変化の通知を購読する
+ * @param shared 共有カウンター
+ * @param callback 変化したときに呼ばれるコールバック
+ * @param data コールバックに渡すポインタ
+ */
+void match_counter_shared_subscribe(match_counter_shared_t *shared, match_counter_shared_callback_t callback,
+				    void *data);
+
+/**
+ * 購読を解除する
+ * @param shared 共有カウンター
+ * @param callback 購読時に渡したコールバック
+ * @param data 購読時に渡したポインタ
+ *
+ * 戻った時点で、このコールバックが実行中でないことが保証される
+ */
+void match_counter_shared_unsubscribe(match_counter_shared_t *shared, match_counter_shared_callback_t callback,
+				      void *data);
+
+/**
+ * 変化の通知を購読しているソースがあるかを調べる
+ * @param shared 共有カウンター
+ * @return 購読者がいる場合はtrue
+ *
+ * 購読者がいなければ、そのカウンターを表示しているソースはない（合計ソースだけが参照している場合など）
+ */
+bool match_counter_shared_has_subscribers(match_counter_shared_t *shared);
+
+/**
+ * 適用された操作を1つずつ受け取るコールバックを登録する
+ * @param shared 共有カウンター
+ * @param callback 操作が適用されるたびに呼ばれるコールバック
+ * @param data コールバックに渡すポインタ
+ */
+void match_counter_shared_listen(match_counter_shared_t *shared, match_counter_shared_event_callback_t callback,
+				 void *data);
+
+/**
+ * 適用された操作を1つずつ受け取るコールバックを登録し、登録した時点の勝敗数で1回呼ぶ
+ * @param shared 共有カウンター
+ * @param callback 登録した直後（MATCH_COUNTER_JOURNAL_SNAPSHOT）と、操作が適用されるたびに呼ばれるコールバック
+ * @param data コールバックに渡すポインタ
+ *
+ * 最初の呼び出しも以降の操作と同じくエントリのロックを保持したまま行うため、
+ * 登録の前後に適用された操作を取りこぼしたり、古い値が後から届いたりしない
+ */
+void match_counter_shared_listen_current(match_counter_shared_t *shared,
+					 match_counter_shared_event_callback_t callback, void *data);
+
+/**
+ * 登録したコールバックを解除する
+ * @param shared 共有カウンター
+ * @param callback 登録時に渡したコールバック
+ * @param data 登録時に渡したポインタ
+ *
+ * 戻った時点で、このコールバックが実行中でないことが保証される
+ */
+void match_counter_shared_unlisten(match_counter_shared_t *shared, match_counter_shared_event_callback_t callback,
+				   void *data);
+
+/**
+ * 共有カウンターへの操作を積む（任意のスレッドから呼べる）
+ * @param shared 共有カウンター
+ * @param event 操作の種類（WIN, LOSS, UNDO_WIN, UNDO_LOSS, RESET, SET）
+ * @param wins SETの場合の勝利数
+ * @param losses SETの場合の敗北数
+ * @return 積めた場合はtrue。キューが一杯の場合はfalse
+ *
+ * 操作はロックを取らずにキューへ積むだけで、次のmatch_counter_registry_drain_allで適用される
+ */
+bool match_counter_shared_post(match_counter_shared_t *shared, enum match_counter_journal_event event, int wins,
+			       int losses);
+
+/**
+ * 共有カウンターへの複数の操作を積むための空きを確保する（任意のスレッドから呼べる）
+ * @param shared 共有カウンター
+ * @param count 操作の数（1～MATCH_COUNTER_QUEUE_CAPACITY）
+ * @param pos 確保した位置の格納先
+ * @return 確保できた場合はtrue。キューの空きが足りない場合は何も確保せずにfalse
+ *
+ * 複数の共有カウンターに操作をまとめて積む場合、すべての確保が成功してからmatch_counter_shared_commitで渡す。
+ * 確保した分は必ずcommitで渡し、渡すまでは後から積まれた操作も適用されない
+ */
+bool match_counter_shared_reserve(match_counter_shared_t *shared, size_t count, uint64_t *pos);
+
+/**
+ * 確保した空きに操作を書き込んで適用待ちにする
+ * @param shared 共有カウンター
+ * @param pos match_counter_shared_reserveで確保した位置
+ * @param commands 操作の配列（NULLなら確保を取り消し、何も適用しない）
+ * @param count 確保したときの操作の数
+ *
+ * 積んだ操作はキューの中で連続して並び、取り出す側にはすべて書き込まれてから見えるようになる
+ */
+void match_counter_shared_commit(match_counter_shared_t *shared, uint64_t pos,
+				 const struct match_counter_command *commands, size_t count);
+
+/**
+ * 記録先のキーを選択する（任意のスレッドから呼べる）
+ * @param shared 共有カウンター
+ * @param key キー（空文字列ならキーごとの記録をやめる）
+ * @return 選択が変わった場合はtrue
+ *
+ * キューを通さずにエントリのロックを取って切り替え、変わった場合は次のmatch_counter_registry_drain_allで購読者に通知する。
+ * 切り替えより前に積まれた操作も、次のmatch_counter_registry_drain_allでは新しいキーに記録される
+ */
+bool match_counter_shared_set_matchup(match_counter_shared_t *shared, const char *key);
+
+/**
+ * 直近何試合を集計するかを設定する（任意のスレッドから呼べる）
+ * @param shared 共有カウンター
+ * @param window 試合数（1～MATCH_COUNTER_HISTORY_MAX_WINDOW）
+ * @return 値が変わった場合はtrue
+ *
+ * match_counter_shared_set_matchupと同じく、変わった場合は次のmatch_counter_registry_drain_allで購読者に通知する
+ */
+bool match_counter_shared_set_history_window(match_counter_shared_t *shared, uint32_t window);
+
+/**
+ * 積まれた操作をまとめて適用し、ジャーナルへの追記と購読者への通知を行う
+ * @param shared 共有カウンター
+ * @return 値が変わった操作の数
+ *
+ * 通常はmatch_counter_registry_drain_allから呼ばれる。取り出すスレッドは常に1つでなければならない。
+ * 積まれた操作もキーの変更もなければロックを取らずに戻る。いくつ適用しても通知は1回だけ行い、
+ * 値もキーも変わらなかった場合は追記も通知も行わない。購読者への通知はエントリのロックを放してから行う
+ */
+int match_counter_shared_drain(match_counter_shared_t *shared);
+
+/**
+ * 直前のmatch_counter_shared_drainで値が変わった操作の数を取得する
+ * @param shared 共有カウンター
+ * @return 操作の数（キーの変更だけを通知している場合は0）
+ *
+ * 購読者のコールバックの中で、通知の理由を調べるために使う
+ */
+int match_counter_shared_get_applied(match_counter_shared_t *shared);
+
+/**
+ * 専用のものを含むすべての共有カウンターに積まれた操作を適用する
+ *
+ * 描画スレッドで1フレームに1回だけ呼ぶ（obs_add_tick_callback）。
+ * 同じカウンターを共有するソースがいくつあっても、各エントリはこの1回でまとめて適用される
+ */
+void match_counter_registry_drain_all(void);
+
+#ifdef __cplusplus
+}
+#endif
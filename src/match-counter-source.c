@@ -19,38 +19,164 @@ with this program. If not, see <https://www.gnu.org/licenses/>
 #include <obs-module.h>
 #include <plugin-support.h>
 #include <util/platform.h>
+#include <util/darray.h>
+#include <util/dstr.h>
+#include <util/threading.h>
 #include "match-counter.h"
+#include "match-counter-atomic.h"
+#include "match-counter-compose.h"
+#include "match-counter-export.h"
+#include "match-counter-registry.h"
+#include "match-counter-stats.h"
+#include "match-counter-text-pool.h"
+#include "match-counter-trace.h"
+#include "match-counter-watch.h"
+
+// 描画方式
+enum match_counter_render_mode {
+	MATCH_COUNTER_RENDER_TEXT_SOURCE = 0, // プライベートなテキストソースで描画する
+	MATCH_COUNTER_RENDER_GLYPH_ATLAS = 1, // 文字をアトラスに一度だけラスタライズして描画する
+};
+
+// アトラスに常に含める文字（数字と勝率表示に使う記号）
+#define MATCH_COUNTER_ATLAS_BASE_GLYPHS "0123456789-%."
+// アトラス内の文字同士の間隔
+#define MATCH_COUNTER_ATLAS_PADDING 2
+
+// テキストキャッシュに保持する最大エントリ数
+#define MATCH_COUNTER_TEXT_CACHE_MAX_ENTRIES 16
+// テキストキャッシュのテクスチャの合計サイズの上限（バイト）
+#define MATCH_COUNTER_TEXT_CACHE_BUDGET (16 * 1024 * 1024)
+// 非表示になってからGPUリソースを解放するまでの秒数の既定値
+#define MATCH_COUNTER_DEFAULT_RELEASE_DELAY 30
+// 書き出すファイル1つの大きさの上限の既定値（MiB）
+#define MATCH_COUNTER_DEFAULT_EXPORT_MAX_SIZE 10
+// 残しておく古い書き出しファイルの数の既定値
+#define MATCH_COUNTER_DEFAULT_EXPORT_MAX_FILES 5
+
+// 描画済みテキストのキャッシュの1エントリ
+struct match_counter_text_cache_entry {
+	// キー
+	char *text;
+	char *font_name;
+	uint16_t font_size;
+	uint32_t font_flags;
+
+	gs_texrender_t *texrender; // テキストソースの出力を写したテクスチャ
+	uint32_t cx;
+	uint32_t cy;
+	uint64_t last_used; // 最後に使った時点のtext_cache_clock
+};
+
+// アトラス内の1文字分の情報
+struct match_counter_glyph {
+	uint32_t codepoint;
+	char utf8[5]; // テキストソースに渡すUTF-8表現
+	uint32_t x;   // アトラス内のX座標
+	uint32_t cx;  // 文字幅
+};
 
 struct MatchCounterSource {
 	obs_source_t *source;
 	obs_hotkey_id win_hotkey;
 	obs_hotkey_id loss_hotkey;
 	obs_hotkey_id reset_hotkey;
-	char *format;
+	obs_hotkey_id next_matchup_hotkey;
+	obs_hotkey_id prev_matchup_hotkey;
+#ifdef ENABLE_TRACE
+	obs_hotkey_id trace_hotkey;
+#endif
+	match_counter_format_t *format; // ソースごとの表示フォーマット
 
 	// テキスト描画用の設定
 	gs_texrender_t *texrender;
 	gs_stagesurf_t *stagesurface;
 	uint32_t cx;
 	uint32_t cy;
+	volatile uint64_t extents; // get_width/get_height用に公開する大きさ（上位32bitが幅、下位32bitが高さ）
 	char *text;
 
-	// テキストソース
-	obs_source_t *text_source;
+	// 描画済みテキストのキャッシュ（最近使っていないものから追い出す）
+	DARRAY(struct match_counter_text_cache_entry *) text_cache;
+	struct match_counter_text_cache_entry *text_cache_current; // 描画するエントリ（NULLなら直接描画）
+	uint64_t text_cache_clock;
+	uint64_t text_cache_bytes;
+
+	// GPUリソースとテキストソースは表示されてから作り、非表示のまましばらく経ったら解放する
+	uint32_t release_delay;        // 非表示になってから解放するまでの秒数
+	float idle_seconds;            // 非表示のまま経過した秒数
+	volatile bool release_pending; // 次のtickでリソースを解放する（描画方式の変更時など）
+
+	// 同じフォントのソースで共有するテキストの描画器
+	match_counter_text_renderer_t *text_renderer;
+
+	// グリフアトラス（texrenderにラスタライズ済みの文字）
+	enum match_counter_render_mode render_mode;
+	DARRAY(struct match_counter_glyph) glyphs;
+	int32_t ascii_glyphs[128]; // ASCII文字からglyphsへの索引（-1は未登録）
+	uint32_t atlas_cy;
+	bool atlas_valid;
+	match_counter_composer_t *composer; // アトラスのCPU上のコピーから表示するテキストを合成する
+	DARRAY(uint32_t) compose_indices;   // 合成を依頼する文字のglyphsでの番号
+
+	// 変更検知用のキャッシュ
+	uint64_t rendered_generation; // テキストソースへ最後に反映した世代番号
+	bool text_dirty;              // 次のフレームでテキストを再評価する必要があるか
+	bool font_dirty;              // フォント設定がテキストソースへ未反映か
 
 	// テキストのスタイル設定
 	char *font_name;
 	uint16_t font_size;
 	uint32_t font_flags;
 
-	match_counter_t *counter;
+	// 勝敗数を持つ共有カウンター（IDが空なら専用）
+	match_counter_shared_t *shared;
+	match_counter_t *counter;     // sharedのカウンター
+	pthread_mutex_t shared_mutex; // ホットキーのスレッドとupdateでsharedの差し替えを排他する
+	bool removed;                 // ソースが削除された（破棄時に専用のジャーナルも削除する）
+
+	// ホットキーで順に切り替える対戦カードのキー（shared_mutexで保護する）
+	DARRAY(char *) matchup_keys;
+	size_t matchup_index; // 最後に選んだキーの位置（選択中のキーを探す起点）
+
+	// 前回のupdateで設定にあった集計する試合数と選択中のキー（このソースで変えたときだけ共有カウンターに反映する）
+	uint32_t history_window;
+	char matchup_key[MATCH_COUNTER_MATCHUP_KEY_SIZE];
+
+	// 描画・更新の処理時間
+	match_counter_stats_t *stats;
+
+	// 勝敗の操作の書き出し（設定が変わったときだけ作り直す）
+	match_counter_exporter_t *exporter;
+	enum match_counter_export_format export_format;
+	char *export_path;
+	char *export_label;
+	uint64_t export_max_bytes;
+	uint32_t export_max_files;
+
+	// 外部ツールが書き出す勝敗数のファイル（パスが変わったときだけ監視し直す）
+	match_counter_watch_t *score_watch;
+	char *score_file;
 };
 
 // 前方宣言
+static void match_counter_source_notify_changed(struct MatchCounterSource *context);
+static void match_counter_source_score_changed(void *data, match_counter_shared_t *shared);
+static void match_counter_source_export_event(void *data, enum match_counter_journal_event event,
+					      int64_t timestamp_ms, int wins, int losses);
+static void match_counter_source_score_file_changed(void *data, int wins, int losses);
+static void match_counter_text_cache_clear(struct MatchCounterSource *context);
+static void match_counter_source_refresh_extents(struct MatchCounterSource *context);
+static void match_counter_source_post(struct MatchCounterSource *context, enum match_counter_journal_event event,
+				       const char *func);
 static void match_counter_win_hotkey(void *data, obs_hotkey_pair_id id, obs_hotkey_t *hotkey, bool pressed);
 static void match_counter_loss_hotkey(void *data, obs_hotkey_pair_id id, obs_hotkey_t *hotkey, bool pressed);
 static void match_counter_reset_hotkey(void *data, obs_hotkey_pair_id id, obs_hotkey_t *hotkey, bool pressed);
-static void match_counter_source_render(void *data, gs_effect_t *effect);
+static void match_counter_next_matchup_hotkey(void *data, obs_hotkey_pair_id id, obs_hotkey_t *hotkey, bool pressed);
+static void match_counter_prev_matchup_hotkey(void *data, obs_hotkey_pair_id id, obs_hotkey_t *hotkey, bool pressed);
+#ifdef ENABLE_TRACE
+static void match_counter_trace_hotkey(void *data, obs_hotkey_pair_id id, obs_hotkey_t *hotkey, bool pressed);
+#endif
 
 static const char *match_counter_source_get_name(void *unused)
 {
@@ -58,15 +184,175 @@ static const char *match_counter_source_get_name(void *unused)
 	return obs_module_text("MatchCounterSource");
 }
 
+// ジャーナルのパスを作成する
+// 専用のカウンターはソースのUUID、共有カウンターはIDを16進数にした名前を使う
+static char *match_counter_source_journal_path(struct MatchCounterSource *context, const char *counter_id)
+{
+	char *dir = obs_module_config_path("journal");
+	if (!dir)
+		return NULL;
+
+	struct dstr path = {0};
+	os_mkdirs(dir);
+
+	if (counter_id && *counter_id) {
+		dstr_printf(&path, "%s/shared-", dir);
+		for (const unsigned char *p = (const unsigned char *)counter_id; *p; p++)
+			dstr_catf(&path, "%02x", *p);
+		dstr_cat(&path, ".journal");
+	} else {
+		dstr_printf(&path, "%s/%s.journal", dir, obs_source_get_uuid(context->source));
+	}
+
+	bfree(dir);
+	return path.array;
+}
+
+// カウンターIDに対応する共有カウンターに付け替え、新しく作られた場合はtrueを返す
+// 新しく作られた場合は設定の勝敗数から始めてジャーナルを再生し、既存の場合はその勝敗数とカウンターごとの設定を設定に書き戻す
+static bool match_counter_source_bind(struct MatchCounterSource *context, const char *counter_id, int wins,
+				      int losses)
+{
+	bool created;
+	char *journal_path = match_counter_source_journal_path(context, counter_id);
+	match_counter_shared_t *shared =
+		match_counter_registry_acquire(counter_id, journal_path, wins, losses, &created);
+	bfree(journal_path);
+
+	pthread_mutex_lock(&context->shared_mutex);
+
+	match_counter_shared_t *old = context->shared;
+	if (old) {
+		match_counter_shared_unsubscribe(old, match_counter_source_score_changed, context);
+		if (context->exporter)
+			match_counter_shared_unlisten(old, match_counter_source_export_event, context->exporter);
+	}
+
+	context->shared = shared;
+	context->counter = match_counter_shared_get_counter(shared);
+	match_counter_shared_subscribe(shared, match_counter_source_score_changed, context);
+	if (context->exporter)
+		match_counter_shared_listen(shared, match_counter_source_export_event, context->exporter);
+
+	pthread_mutex_unlock(&context->shared_mutex);
+
+	// 専用のカウンターから共有に切り替えた場合、専用のジャーナルは不要になる
+	match_counter_registry_release(old, true);
+
+	context->text_dirty = true;
+
+	if (!created || wins != match_counter_get_wins(context->counter) ||
+	    losses != match_counter_get_losses(context->counter))
+		match_counter_source_notify_changed(context);
+
+	return created;
+}
+
+// 書き出しの設定が変わった場合はエクスポーターを作り直す（古い方に溜まっている操作は書き出してから破棄する）
+static void match_counter_source_update_export(struct MatchCounterSource *context, obs_data_t *settings,
+					       const char *counter_id)
+{
+	enum match_counter_export_format format =
+		(enum match_counter_export_format)obs_data_get_int(settings, "export_format");
+	const char *path = obs_data_get_string(settings, "export_path");
+	uint64_t max_bytes = (uint64_t)obs_data_get_int(settings, "export_max_size") * 1024 * 1024;
+	uint32_t max_files = (uint32_t)obs_data_get_int(settings, "export_max_files");
+	const char *label = counter_id && *counter_id ? counter_id : obs_source_get_name(context->source);
+
+	if (!path)
+		path = "";
+	if (!label)
+		label = "";
+
+	if (format == context->export_format && max_bytes == context->export_max_bytes &&
+	    max_files == context->export_max_files && context->export_path && strcmp(context->export_path, path) == 0 &&
+	    context->export_label && strcmp(context->export_label, label) == 0)
+		return;
+
+	context->export_format = format;
+	context->export_max_bytes = max_bytes;
+	context->export_max_files = max_files;
+	bfree(context->export_path);
+	context->export_path = bstrdup(path);
+	bfree(context->export_label);
+	context->export_label = bstrdup(label);
+
+	if (context->exporter) {
+		match_counter_shared_unlisten(context->shared, match_counter_source_export_event, context->exporter);
+		match_counter_exporter_destroy(context->exporter);
+	}
+
+	context->exporter = match_counter_exporter_create(path, format, label, max_bytes, max_files);
+	if (context->exporter)
+		match_counter_shared_listen(context->shared, match_counter_source_export_event, context->exporter);
+}
+
+// 勝敗数のファイルのパスが変わった場合は監視し直す（空なら監視しない）
+static void match_counter_source_update_score_file(struct MatchCounterSource *context, obs_data_t *settings)
+{
+	const char *path = obs_data_get_string(settings, "score_file");
+	if (!path)
+		path = "";
+
+	if (strcmp(context->score_file ? context->score_file : "", path) == 0)
+		return;
+
+	bfree(context->score_file);
+	context->score_file = bstrdup(path);
+
+	match_counter_watch_destroy(context->score_watch);
+	context->score_watch = match_counter_watch_create(path, match_counter_source_score_file_changed, context);
+}
+
+static void match_counter_source_clear_matchup_keys(struct MatchCounterSource *context)
+{
+	for (size_t i = 0; i < context->matchup_keys.num; i++)
+		bfree(context->matchup_keys.array[i]);
+	da_resize(context->matchup_keys, 0);
+}
+
+// ホットキーで切り替えるキーの一覧を反映し、applyがtrueなら選択中の対戦カードも切り替える
+static void match_counter_source_update_matchup(struct MatchCounterSource *context, obs_data_t *settings,
+						const char *key, bool apply)
+{
+	obs_data_array_t *keys = obs_data_get_array(settings, "matchup_keys");
+	size_t count = obs_data_array_count(keys);
+
+	if (!key)
+		key = "";
+	if (strlen(key) >= MATCH_COUNTER_MATCHUP_KEY_SIZE)
+		blog(LOG_WARNING, "match_counter_source_update_matchup: Matchup key '%s' is longer than %d bytes", key,
+		     MATCH_COUNTER_MATCHUP_KEY_SIZE - 1);
+
+	pthread_mutex_lock(&context->shared_mutex);
+
+	match_counter_source_clear_matchup_keys(context);
+	for (size_t i = 0; i < count; i++) {
+		obs_data_t *item = obs_data_array_item(keys, i);
+		const char *value = obs_data_get_string(item, "value");
+		if (value && *value && strlen(value) < MATCH_COUNTER_MATCHUP_KEY_SIZE) {
+			char *copy = bstrdup(value);
+			da_push_back(context->matchup_keys, &copy);
+		}
+		obs_data_release(item);
+	}
+	context->matchup_index = 0;
+
+	// キーが変わった場合だけ切り替える（同じキーなら世代番号も進まない）
+	if (apply)
+		match_counter_shared_set_matchup(context->shared, key);
+
+	pthread_mutex_unlock(&context->shared_mutex);
+
+	obs_data_array_release(keys);
+}
+
 static void match_counter_source_update(void *data, obs_data_t *settings)
 {
 	blog(LOG_INFO, "match_counter_source_update: Updating match counter source");
 
 	struct MatchCounterSource *context = data;
-	if (context->counter) {
-		match_counter_destroy(context->counter);
-	}
-	context->counter = match_counter_create();
+	uint64_t start_ns = os_gettime_ns();
 
 	const char *format = obs_data_get_string(settings, "format");
 
@@ -82,24 +368,204 @@ static void match_counter_source_update(void *data, obs_data_t *settings)
 	if (font_size <= 0)
 		font_size = 256;
 
-	bfree(context->format);
-	bfree(context->font_name);
+	if (!font_name || !strlen(font_name))
+		font_name = "Arial";
 
-	context->format = bstrdup(format);
-	context->font_name = bstrdup(font_name && strlen(font_name) ? font_name : "Arial");
-	context->font_size = font_size;
-	context->font_flags = font_flags;
+	bool font_changed = !context->font_name || strcmp(context->font_name, font_name) != 0 ||
+			    context->font_size != font_size || context->font_flags != font_flags;
 
-	context->counter->wins = (int)obs_data_get_int(settings, "wins");
-	context->counter->losses = (int)obs_data_get_int(settings, "losses");
+	if (match_counter_format_set(context->format, format))
+		context->text_dirty = true;
+
+	if (font_changed) {
+		bfree(context->font_name);
+		context->font_name = bstrdup(font_name);
+		context->font_size = font_size;
+		context->font_flags = font_flags;
+		context->font_dirty = true;
+	}
 
 	obs_data_release(font_obj);
 
-	match_counter_set_format(context->counter, format);
+	// カウンターIDが変わった場合は共有カウンターを付け替え、そうでなければ設定の勝敗数を反映する
+	const char *counter_id = obs_data_get_string(settings, "counter_id");
+	int wins = (int)obs_data_get_int(settings, "wins");
+	int losses = (int)obs_data_get_int(settings, "losses");
+
+	// 付け替え時の通知で設定の試合数とキーが共有カウンター側の値に書き戻されるため、先に控えておく
+	uint32_t history_window = (uint32_t)obs_data_get_int(settings, "history_window");
+	char *matchup_key = bstrdup(obs_data_get_string(settings, "matchup_key"));
+
+	bool rebound = !context->shared ||
+		       strcmp(match_counter_shared_get_id(context->shared), counter_id ? counter_id : "") != 0;
+	bool created = false;
+	if (rebound)
+		created = match_counter_source_bind(context, counter_id, wins, losses);
+	else if (wins != match_counter_get_wins(context->counter) ||
+		 losses != match_counter_get_losses(context->counter))
+		match_counter_shared_post(context->shared, MATCH_COUNTER_JOURNAL_SET, wins, losses);
+
+	match_counter_source_update_export(context, settings, counter_id);
+
+	// 集計する試合数と選択中のキーは共有カウンターごとの設定なので、カウンターを作ったソースか、
+	// このソースで設定を変えた場合だけ反映する。既存のカウンターに付け替えた場合はその値に合わせる
+	bool adopt = rebound && !created;
+	if (adopt) {
+		match_counter_snapshot_t snapshot;
+		match_counter_get_snapshot(context->counter, &snapshot);
+		history_window = match_counter_get_history_window(context->counter);
+		bfree(matchup_key);
+		matchup_key = bstrdup(snapshot.matchup_key);
+	}
+
+	// 変化があった場合のみ世代番号が進み、次のフレームでテキストが再評価される
+	if (!adopt && (created || history_window != context->history_window))
+		match_counter_shared_set_history_window(context->shared, history_window);
+	match_counter_source_update_matchup(context, settings, matchup_key,
+					    !adopt && (created || strcmp(matchup_key, context->matchup_key) != 0));
 
-	match_counter_source_render(context, NULL);
+	context->history_window = history_window;
+	snprintf(context->matchup_key, sizeof(context->matchup_key), "%s", matchup_key);
+	bfree(matchup_key);
+
+	// ファイルの勝敗数は共有カウンターを付け替えた後で積む
+	match_counter_source_update_score_file(context, settings);
+
+	enum match_counter_render_mode render_mode =
+		(enum match_counter_render_mode)obs_data_get_int(settings, "render_mode");
+	if (render_mode != context->render_mode) {
+		context->render_mode = render_mode;
+		context->text_dirty = true;
+		context->font_dirty = true;
+
+		// 前の描画方式のリソースは描画スレッドで解放する
+		os_atomic_set_bool(&context->release_pending, true);
+	}
+
+	context->release_delay = (uint32_t)obs_data_get_int(settings, "release_delay");
 
 	blog(LOG_DEBUG, "match_counter_source_update: Updated with format='%s'", format);
+	match_counter_stats_record(context->stats, MATCH_COUNTER_STAT_UPDATE, os_gettime_ns() - start_ns);
+}
+
+// proc: void get_stats(out string json)
+static void match_counter_source_proc_get_stats(void *data, calldata_t *cd)
+{
+	struct MatchCounterSource *context = data;
+	struct dstr json = {0};
+
+	match_counter_stats_to_json(context->stats, &json);
+	calldata_set_string(cd, "json", json.array);
+	dstr_free(&json);
+}
+
+// proc: void log_stats()
+static void match_counter_source_proc_log_stats(void *data, calldata_t *cd)
+{
+	UNUSED_PARAMETER(cd);
+	struct MatchCounterSource *context = data;
+	match_counter_stats_log(context->stats, obs_source_get_name(context->source));
+}
+
+// proc: void reset_stats()
+static void match_counter_source_proc_reset_stats(void *data, calldata_t *cd)
+{
+	UNUSED_PARAMETER(cd);
+	struct MatchCounterSource *context = data;
+	match_counter_stats_reset(context->stats);
+}
+
+// proc: void get_score(out int wins, out int losses, out int generation)
+static void match_counter_source_proc_get_score(void *data, calldata_t *cd)
+{
+	struct MatchCounterSource *context = data;
+	match_counter_snapshot_t snapshot;
+
+	pthread_mutex_lock(&context->shared_mutex);
+	match_counter_get_snapshot(context->counter, &snapshot);
+	pthread_mutex_unlock(&context->shared_mutex);
+
+	calldata_set_int(cd, "wins", snapshot.wins);
+	calldata_set_int(cd, "losses", snapshot.losses);
+	calldata_set_int(cd, "generation", (long long)snapshot.generation);
+}
+
+// proc: void set_matchup(in string key)
+static void match_counter_source_proc_set_matchup(void *data, calldata_t *cd)
+{
+	struct MatchCounterSource *context = data;
+	const char *key = calldata_string(cd, "key");
+
+	pthread_mutex_lock(&context->shared_mutex);
+	match_counter_shared_set_matchup(context->shared, key ? key : "");
+	pthread_mutex_unlock(&context->shared_mutex);
+}
+
+// proc: void get_matchup(out string key, out int wins, out int losses)
+static void match_counter_source_proc_get_matchup(void *data, calldata_t *cd)
+{
+	struct MatchCounterSource *context = data;
+	match_counter_snapshot_t snapshot;
+
+	pthread_mutex_lock(&context->shared_mutex);
+	match_counter_get_snapshot(context->counter, &snapshot);
+	pthread_mutex_unlock(&context->shared_mutex);
+
+	calldata_set_string(cd, "key", snapshot.matchup_key);
+	calldata_set_int(cd, "wins", snapshot.matchup_wins);
+	calldata_set_int(cd, "losses", snapshot.matchup_losses);
+}
+
+// proc: void add_win()
+static void match_counter_source_proc_add_win(void *data, calldata_t *cd)
+{
+	UNUSED_PARAMETER(cd);
+	match_counter_source_post(data, MATCH_COUNTER_JOURNAL_WIN, "match_counter_source_proc_add_win");
+}
+
+// proc: void add_loss()
+static void match_counter_source_proc_add_loss(void *data, calldata_t *cd)
+{
+	UNUSED_PARAMETER(cd);
+	match_counter_source_post(data, MATCH_COUNTER_JOURNAL_LOSS, "match_counter_source_proc_add_loss");
+}
+
+// proc: void subtract_win()
+static void match_counter_source_proc_subtract_win(void *data, calldata_t *cd)
+{
+	UNUSED_PARAMETER(cd);
+	match_counter_source_post(data, MATCH_COUNTER_JOURNAL_UNDO_WIN, "match_counter_source_proc_subtract_win");
+}
+
+// proc: void subtract_loss()
+static void match_counter_source_proc_subtract_loss(void *data, calldata_t *cd)
+{
+	UNUSED_PARAMETER(cd);
+	match_counter_source_post(data, MATCH_COUNTER_JOURNAL_UNDO_LOSS, "match_counter_source_proc_subtract_loss");
+}
+
+// proc: void reset()
+static void match_counter_source_proc_reset(void *data, calldata_t *cd)
+{
+	UNUSED_PARAMETER(cd);
+	match_counter_source_post(data, MATCH_COUNTER_JOURNAL_RESET, "match_counter_source_proc_reset");
+}
+
+#ifdef ENABLE_TRACE
+// proc: void dump_trace()
+static void match_counter_source_proc_dump_trace(void *data, calldata_t *cd)
+{
+	UNUSED_PARAMETER(cd);
+	struct MatchCounterSource *context = data;
+	match_counter_trace_dump(context, obs_source_get_name(context->source));
+}
+#endif
+
+static void match_counter_source_removed(void *data, calldata_t *cd)
+{
+	UNUSED_PARAMETER(cd);
+	struct MatchCounterSource *context = data;
+	context->removed = true;
 }
 
 static void *match_counter_source_create(obs_data_t *settings, obs_source_t *source)
@@ -108,18 +574,53 @@ static void *match_counter_source_create(obs_data_t *settings, obs_source_t *sou
 
 	struct MatchCounterSource *context = bzalloc(sizeof(struct MatchCounterSource));
 	context->source = source;
-	context->format = bstrdup("%w-%l(%r)");
+	context->format = match_counter_format_create("%w-%l(%r)");
+	pthread_mutex_init(&context->shared_mutex, NULL);
+	context->stats = match_counter_stats_create();
 
-	// テキスト描画用の設定
-	context->texrender = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+	// テキスト描画用の設定（texrenderとテキストソースは表示されたときに作る）
 	context->font_name = bstrdup("Arial");
 	context->font_size = 32;
 	context->font_flags = 0;
+	da_init(context->glyphs);
+	da_init(context->compose_indices);
+	da_init(context->text_cache);
+	da_init(context->matchup_keys);
+	for (size_t i = 0; i < 128; i++)
+		context->ascii_glyphs[i] = -1;
+
+	blog(LOG_DEBUG, "match_counter_source_create: Initializing with format='%s'",
+	     match_counter_format_get(context->format));
 
-	blog(LOG_DEBUG, "match_counter_source_create: Initializing with format='%s'", context->format);
+	// 勝敗数の変化を通知するシグナル（updateで勝敗数を反映する前に宣言しておく）
+	signal_handler_t *sh = obs_source_get_signal_handler(source);
+	signal_handler_add(sh, "void counter_changed(ptr source, int wins, int losses, int generation)");
 
 	match_counter_source_update(context, settings);
 
+	signal_handler_connect(sh, "remove", match_counter_source_removed, context);
+
+	// ドックやスクリプトから勝敗数を操作できるようにする
+	proc_handler_t *ph = obs_source_get_proc_handler(source);
+	proc_handler_add(ph, "void get_score(out int wins, out int losses, out int generation)",
+			 match_counter_source_proc_get_score, context);
+	proc_handler_add(ph, "void add_win()", match_counter_source_proc_add_win, context);
+	proc_handler_add(ph, "void add_loss()", match_counter_source_proc_add_loss, context);
+	proc_handler_add(ph, "void subtract_win()", match_counter_source_proc_subtract_win, context);
+	proc_handler_add(ph, "void subtract_loss()", match_counter_source_proc_subtract_loss, context);
+	proc_handler_add(ph, "void reset()", match_counter_source_proc_reset, context);
+	proc_handler_add(ph, "void set_matchup(in string key)", match_counter_source_proc_set_matchup, context);
+	proc_handler_add(ph, "void get_matchup(out string key, out int wins, out int losses)",
+			 match_counter_source_proc_get_matchup, context);
+
+	// 処理時間の統計を外部から取得できるようにする
+	proc_handler_add(ph, "void get_stats(out string json)", match_counter_source_proc_get_stats, context);
+	proc_handler_add(ph, "void log_stats()", match_counter_source_proc_log_stats, context);
+	proc_handler_add(ph, "void reset_stats()", match_counter_source_proc_reset_stats, context);
+#ifdef ENABLE_TRACE
+	proc_handler_add(ph, "void dump_trace()", match_counter_source_proc_dump_trace, context);
+#endif
+
 	// ホットキーの設定
 	context->win_hotkey = obs_hotkey_register_source(source, "match_counter_win", obs_module_text("AddWin"),
 							 match_counter_win_hotkey, context);
@@ -130,6 +631,20 @@ static void *match_counter_source_create(obs_data_t *settings, obs_source_t *sou
 	context->reset_hotkey = obs_hotkey_register_source(
 		source, "match_counter_reset", obs_module_text("ResetCounter"), match_counter_reset_hotkey, context);
 
+	context->next_matchup_hotkey = obs_hotkey_register_source(source, "match_counter_next_matchup",
+								  obs_module_text("NextMatchup"),
+								  match_counter_next_matchup_hotkey, context);
+
+	context->prev_matchup_hotkey = obs_hotkey_register_source(source, "match_counter_prev_matchup",
+								  obs_module_text("PreviousMatchup"),
+								  match_counter_prev_matchup_hotkey, context);
+
+#ifdef ENABLE_TRACE
+	context->trace_hotkey = obs_hotkey_register_source(source, "match_counter_dump_trace",
+							   obs_module_text("DumpTrace"), match_counter_trace_hotkey,
+							   context);
+#endif
+
 	blog(LOG_INFO, "match_counter_source_create: Match counter source created successfully");
 	return context;
 }
@@ -143,25 +658,66 @@ static void match_counter_source_destroy(void *data)
 	obs_hotkey_unregister(context->win_hotkey);
 	obs_hotkey_unregister(context->loss_hotkey);
 	obs_hotkey_unregister(context->reset_hotkey);
+	obs_hotkey_unregister(context->next_matchup_hotkey);
+	obs_hotkey_unregister(context->prev_matchup_hotkey);
+#ifdef ENABLE_TRACE
+	obs_hotkey_unregister(context->trace_hotkey);
+#endif
 
-	// テキスト描画リソースの解放
-	if (context->texrender) {
-		gs_texrender_destroy(context->texrender);
-		context->texrender = NULL;
+	signal_handler_disconnect(obs_source_get_signal_handler(context->source), "remove",
+				  match_counter_source_removed, context);
+
+	// 監視のコールバックはsharedを使うため、先に止める
+	match_counter_watch_destroy(context->score_watch);
+	context->score_watch = NULL;
+	bfree(context->score_file);
+
+	// 書き出し待ちの操作はファイルに書いてから破棄する
+	if (context->exporter) {
+		match_counter_shared_unlisten(context->shared, match_counter_source_export_event, context->exporter);
+		match_counter_exporter_destroy(context->exporter);
+		context->exporter = NULL;
 	}
+	bfree(context->export_path);
+	bfree(context->export_label);
+
+	// 削除されたソースの専用ジャーナルは残さない
+	match_counter_shared_unsubscribe(context->shared, match_counter_source_score_changed, context);
+	match_counter_registry_release(context->shared, context->removed);
+	context->shared = NULL;
+	context->counter = NULL;
+
+	// テキスト描画リソースの解放
+	obs_enter_graphics();
+	match_counter_text_cache_clear(context);
+	gs_texrender_destroy(context->texrender);
+	context->texrender = NULL;
+	match_counter_composer_destroy(context->composer);
+	context->composer = NULL;
+	obs_leave_graphics();
+	da_free(context->text_cache);
+	da_free(context->compose_indices);
+
 	if (context->stagesurface) {
 		gs_stagesurface_destroy(context->stagesurface);
 		context->stagesurface = NULL;
 	}
 
 	// テキストソースの解放
-	if (context->text_source) {
-		blog(LOG_DEBUG, "match_counter_source_destroy: Releasing text source");
-		obs_source_release(context->text_source);
-		context->text_source = NULL;
+	if (context->text_renderer) {
+		blog(LOG_DEBUG, "match_counter_source_destroy: Releasing text renderer");
+		match_counter_text_pool_release(context->text_renderer);
+		context->text_renderer = NULL;
 	}
 
-	bfree(context->format);
+	da_free(context->glyphs);
+
+	match_counter_source_clear_matchup_keys(context);
+	da_free(context->matchup_keys);
+
+	pthread_mutex_destroy(&context->shared_mutex);
+	match_counter_format_destroy(context->format);
+	match_counter_stats_destroy(context->stats);
 	bfree(context->font_name);
 	bfree(context->text);
 	bfree(context);
@@ -169,6 +725,130 @@ static void match_counter_source_destroy(void *data)
 	blog(LOG_INFO, "match_counter_source_destroy: Match counter source destroyed");
 }
 
+// ホットキーや同じカウンターの他のソースで変更された勝敗数・選択中のキー・集計する試合数を設定に書き戻す
+// obs_source_updateは呼ばないため、カウンターの作り直しやフォントの再読み込みは起きない
+static void match_counter_source_save_score(struct MatchCounterSource *context,
+					    const match_counter_snapshot_t *snapshot)
+{
+	obs_data_t *settings = obs_source_get_settings(context->source);
+	obs_data_set_int(settings, "wins", snapshot->wins);
+	obs_data_set_int(settings, "losses", snapshot->losses);
+	obs_data_set_string(settings, "matchup_key", snapshot->matchup_key);
+	obs_data_set_int(settings, "history_window", match_counter_get_history_window(context->counter));
+	obs_data_release(settings);
+}
+
+// 勝敗数が変わったことを設定・シグナル・プロパティ画面に伝える
+static void match_counter_source_notify_changed(struct MatchCounterSource *context)
+{
+	match_counter_snapshot_t snapshot;
+	match_counter_get_snapshot(context->counter, &snapshot);
+
+	match_counter_source_save_score(context, &snapshot);
+
+	// ドックやスクリプトはこのシグナルで差分だけを反映できる
+	uint8_t stack[128];
+	calldata_t cd;
+	calldata_init_fixed(&cd, stack, sizeof(stack));
+	calldata_set_ptr(&cd, "source", context->source);
+	calldata_set_int(&cd, "wins", snapshot.wins);
+	calldata_set_int(&cd, "losses", snapshot.losses);
+	calldata_set_int(&cd, "generation", (long long)snapshot.generation);
+	signal_handler_signal(obs_source_get_signal_handler(context->source), "counter_changed", &cd);
+
+	// update_propertiesを受け取るのは開いているプロパティ画面だけなので、閉じていれば再構築は起きない
+	obs_source_update_properties(context->source);
+}
+
+// 共有カウンターが変化した（フレームの始めに描画スレッドから呼ばれる）
+// 描画側は世代番号で変化を検知するため、ここでは通知だけを行う
+static void match_counter_source_score_changed(void *data, match_counter_shared_t *shared)
+{
+	struct MatchCounterSource *context = data;
+
+	int applied = match_counter_shared_get_applied(shared);
+	if (applied)
+		MATCH_COUNTER_TRACE(context, MATCH_COUNTER_TRACE_SCORE_CHANGE, applied,
+				    match_counter_get_wins(context->counter),
+				    match_counter_get_losses(context->counter));
+
+	match_counter_source_notify_changed(context);
+}
+
+// 適用された操作をエクスポーターに渡す（描画スレッドから呼ばれるため、書き込みは待たない）
+static void match_counter_source_export_event(void *data, enum match_counter_journal_event event,
+					      int64_t timestamp_ms, int wins, int losses)
+{
+	match_counter_exporter_push(data, event, timestamp_ms, wins, losses);
+}
+
+// ホットキー・ドックからの操作を共有カウンターのキューに積む（適用は次のフレームの始め）
+static void match_counter_source_post(struct MatchCounterSource *context, enum match_counter_journal_event event,
+				      const char *func)
+{
+	pthread_mutex_lock(&context->shared_mutex);
+	bool posted = match_counter_shared_post(context->shared, event, 0, 0);
+	pthread_mutex_unlock(&context->shared_mutex);
+
+	if (!posted)
+		blog(LOG_WARNING, "%s: Command queue is full, dropping input", func);
+}
+
+// 監視中のファイルから読んだ勝敗数を、ホットキーと同じく共有カウンターのキューに積む（ウォッチャーのスレッド）
+static void match_counter_source_score_file_changed(void *data, int wins, int losses)
+{
+	struct MatchCounterSource *context = data;
+
+	pthread_mutex_lock(&context->shared_mutex);
+	bool posted = match_counter_shared_post(context->shared, MATCH_COUNTER_JOURNAL_SET, wins, losses);
+	pthread_mutex_unlock(&context->shared_mutex);
+
+	if (!posted)
+		blog(LOG_WARNING, "match_counter_source_score_file_changed: Command queue is full, dropping input");
+}
+
+// テキストキャッシュ・アトラス・テキストソースを解放する（次に表示されたときに作り直す）
+static void match_counter_source_release_resources(struct MatchCounterSource *context)
+{
+	if (!context->texrender && !context->text_renderer && !context->text_cache.num && !context->composer)
+		return;
+
+	obs_enter_graphics();
+	match_counter_text_cache_clear(context);
+	gs_texrender_destroy(context->texrender);
+	context->texrender = NULL;
+	match_counter_composer_destroy(context->composer);
+	context->composer = NULL;
+	obs_leave_graphics();
+	context->atlas_valid = false;
+
+	match_counter_text_pool_release(context->text_renderer);
+	context->text_renderer = NULL;
+
+	// 新しい描画器にフォントと表示内容を反映させる
+	context->text_dirty = true;
+	context->font_dirty = true;
+
+	blog(LOG_DEBUG, "match_counter_source_release_resources: Released GPU resources of '%s'",
+	     obs_source_get_name(context->source));
+}
+
+// 積まれた操作を1フレームに1回まとめて適用する
+static void match_counter_source_video_tick(void *data, float seconds)
+{
+	struct MatchCounterSource *context = data;
+
+	// 非表示のまましばらく経ったソースはVRAMとテキストソースを空ける
+	bool showing = obs_source_showing(context->source);
+	context->idle_seconds = showing ? 0.0f : context->idle_seconds + seconds;
+
+	bool idle = !showing && context->idle_seconds >= (float)context->release_delay;
+	if (os_atomic_set_bool(&context->release_pending, false) || idle)
+		match_counter_source_release_resources(context);
+
+	match_counter_source_refresh_extents(context);
+}
+
 static void match_counter_win_hotkey(void *data, obs_hotkey_pair_id id, obs_hotkey_t *hotkey, bool pressed)
 {
 	UNUSED_PARAMETER(id);
@@ -178,17 +858,7 @@ static void match_counter_win_hotkey(void *data, obs_hotkey_pair_id id, obs_hotk
 
 	if (pressed) {
 		blog(LOG_INFO, "match_counter_win_hotkey: Adding win");
-		match_counter_add_win(context->counter);
-
-		// 設定値を更新
-		obs_data_t *settings = obs_source_get_settings(context->source);
-		obs_data_set_int(settings, "wins", match_counter_get_wins(context->counter));
-		obs_source_update(context->source, settings);
-		obs_data_release(settings);
-
-		obs_source_update_properties(context->source);
-		blog(LOG_DEBUG, "match_counter_win_hotkey: Current score - wins=%d, losses=%d",
-		     match_counter_get_wins(context->counter), match_counter_get_losses(context->counter));
+		match_counter_source_post(context, MATCH_COUNTER_JOURNAL_WIN, "match_counter_win_hotkey");
 	}
 }
 
@@ -201,17 +871,7 @@ static void match_counter_loss_hotkey(void *data, obs_hotkey_pair_id id, obs_hot
 
 	if (pressed) {
 		blog(LOG_INFO, "match_counter_loss_hotkey: Adding loss");
-		match_counter_add_loss(context->counter);
-
-		// 設定値を更新
-		obs_data_t *settings = obs_source_get_settings(context->source);
-		obs_data_set_int(settings, "losses", match_counter_get_losses(context->counter));
-		obs_source_update(context->source, settings);
-		obs_data_release(settings);
-
-		obs_source_update_properties(context->source);
-		blog(LOG_DEBUG, "match_counter_loss_hotkey: Current score - wins=%d, losses=%d",
-		     match_counter_get_wins(context->counter), match_counter_get_losses(context->counter));
+		match_counter_source_post(context, MATCH_COUNTER_JOURNAL_LOSS, "match_counter_loss_hotkey");
 	}
 }
 
@@ -224,127 +884,668 @@ static void match_counter_reset_hotkey(void *data, obs_hotkey_pair_id id, obs_ho
 
 	if (pressed) {
 		blog(LOG_INFO, "match_counter_reset_hotkey: Resetting counter");
-		match_counter_reset(context->counter);
+		match_counter_source_post(context, MATCH_COUNTER_JOURNAL_RESET, "match_counter_reset_hotkey");
+	}
+}
+
+// 一覧の次（stepが負なら前）のキーに切り替える（選択中のキーが一覧になければ端から）
+static void match_counter_source_cycle_matchup(struct MatchCounterSource *context, int step)
+{
+	pthread_mutex_lock(&context->shared_mutex);
+
+	size_t count = context->matchup_keys.num;
+	if (count) {
+		match_counter_snapshot_t snapshot;
+		match_counter_get_snapshot(context->counter, &snapshot);
+
+		// 前回選んだ位置から探すため、ホットキーだけで切り替えている間は一覧を走査しない
+		size_t index = count;
+		for (size_t i = 0; i < count; i++) {
+			size_t candidate = (context->matchup_index + i) % count;
+			if (strcmp(context->matchup_keys.array[candidate], snapshot.matchup_key) == 0) {
+				index = candidate;
+				break;
+			}
+		}
 
-		// 設定値を更新
-		obs_data_t *settings = obs_source_get_settings(context->source);
-		obs_data_set_int(settings, "wins", 0);
-		obs_data_set_int(settings, "losses", 0);
-		obs_source_update(context->source, settings);
-		obs_data_release(settings);
+		if (index == count)
+			index = step > 0 ? 0 : count - 1;
+		else
+			index = step > 0 ? (index + 1) % count : (index + count - 1) % count;
 
-		obs_source_update_properties(context->source);
-		blog(LOG_DEBUG, "match_counter_reset_hotkey: Counter reset - wins=%d, losses=%d",
-		     match_counter_get_wins(context->counter), match_counter_get_losses(context->counter));
+		context->matchup_index = index;
+		match_counter_shared_set_matchup(context->shared, context->matchup_keys.array[index]);
 	}
+
+	pthread_mutex_unlock(&context->shared_mutex);
 }
 
-static void match_counter_source_render(void *data, gs_effect_t *effect)
+static void match_counter_next_matchup_hotkey(void *data, obs_hotkey_pair_id id, obs_hotkey_t *hotkey, bool pressed)
 {
-	UNUSED_PARAMETER(effect);
+	UNUSED_PARAMETER(id);
+	UNUSED_PARAMETER(hotkey);
+
+	if (pressed)
+		match_counter_source_cycle_matchup(data, 1);
+}
+
+static void match_counter_prev_matchup_hotkey(void *data, obs_hotkey_pair_id id, obs_hotkey_t *hotkey, bool pressed)
+{
+	UNUSED_PARAMETER(id);
+	UNUSED_PARAMETER(hotkey);
+
+	if (pressed)
+		match_counter_source_cycle_matchup(data, -1);
+}
+
+#ifdef ENABLE_TRACE
+static void match_counter_trace_hotkey(void *data, obs_hotkey_pair_id id, obs_hotkey_t *hotkey, bool pressed)
+{
+	UNUSED_PARAMETER(id);
+	UNUSED_PARAMETER(hotkey);
+
 	struct MatchCounterSource *context = data;
 
-	// テキストソースがない場合は作成
-	if (!context->text_source) {
-		blog(LOG_DEBUG, "match_counter_source_render: Creating text source");
-#ifdef _WIN32
-		context->text_source = obs_source_create_private("text_gdiplus", "match_counter_text", NULL);
-#else
-		context->text_source = obs_source_create_private("text_ft2_source", "match_counter_text", NULL);
+	if (pressed)
+		match_counter_trace_dump(context, obs_source_get_name(context->source));
+}
 #endif
 
-		if (!context->text_source) {
-			blog(LOG_ERROR, "match_counter_source_render: Failed to create text source");
-			return;
+// 現在のフォントの描画器を用意する（フォントが変わった場合は取り直す）
+static bool match_counter_source_ensure_text_renderer(struct MatchCounterSource *context)
+{
+	if (context->text_renderer && !context->font_dirty)
+		return true;
+
+	match_counter_text_pool_release(context->text_renderer);
+	context->text_renderer =
+		match_counter_text_pool_acquire(context->font_name, context->font_size, context->font_flags);
+	MATCH_COUNTER_TRACE(context, MATCH_COUNTER_TRACE_TEXT_SOURCE_CREATE, context->text_renderer != NULL, 0, 0);
+
+	if (!context->text_renderer) {
+		blog(LOG_ERROR, "match_counter_source_ensure_text_renderer: Failed to acquire text renderer");
+		return false;
+	}
+
+	// 新しい描画器にはこのソースの表示内容が反映されていない
+	context->font_dirty = true;
+	context->text_dirty = true;
+	return true;
+}
+
+// 測った大きさを記録する（get_width/get_heightは描画スレッド以外からも呼ばれる）
+static void match_counter_source_set_extents(struct MatchCounterSource *context, uint32_t cx, uint32_t cy)
+{
+	context->cx = cx;
+	context->cy = cy;
+	match_counter_atomic_store_u64(&context->extents, ((uint64_t)cx << 32) | cy);
+}
+
+static void match_counter_text_cache_destroy_entry(struct match_counter_text_cache_entry *entry)
+{
+	gs_texrender_destroy(entry->texrender);
+	bfree(entry->text);
+	bfree(entry->font_name);
+	bfree(entry);
+}
+
+static void match_counter_text_cache_update_usage(struct MatchCounterSource *context)
+{
+	match_counter_stats_set_cache_usage(context->stats, context->text_cache.num, context->text_cache_bytes);
+}
+
+// グラフィックスコンテキスト内で呼ぶ
+static void match_counter_text_cache_clear(struct MatchCounterSource *context)
+{
+	for (size_t i = 0; i < context->text_cache.num; i++)
+		match_counter_text_cache_destroy_entry(context->text_cache.array[i]);
+
+	da_clear(context->text_cache);
+	context->text_cache_current = NULL;
+	context->text_cache_bytes = 0;
+	match_counter_text_cache_update_usage(context);
+}
+
+static struct match_counter_text_cache_entry *match_counter_text_cache_find(struct MatchCounterSource *context,
+									    const char *text)
+{
+	for (size_t i = 0; i < context->text_cache.num; i++) {
+		struct match_counter_text_cache_entry *entry = context->text_cache.array[i];
+		if (entry->font_size == context->font_size && entry->font_flags == context->font_flags &&
+		    strcmp(entry->text, text) == 0 && strcmp(entry->font_name, context->font_name) == 0)
+			return entry;
+	}
+	return NULL;
+}
+
+// エントリ数かテクスチャの合計サイズが上限を超えていれば、keep以外で最も古いものから追い出す
+static void match_counter_text_cache_trim(struct MatchCounterSource *context,
+					  const struct match_counter_text_cache_entry *keep)
+{
+	while (context->text_cache.num > 1 && (context->text_cache.num > MATCH_COUNTER_TEXT_CACHE_MAX_ENTRIES ||
+					       context->text_cache_bytes > MATCH_COUNTER_TEXT_CACHE_BUDGET)) {
+		size_t oldest = DARRAY_INVALID;
+		for (size_t i = 0; i < context->text_cache.num; i++) {
+			struct match_counter_text_cache_entry *entry = context->text_cache.array[i];
+			if (entry != keep && (oldest == DARRAY_INVALID ||
+					      entry->last_used < context->text_cache.array[oldest]->last_used))
+				oldest = i;
 		}
-		blog(LOG_DEBUG, "match_counter_source_render: Text source created successfully");
+
+		struct match_counter_text_cache_entry *entry = context->text_cache.array[oldest];
+		context->text_cache_bytes -= (uint64_t)entry->cx * entry->cy * 4;
+		da_erase(context->text_cache, oldest);
+		match_counter_text_cache_destroy_entry(entry);
 	}
 
-	// 現在のテキストを取得
-	const char *formatted_text = match_counter_get_formatted_text(context->counter);
+	match_counter_text_cache_update_usage(context);
+}
 
-	// テキストが空の場合はスキップ
-	if (!formatted_text || !strlen(formatted_text)) {
-		blog(LOG_INFO, "match_counter_source_render: Empty text, skipping render");
-		bfree((void *)formatted_text);
+// テキストソースの現在の出力をテクスチャに写してキャッシュに追加する
+static struct match_counter_text_cache_entry *match_counter_text_cache_insert(struct MatchCounterSource *context)
+{
+	uint32_t cx = context->cx;
+	uint32_t cy = context->cy;
+	if (!cx || !cy)
+		return NULL;
+
+	gs_texrender_t *texrender = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+	if (!texrender || !gs_texrender_begin(texrender, cx, cy)) {
+		gs_texrender_destroy(texrender);
+		return NULL;
+	}
+
+	struct vec4 clear_color;
+	vec4_zero(&clear_color);
+
+	gs_clear(GS_CLEAR_COLOR, &clear_color, 0.0f, 0);
+	gs_ortho(0.0f, (float)cx, 0.0f, (float)cy, -100.0f, 100.0f);
+
+	gs_blend_state_push();
+	gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
+	match_counter_text_renderer_render(context->text_renderer);
+	gs_blend_state_pop();
+
+	gs_texrender_end(texrender);
+
+	struct match_counter_text_cache_entry *entry = bzalloc(sizeof(struct match_counter_text_cache_entry));
+	entry->text = bstrdup(context->text);
+	entry->font_name = bstrdup(context->font_name);
+	entry->font_size = context->font_size;
+	entry->font_flags = context->font_flags;
+	entry->texrender = texrender;
+	entry->cx = cx;
+	entry->cy = cy;
+	entry->last_used = ++context->text_cache_clock;
+
+	da_push_back(context->text_cache, &entry);
+	context->text_cache_bytes += (uint64_t)cx * cy * 4;
+	match_counter_text_cache_trim(context, entry);
+	return entry;
+}
+
+// 勝敗数・フォーマット・フォントのいずれかが変わった場合のみテキストソースを更新する
+// 一度描画したテキストはキャッシュから描画するため、テキストソースの再レイアウトも起きない
+static void match_counter_source_refresh_text(struct MatchCounterSource *context)
+{
+	uint64_t generation = match_counter_get_generation(context->counter);
+
+	if (!context->text_dirty && !context->font_dirty && generation == context->rendered_generation)
+		return;
+
+	uint64_t format_start_ns = os_gettime_ns();
+	const char *formatted_text = match_counter_format_render(context->format, context->counter);
+	match_counter_stats_record(context->stats, MATCH_COUNTER_STAT_FORMAT, os_gettime_ns() - format_start_ns);
+	bool text_changed = !context->text || strcmp(context->text, formatted_text) != 0;
+
+	context->rendered_generation = generation;
+	context->text_dirty = false;
+
+	// 表示内容が同じならFreeTypeの再レイアウトを避ける（キャッシュを解放した後は作り直す）
+	if (!text_changed && !context->font_dirty && context->text_cache_current)
+		return;
+
+	if (text_changed) {
+		bfree(context->text);
+		context->text = bstrdup(formatted_text);
+	}
+
+	// フォントが変わったら古いフォントのテクスチャは使わない
+	if (context->font_dirty)
+		match_counter_text_cache_clear(context);
+
+	context->text_cache_current = NULL;
+
+	// テキストが空の場合はテキストソースを更新しない
+	if (!context->text || !strlen(context->text)) {
+		match_counter_source_set_extents(context, 0, 0);
+		return;
+	}
+
+	// 少し前に表示したテキスト（取り消した直後のスコアなど）はキャッシュから描画する
+	struct match_counter_text_cache_entry *entry = match_counter_text_cache_find(context, context->text);
+	match_counter_stats_record_cache(context->stats, entry != NULL);
+	if (entry) {
+		entry->last_used = ++context->text_cache_clock;
+		context->text_cache_current = entry;
+		match_counter_source_set_extents(context, entry->cx, entry->cy);
 		return;
 	}
 
-	// テキストを更新
-	if (context->text) {
+	// 共有の描画器にテキストを反映し、大きさを測る
+	uint64_t child_start_ns = os_gettime_ns();
+	uint32_t cx;
+	uint32_t cy;
+	match_counter_text_renderer_prepare(context->text_renderer, context->text, &cx, &cy);
+	match_counter_source_set_extents(context, cx, cy);
+	context->font_dirty = false;
+
+	// 描画器は他のソースと共有しているため、描画内容はキャッシュに写しておく
+	context->text_cache_current = match_counter_text_cache_insert(context);
+	match_counter_stats_record(context->stats, MATCH_COUNTER_STAT_CHILD_UPDATE, os_gettime_ns() - child_start_ns);
+
+	MATCH_COUNTER_TRACE(context, MATCH_COUNTER_TRACE_TEXT_UPDATE, strlen(context->text), context->cx, context->cy);
+}
+
+// UTF-8の1文字を読み取り、次の文字の位置を返す
+static const char *match_counter_utf8_next(const char *str, uint32_t *codepoint)
+{
+	const unsigned char *s = (const unsigned char *)str;
+	size_t len = 1;
+
+	if (s[0] < 0x80) {
+		*codepoint = s[0];
+	} else if ((s[0] & 0xE0) == 0xC0 && (s[1] & 0xC0) == 0x80) {
+		*codepoint = ((uint32_t)(s[0] & 0x1F) << 6) | (s[1] & 0x3F);
+		len = 2;
+	} else if ((s[0] & 0xF0) == 0xE0 && (s[1] & 0xC0) == 0x80 && (s[2] & 0xC0) == 0x80) {
+		*codepoint = ((uint32_t)(s[0] & 0x0F) << 12) | ((uint32_t)(s[1] & 0x3F) << 6) | (s[2] & 0x3F);
+		len = 3;
+	} else if ((s[0] & 0xF8) == 0xF0 && (s[1] & 0xC0) == 0x80 && (s[2] & 0xC0) == 0x80 && (s[3] & 0xC0) == 0x80) {
+		*codepoint = ((uint32_t)(s[0] & 0x07) << 18) | ((uint32_t)(s[1] & 0x3F) << 12) |
+			     ((uint32_t)(s[2] & 0x3F) << 6) | (s[3] & 0x3F);
+		len = 4;
+	} else {
+		// 不正なバイトは置換文字として扱う
+		*codepoint = 0xFFFD;
+	}
+
+	return str + len;
+}
+
+static const struct match_counter_glyph *match_counter_atlas_find(struct MatchCounterSource *context,
+								   uint32_t codepoint)
+{
+	if (codepoint < 128) {
+		int32_t idx = context->ascii_glyphs[codepoint];
+		return idx >= 0 ? &context->glyphs.array[idx] : NULL;
+	}
+
+	// ASCII以外はフォーマットのリテラルにしか現れないため数が少ない
+	for (size_t i = 0; i < context->glyphs.num; i++) {
+		if (context->glyphs.array[i].codepoint == codepoint)
+			return &context->glyphs.array[i];
+	}
+	return NULL;
+}
+
+static void match_counter_atlas_add_glyphs(struct MatchCounterSource *context, const char *text)
+{
+	while (*text) {
+		const char *start = text;
+		uint32_t codepoint;
+		text = match_counter_utf8_next(text, &codepoint);
+
+		if (codepoint == '\n' || codepoint == '\r' || match_counter_atlas_find(context, codepoint))
+			continue;
+
+		struct match_counter_glyph *glyph = da_push_back_new(context->glyphs);
+		glyph->codepoint = codepoint;
+		memcpy(glyph->utf8, start, (size_t)(text - start));
+
+		if (codepoint < 128)
+			context->ascii_glyphs[codepoint] = (int32_t)(context->glyphs.num - 1);
+	}
+}
+
+static bool match_counter_atlas_covers(struct MatchCounterSource *context, const char *text)
+{
+	while (*text) {
+		uint32_t codepoint;
+		text = match_counter_utf8_next(text, &codepoint);
+
+		if (codepoint != '\n' && codepoint != '\r' && !match_counter_atlas_find(context, codepoint))
+			return false;
+	}
+	return true;
+}
+
+// 合成用にアトラスをCPUへ読み戻す（フォントか文字の種類が変わったときだけ行う）
+static void match_counter_atlas_download(struct MatchCounterSource *context, uint32_t cx, uint32_t cy)
+{
+	gs_stagesurf_t *stagesurface = gs_stagesurface_create(cx, cy, GS_RGBA);
+	if (!stagesurface)
+		return;
+
+	gs_stage_texture(stagesurface, gs_texrender_get_texture(context->texrender));
+
+	uint8_t *pixels;
+	uint32_t linesize;
+	if (gs_stagesurface_map(stagesurface, &pixels, &linesize)) {
+		struct match_counter_compose_glyph *glyphs =
+			bmalloc(sizeof(struct match_counter_compose_glyph) * context->glyphs.num);
+		for (size_t i = 0; i < context->glyphs.num; i++) {
+			glyphs[i].x = context->glyphs.array[i].x;
+			glyphs[i].cx = context->glyphs.array[i].cx;
+			glyphs[i].cell_cx = context->glyphs.array[i].cx + MATCH_COUNTER_ATLAS_PADDING;
+		}
+
+		if (!context->composer)
+			context->composer = match_counter_composer_create();
+		match_counter_composer_set_atlas(context->composer, pixels, linesize, cx, cy, glyphs,
+						 context->glyphs.num);
+
+		bfree(glyphs);
+		gs_stagesurface_unmap(stagesurface);
+	}
+
+	gs_stagesurface_destroy(stagesurface);
+}
+
+// 数字・記号・フォーマットのリテラルをtexrenderに一度だけラスタライズする
+static bool match_counter_atlas_build(struct MatchCounterSource *context, const char *text)
+{
+	// フォントが変わった場合は作り直し、そうでなければ既存の文字に追加する
+	if (context->font_dirty) {
+		da_clear(context->glyphs);
+		for (size_t i = 0; i < 128; i++)
+			context->ascii_glyphs[i] = -1;
+	}
+	if (!context->glyphs.num)
+		match_counter_atlas_add_glyphs(context, MATCH_COUNTER_ATLAS_BASE_GLYPHS);
+	match_counter_atlas_add_glyphs(context, text);
+
+	context->atlas_valid = false;
+
+	// ラスタライズにだけ同じフォントの描画器を借りる
+	match_counter_text_renderer_t *rasterizer =
+		match_counter_text_pool_acquire(context->font_name, context->font_size, context->font_flags);
+	if (!rasterizer) {
+		blog(LOG_ERROR, "match_counter_atlas_build: Failed to acquire text renderer");
+		return false;
+	}
+
+	// 各文字の大きさを測る
+	uint32_t atlas_cx = 0;
+	uint32_t atlas_cy = 0;
+	for (size_t i = 0; i < context->glyphs.num; i++) {
+		struct match_counter_glyph *glyph = &context->glyphs.array[i];
+		uint32_t cy;
+		match_counter_text_renderer_prepare(rasterizer, glyph->utf8, &glyph->cx, &cy);
+
+		glyph->x = atlas_cx;
+		atlas_cx += glyph->cx + MATCH_COUNTER_ATLAS_PADDING;
+
+		if (cy > atlas_cy)
+			atlas_cy = cy;
+	}
+
+	if (!atlas_cx || !atlas_cy) {
+		match_counter_text_pool_release(rasterizer);
+		return false;
+	}
+
+	if (!context->texrender)
+		context->texrender = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+
+	gs_texrender_reset(context->texrender);
+	if (gs_texrender_begin(context->texrender, atlas_cx, atlas_cy)) {
+		struct vec4 clear_color;
+		vec4_zero(&clear_color);
+
+		gs_clear(GS_CLEAR_COLOR, &clear_color, 0.0f, 0);
+		gs_ortho(0.0f, (float)atlas_cx, 0.0f, (float)atlas_cy, -100.0f, 100.0f);
+
+		gs_blend_state_push();
+		gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
+
+		for (size_t i = 0; i < context->glyphs.num; i++) {
+			struct match_counter_glyph *glyph = &context->glyphs.array[i];
+			uint32_t cx;
+			uint32_t cy;
+			match_counter_text_renderer_prepare(rasterizer, glyph->utf8, &cx, &cy);
+
+			gs_matrix_push();
+			gs_matrix_translate3f((float)glyph->x, 0.0f, 0.0f);
+			match_counter_text_renderer_render(rasterizer);
+			gs_matrix_pop();
+		}
+
+		gs_blend_state_pop();
+		gs_texrender_end(context->texrender);
+
+		context->atlas_cy = atlas_cy;
+		context->atlas_valid = true;
+		match_counter_atlas_download(context, atlas_cx, atlas_cy);
+	}
+
+	match_counter_text_pool_release(rasterizer);
+
+	MATCH_COUNTER_TRACE(context, MATCH_COUNTER_TRACE_ATLAS_BUILD, context->glyphs.num, atlas_cx, atlas_cy);
+	return context->atlas_valid;
+}
+
+static void match_counter_atlas_refresh_text(struct MatchCounterSource *context)
+{
+	uint64_t generation = match_counter_get_generation(context->counter);
+
+	if (!context->text_dirty && !context->font_dirty && generation == context->rendered_generation)
+		return;
+
+	uint64_t format_start_ns = os_gettime_ns();
+	const char *formatted_text = match_counter_format_render(context->format, context->counter);
+	match_counter_stats_record(context->stats, MATCH_COUNTER_STAT_FORMAT, os_gettime_ns() - format_start_ns);
+	if (!context->text || strcmp(context->text, formatted_text) != 0) {
 		bfree(context->text);
+		context->text = bstrdup(formatted_text);
 	}
-	context->text = bstrdup(formatted_text);
 
-	blog(LOG_DEBUG, "match_counter_source_render: Rendering text '%s'", formatted_text);
+	context->rendered_generation = generation;
+	context->text_dirty = false;
+
+	// フォーマットのリテラルに新しい文字が増えた場合だけラスタライズし直す
+	if (context->font_dirty || !context->atlas_valid || !match_counter_atlas_covers(context, context->text)) {
+		uint64_t child_start_ns = os_gettime_ns();
+		match_counter_atlas_build(context, context->text);
+		context->font_dirty = false;
+		match_counter_stats_record(context->stats, MATCH_COUNTER_STAT_CHILD_UPDATE,
+					   os_gettime_ns() - child_start_ns);
+	}
 
-	// テキストソースの設定を更新
-	obs_data_t *settings = obs_data_create();
-	obs_data_set_string(settings, "text", formatted_text);
+	// 最も長い行の文字幅の合計を幅、行数分のアトラスの高さを高さとし、並べる文字をワーカーに渡す
+	// 改行はテキストソースと同じく次の行に移り、\r\nの\rは無視する
+	uint32_t cx = 0;
+	uint32_t row_cx = 0;
+	uint32_t rows = 1;
+	da_resize(context->compose_indices, 0);
+	for (const char *p = context->text; *p;) {
+		uint32_t codepoint;
+		p = match_counter_utf8_next(p, &codepoint);
+
+		if (codepoint == '\n') {
+			uint32_t index = MATCH_COUNTER_COMPOSE_NEWLINE;
+			da_push_back(context->compose_indices, &index);
+			row_cx = 0;
+			rows++;
+			continue;
+		}
 
-	// フォント設定
-	obs_data_t *font_obj = obs_data_create();
-	obs_data_set_string(font_obj, "face", context->font_name);
-	obs_data_set_int(font_obj, "size", context->font_size);
-	obs_data_set_int(font_obj, "flags", context->font_flags);
-	obs_data_set_obj(settings, "font", font_obj);
-	obs_data_release(font_obj);
+		const struct match_counter_glyph *glyph = match_counter_atlas_find(context, codepoint);
+		if (glyph) {
+			uint32_t index = (uint32_t)(glyph - context->glyphs.array);
+			da_push_back(context->compose_indices, &index);
+			row_cx += glyph->cx;
+			if (row_cx > cx)
+				cx = row_cx;
+		}
+	}
+	match_counter_source_set_extents(context, cx, context->atlas_cy * rows);
+
+	if (context->composer)
+		match_counter_composer_request(context->composer, context->compose_indices.array,
+					       context->compose_indices.num);
+}
+
+// アトラスから1文字ずつ切り出して描画する
+static void match_counter_atlas_render(struct MatchCounterSource *context)
+{
+	if (!context->atlas_valid || !context->text || !strlen(context->text))
+		return;
+
+	gs_effect_t *effect = obs_get_base_effect(OBS_EFFECT_DEFAULT);
+
+	// ワーカーが合成したテクスチャがあれば1回で描画する（新しい合成が終わるまでは前のものを描画する）
+	uint32_t composed_cx;
+	uint32_t composed_cy;
+	gs_texture_t *composed = NULL;
+	if (context->composer)
+		composed = match_counter_composer_get_texture(context->composer, &composed_cx, &composed_cy);
+	if (composed) {
+		gs_blend_state_push();
+		gs_blend_function(GS_BLEND_ONE, GS_BLEND_INVSRCALPHA);
+		gs_effect_set_texture(gs_effect_get_param_by_name(effect, "image"), composed);
+		while (gs_effect_loop(effect, "Draw"))
+			gs_draw_sprite(composed, 0, composed_cx, composed_cy);
+		gs_blend_state_pop();
+		return;
+	}
+
+	gs_texture_t *tex = gs_texrender_get_texture(context->texrender);
+	if (!tex)
+		return;
+
+	gs_eparam_t *image = gs_effect_get_param_by_name(effect, "image");
+	gs_effect_set_texture(image, tex);
+
+	while (gs_effect_loop(effect, "Draw")) {
+		uint32_t x = 0;
+		uint32_t y = 0;
+		for (const char *p = context->text; *p;) {
+			uint32_t codepoint;
+			p = match_counter_utf8_next(p, &codepoint);
 
-	blog(LOG_DEBUG, "match_counter_source_render: Updating text source settings");
-	obs_source_update(context->text_source, settings);
-	blog(LOG_DEBUG, "match_counter_source_render: Text source settings updated");
+			if (codepoint == '\n') {
+				x = 0;
+				y += context->atlas_cy;
+				continue;
+			}
 
-	// テキストソースのサイズを取得
-	context->cx = obs_source_get_width(context->text_source);
-	context->cy = obs_source_get_height(context->text_source);
+			const struct match_counter_glyph *glyph = match_counter_atlas_find(context, codepoint);
+			if (!glyph)
+				continue;
 
-	blog(LOG_DEBUG, "match_counter_source_render: Text dimensions - width=%d, height=%d", context->cx, context->cy);
+			gs_matrix_push();
+			gs_matrix_translate3f((float)x, (float)y, 0.0f);
+			gs_draw_sprite_subregion(tex, 0, glyph->x, 0, glyph->cx, context->atlas_cy);
+			gs_matrix_pop();
+
+			x += glyph->cx;
+		}
+	}
+}
+
+// テキストかフォントが変わったときだけ表示内容と大きさを測り直す
+// tickで描画より先に行うため、表示された最初のフレームからシーンアイテムの大きさが確定する
+static void match_counter_source_refresh_extents(struct MatchCounterSource *context)
+{
+	// 表示されていないソースにはリソースを作らない（表示されたときに測り直す）
+	if (!obs_source_showing(context->source))
+		return;
+
+	// 何も変わっていないフレームではグラフィックスコンテキストに入らない
+	if (!context->text_dirty && !context->font_dirty &&
+	    match_counter_get_generation(context->counter) == context->rendered_generation)
+		return;
 
-	// テキストソースをレンダリング
-	blog(LOG_DEBUG, "Entering graphics context");
 	obs_enter_graphics();
-	blog(LOG_DEBUG, "Rendering text source");
-	obs_source_video_render(context->text_source);
+
+	if (context->render_mode == MATCH_COUNTER_RENDER_GLYPH_ATLAS)
+		match_counter_atlas_refresh_text(context);
+	else if (match_counter_source_ensure_text_renderer(context))
+		match_counter_source_refresh_text(context);
+
 	obs_leave_graphics();
-	blog(LOG_DEBUG, "Leaving graphics context");
+}
 
-	// リソースの解放
-	obs_data_release(settings);
-	bfree((void *)formatted_text);
+static void match_counter_source_draw(struct MatchCounterSource *context)
+{
+	if (context->render_mode == MATCH_COUNTER_RENDER_GLYPH_ATLAS) {
+		match_counter_atlas_render(context);
+		return;
+	}
+
+	// テキストが空の場合はスキップ
+	if (!context->text_renderer || !context->text || !strlen(context->text))
+		return;
+
+	// キャッシュしたテクスチャを描画する
+	struct match_counter_text_cache_entry *entry = context->text_cache_current;
+	gs_texture_t *tex = entry ? gs_texrender_get_texture(entry->texrender) : NULL;
+	if (tex) {
+		gs_effect_t *default_effect = obs_get_base_effect(OBS_EFFECT_DEFAULT);
+		gs_effect_set_texture(gs_effect_get_param_by_name(default_effect, "image"), tex);
+		while (gs_effect_loop(default_effect, "Draw"))
+			gs_draw_sprite(tex, 0, entry->cx, entry->cy);
+		return;
+	}
+
+	// キャッシュできなかった場合は共有の描画器にこのソースのテキストを反映して直接描画する
+	uint32_t cx;
+	uint32_t cy;
+	if (match_counter_text_renderer_prepare(context->text_renderer, context->text, &cx, &cy))
+		match_counter_text_renderer_render(context->text_renderer);
 }
 
-static uint32_t match_counter_source_get_width(void *data)
+static void match_counter_source_render(void *data, gs_effect_t *effect)
 {
+	UNUSED_PARAMETER(effect);
 	struct MatchCounterSource *context = data;
 
-	// テクスチャのサイズを返す
-	if (context->cx > 0) {
-		return context->cx;
-	}
+	uint64_t start_ns = os_gettime_ns();
+	match_counter_source_draw(context);
+	match_counter_stats_record(context->stats, MATCH_COUNTER_STAT_RENDER, os_gettime_ns() - start_ns);
+}
+
+static void match_counter_source_show(void *data)
+{
+	struct MatchCounterSource *context = data;
 
-	// テクスチャがまだ作成されていない場合は簡易計算
-	const char *text = match_counter_get_formatted_text(context->counter);
+	// 非表示の間の変化は反映していないため、次のtickで測り直す
+	context->text_dirty = true;
+}
 
-	if (!text || !strlen(text)) {
-		return 0;
-	}
+static uint32_t match_counter_source_get_width(void *data)
+{
+	struct MatchCounterSource *context = data;
 
-	uint32_t width = (uint32_t)strlen(text) * 10; // 文字幅の簡易計算
-	bfree((void *)text);
-	return width;
+	// video_tickで測った大きさを返す
+	return (uint32_t)(match_counter_atomic_load_u64(&context->extents) >> 32);
 }
 
 static uint32_t match_counter_source_get_height(void *data)
 {
 	struct MatchCounterSource *context = data;
 
-	// テクスチャのサイズを返す
-	if (context->cy > 0) {
-		return context->cy;
-	}
+	return (uint32_t)match_counter_atomic_load_u64(&context->extents);
+}
 
-	// テクスチャがまだ作成されていない場合は固定値
-	return context->font_size > 0 ? context->font_size : 256;
+static bool match_counter_source_log_stats_clicked(obs_properties_t *props, obs_property_t *property, void *data)
+{
+	UNUSED_PARAMETER(props);
+	UNUSED_PARAMETER(property);
+	struct MatchCounterSource *context = data;
+	match_counter_stats_log(context->stats, obs_source_get_name(context->source));
+	return false;
 }
 
 static obs_properties_t *match_counter_source_get_properties(void *data, void *type_data)
@@ -358,13 +1559,66 @@ static obs_properties_t *match_counter_source_get_properties(void *data, void *t
 	obs_properties_add_text(props, "format", obs_module_text("Format"), OBS_TEXT_MULTILINE);
 	obs_property_set_long_description(obs_properties_get(props, "format"), obs_module_text("FormatTooltip"));
 
+	// 共有カウンターのID（同じIDのソースは勝敗数を共有する）
+	obs_properties_add_text(props, "counter_id", obs_module_text("CounterId"), OBS_TEXT_DEFAULT);
+	obs_property_set_long_description(obs_properties_get(props, "counter_id"), obs_module_text("CounterIdTooltip"));
+
 	// 勝敗数設定
 	obs_properties_add_int(props, "wins", obs_module_text("Wins"), 0, INT_MAX, 1);
 	obs_properties_add_int(props, "losses", obs_module_text("Losses"), 0, INT_MAX, 1);
 
+	// 対戦カードごとの記録（%k, %kw, %kl, %kt, %kr）
+	obs_properties_add_text(props, "matchup_key", obs_module_text("MatchupKey"), OBS_TEXT_DEFAULT);
+	obs_property_set_long_description(obs_properties_get(props, "matchup_key"),
+					  obs_module_text("MatchupKeyTooltip"));
+	obs_properties_add_editable_list(props, "matchup_keys", obs_module_text("MatchupKeys"),
+					 OBS_EDITABLE_LIST_TYPE_STRINGS, NULL, NULL);
+
+	// 外部ツールが書き出す勝敗数のファイル
+	obs_properties_add_path(props, "score_file", obs_module_text("ScoreFile"), OBS_PATH_FILE,
+				"Text/JSON (*.txt *.json);;All Files (*.*)", NULL);
+	obs_property_set_long_description(obs_properties_get(props, "score_file"), obs_module_text("ScoreFileTooltip"));
+
+	// 直近N試合の集計（%W, %n, %R）
+	obs_properties_add_int(props, "history_window", obs_module_text("HistoryWindow"), 1,
+			       MATCH_COUNTER_HISTORY_MAX_WINDOW, 1);
+
 	// テキストスタイル設定
 	obs_properties_add_font(props, "font", obs_module_text("Font"));
 
+	// 描画方式
+	obs_property_t *render_mode = obs_properties_add_list(props, "render_mode", obs_module_text("RenderMode"),
+							      OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
+	obs_property_list_add_int(render_mode, obs_module_text("RenderMode.TextSource"),
+				  MATCH_COUNTER_RENDER_TEXT_SOURCE);
+	obs_property_list_add_int(render_mode, obs_module_text("RenderMode.GlyphAtlas"),
+				  MATCH_COUNTER_RENDER_GLYPH_ATLAS);
+	obs_property_set_long_description(render_mode, obs_module_text("RenderModeTooltip"));
+
+	// 非表示のソースのGPUリソースを解放するまでの時間
+	obs_property_t *release_delay =
+		obs_properties_add_int(props, "release_delay", obs_module_text("ReleaseDelay"), 0, 3600, 1);
+	obs_property_int_set_suffix(release_delay, " s");
+	obs_property_set_long_description(release_delay, obs_module_text("ReleaseDelayTooltip"));
+
+	// 勝敗の操作の書き出し
+	obs_property_t *export_format = obs_properties_add_list(props, "export_format", obs_module_text("ExportFormat"),
+								 OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
+	obs_property_list_add_int(export_format, obs_module_text("ExportFormat.None"), MATCH_COUNTER_EXPORT_NONE);
+	obs_property_list_add_int(export_format, obs_module_text("ExportFormat.CSV"), MATCH_COUNTER_EXPORT_CSV);
+	obs_property_list_add_int(export_format, obs_module_text("ExportFormat.NDJSON"), MATCH_COUNTER_EXPORT_NDJSON);
+	obs_property_set_long_description(export_format, obs_module_text("ExportFormatTooltip"));
+	obs_properties_add_path(props, "export_path", obs_module_text("ExportPath"), OBS_PATH_FILE_SAVE,
+				"CSV (*.csv);;NDJSON (*.ndjson *.jsonl);;All Files (*.*)", NULL);
+	obs_property_t *export_max_size =
+		obs_properties_add_int(props, "export_max_size", obs_module_text("ExportMaxSize"), 1, 1024, 1);
+	obs_property_int_set_suffix(export_max_size, " MiB");
+	obs_properties_add_int(props, "export_max_files", obs_module_text("ExportMaxFiles"), 0, 100, 1);
+
+	// 処理時間の統計をログに出力する
+	obs_properties_add_button(props, "log_stats", obs_module_text("LogStats"),
+				  match_counter_source_log_stats_clicked);
+
 	return props;
 }
 
@@ -373,6 +1627,7 @@ static void match_counter_source_get_defaults(void *type_data, obs_data_t *setti
 	UNUSED_PARAMETER(type_data);
 	// カウンター設定のデフォルト値
 	obs_data_set_default_string(settings, "format", "%w-%l(%r)");
+	obs_data_set_default_int(settings, "history_window", MATCH_COUNTER_HISTORY_DEFAULT_WINDOW);
 
 	// フォント設定のデフォルト値
 	obs_data_t *font_obj = obs_data_create();
@@ -381,12 +1636,20 @@ static void match_counter_source_get_defaults(void *type_data, obs_data_t *setti
 	obs_data_set_int(font_obj, "flags", 0);
 	obs_data_set_default_obj(settings, "font", font_obj);
 	obs_data_release(font_obj);
+
+	obs_data_set_default_int(settings, "render_mode", MATCH_COUNTER_RENDER_TEXT_SOURCE);
+	obs_data_set_default_int(settings, "release_delay", MATCH_COUNTER_DEFAULT_RELEASE_DELAY);
+
+	// 書き出しのデフォルト値
+	obs_data_set_default_int(settings, "export_format", MATCH_COUNTER_EXPORT_NONE);
+	obs_data_set_default_int(settings, "export_max_size", MATCH_COUNTER_DEFAULT_EXPORT_MAX_SIZE);
+	obs_data_set_default_int(settings, "export_max_files", MATCH_COUNTER_DEFAULT_EXPORT_MAX_FILES);
 }
 
 static const char *match_counter_source_get_text(void *data)
 {
 	struct MatchCounterSource *context = data;
-	return match_counter_get_formatted_text(context->counter);
+	return match_counter_format_render_copy(context->format, context->counter);
 }
 
 struct obs_source_info match_counter_source_info = {.id = "match_counter_source",
@@ -402,4 +1665,6 @@ struct obs_source_info match_counter_source_info = {.id = "match_counter_source"
 						    .get_defaults2 = match_counter_source_get_defaults,
 						    .get_width = match_counter_source_get_width,
 						    .get_height = match_counter_source_get_height,
+						    .video_tick = match_counter_source_video_tick,
+						    .show = match_counter_source_show,
 						    .video_render = match_counter_source_render};
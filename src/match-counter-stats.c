@@ -0,0 +1,246 @@
+/*
+Match Counter for OBS
+Copyright (C) 2025 Yudai Udagawa
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include "match-counter-stats.h"
+#include "match-counter-atomic.h"
+
+struct stat_histogram {
+	volatile uint64_t buckets[MATCH_COUNTER_STATS_BUCKETS];
+	volatile uint64_t total_ns;
+	volatile uint64_t max_ns;
+};
+
+struct match_counter_stats {
+	struct stat_histogram histograms[MATCH_COUNTER_STAT_COUNT];
+
+	// テキストキャッシュ
+	volatile uint64_t cache_hits;
+	volatile uint64_t cache_misses;
+	volatile uint64_t cache_entries;
+	volatile uint64_t cache_bytes;
+};
+
+static const char *stat_names[MATCH_COUNTER_STAT_COUNT] = {
+	"render",
+	"update",
+	"format",
+	"child_update",
+};
+
+static unsigned int highest_bit(uint64_t val)
+{
+	unsigned int bit = 0;
+
+	for (unsigned int shift = 32; shift; shift >>= 1) {
+		if (val >> shift) {
+			val >>= shift;
+			bit += shift;
+		}
+	}
+	return bit;
+}
+
+// 4未満はそのまま、それ以上は最上位ビットごとに次の2ビットで4分割する
+static size_t bucket_index(uint64_t ns)
+{
+	if (ns < 4)
+		return (size_t)ns;
+
+	unsigned int bit = highest_bit(ns);
+	size_t index = (size_t)(bit - 1) * 4 + (size_t)((ns >> (bit - 2)) & 3);
+	return index < MATCH_COUNTER_STATS_BUCKETS ? index : MATCH_COUNTER_STATS_BUCKETS - 1;
+}
+
+static uint64_t bucket_upper_bound(size_t index)
+{
+	if (index < 4)
+		return index;
+
+	unsigned int bit = (unsigned int)(index / 4) + 1;
+	uint64_t sub = index % 4;
+	return ((5 + sub) << (bit - 2)) - 1;
+}
+
+match_counter_stats_t *match_counter_stats_create(void)
+{
+	return bzalloc(sizeof(match_counter_stats_t));
+}
+
+void match_counter_stats_destroy(match_counter_stats_t *stats)
+{
+	bfree(stats);
+}
+
+void match_counter_stats_record(match_counter_stats_t *stats, enum match_counter_stat stat, uint64_t ns)
+{
+	if (!stats || stat >= MATCH_COUNTER_STAT_COUNT)
+		return;
+
+	struct stat_histogram *histogram = &stats->histograms[stat];
+	match_counter_atomic_inc_u64(&histogram->buckets[bucket_index(ns)]);
+	match_counter_atomic_add_u64(&histogram->total_ns, ns);
+
+	uint64_t max = match_counter_atomic_load_u64(&histogram->max_ns);
+	while (ns > max && !match_counter_atomic_compare_exchange_u64(&histogram->max_ns, &max, ns))
+		;
+}
+
+void match_counter_stats_reset(match_counter_stats_t *stats)
+{
+	if (!stats)
+		return;
+
+	for (size_t i = 0; i < MATCH_COUNTER_STAT_COUNT; i++) {
+		struct stat_histogram *histogram = &stats->histograms[i];
+		for (size_t j = 0; j < MATCH_COUNTER_STATS_BUCKETS; j++)
+			match_counter_atomic_store_u64(&histogram->buckets[j], 0);
+		match_counter_atomic_store_u64(&histogram->total_ns, 0);
+		match_counter_atomic_store_u64(&histogram->max_ns, 0);
+	}
+
+	// 使用量は現在の状態なので消さない
+	match_counter_atomic_store_u64(&stats->cache_hits, 0);
+	match_counter_atomic_store_u64(&stats->cache_misses, 0);
+}
+
+void match_counter_stats_record_cache(match_counter_stats_t *stats, bool hit)
+{
+	if (!stats)
+		return;
+
+	match_counter_atomic_inc_u64(hit ? &stats->cache_hits : &stats->cache_misses);
+}
+
+void match_counter_stats_set_cache_usage(match_counter_stats_t *stats, uint64_t entries, uint64_t bytes)
+{
+	if (!stats)
+		return;
+
+	match_counter_atomic_store_u64(&stats->cache_entries, entries);
+	match_counter_atomic_store_u64(&stats->cache_bytes, bytes);
+}
+
+void match_counter_stats_get_cache(match_counter_stats_t *stats, struct match_counter_cache_summary *summary)
+{
+	memset(summary, 0, sizeof(*summary));
+	if (!stats)
+		return;
+
+	summary->hits = match_counter_atomic_load_u64(&stats->cache_hits);
+	summary->misses = match_counter_atomic_load_u64(&stats->cache_misses);
+	summary->entries = match_counter_atomic_load_u64(&stats->cache_entries);
+	summary->bytes = match_counter_atomic_load_u64(&stats->cache_bytes);
+}
+
+static double cache_hit_rate(const struct match_counter_cache_summary *summary)
+{
+	uint64_t lookups = summary->hits + summary->misses;
+	return lookups ? (double)summary->hits / (double)lookups : 0.0;
+}
+
+// 累積件数がrankに達したバケットの上限値を返す
+static uint64_t percentile(const uint64_t *buckets, uint64_t count, uint64_t max_ns, uint32_t permille)
+{
+	if (!count)
+		return 0;
+
+	uint64_t rank = (count * permille + 999) / 1000;
+	uint64_t seen = 0;
+
+	for (size_t i = 0; i < MATCH_COUNTER_STATS_BUCKETS; i++) {
+		seen += buckets[i];
+		if (seen >= rank) {
+			uint64_t bound = bucket_upper_bound(i);
+			return bound < max_ns ? bound : max_ns;
+		}
+	}
+	return max_ns;
+}
+
+void match_counter_stats_get(match_counter_stats_t *stats, enum match_counter_stat stat,
+			     struct match_counter_stat_summary *summary)
+{
+	memset(summary, 0, sizeof(*summary));
+	if (!stats || stat >= MATCH_COUNTER_STAT_COUNT)
+		return;
+
+	// 記録中でも読めるよう、バケットの合計を件数として使う
+	struct stat_histogram *histogram = &stats->histograms[stat];
+	uint64_t buckets[MATCH_COUNTER_STATS_BUCKETS];
+	for (size_t i = 0; i < MATCH_COUNTER_STATS_BUCKETS; i++) {
+		buckets[i] = match_counter_atomic_load_u64(&histogram->buckets[i]);
+		summary->count += buckets[i];
+	}
+
+	summary->total_ns = match_counter_atomic_load_u64(&histogram->total_ns);
+	summary->max_ns = match_counter_atomic_load_u64(&histogram->max_ns);
+	summary->p50_ns = percentile(buckets, summary->count, summary->max_ns, 500);
+	summary->p99_ns = percentile(buckets, summary->count, summary->max_ns, 990);
+}
+
+const char *match_counter_stats_name(enum match_counter_stat stat)
+{
+	return stat < MATCH_COUNTER_STAT_COUNT ? stat_names[stat] : "";
+}
+
+void match_counter_stats_to_json(match_counter_stats_t *stats, struct dstr *out)
+{
+	dstr_copy(out, "{");
+
+	for (size_t i = 0; i < MATCH_COUNTER_STAT_COUNT; i++) {
+		struct match_counter_stat_summary summary;
+		match_counter_stats_get(stats, (enum match_counter_stat)i, &summary);
+
+		dstr_catf(out,
+			  "%s\"%s\":{\"count\":%llu,\"total_ns\":%llu,\"p50_ns\":%llu,\"p99_ns\":%llu,\"max_ns\":%llu}",
+			  i ? "," : "", stat_names[i], (unsigned long long)summary.count,
+			  (unsigned long long)summary.total_ns, (unsigned long long)summary.p50_ns,
+			  (unsigned long long)summary.p99_ns, (unsigned long long)summary.max_ns);
+	}
+
+	struct match_counter_cache_summary cache;
+	match_counter_stats_get_cache(stats, &cache);
+	dstr_catf(out,
+		  ",\"text_cache\":{\"hits\":%llu,\"misses\":%llu,\"hit_rate\":%.4f,\"entries\":%llu,"
+		  "\"bytes\":%llu}}",
+		  (unsigned long long)cache.hits, (unsigned long long)cache.misses, cache_hit_rate(&cache),
+		  (unsigned long long)cache.entries, (unsigned long long)cache.bytes);
+}
+
+void match_counter_stats_log(match_counter_stats_t *stats, const char *name)
+{
+	for (size_t i = 0; i < MATCH_COUNTER_STAT_COUNT; i++) {
+		struct match_counter_stat_summary summary;
+		match_counter_stats_get(stats, (enum match_counter_stat)i, &summary);
+
+		blog(LOG_INFO,
+		     "match_counter_stats: [%s] %-12s count=%llu total=%.3fms avg=%.2fus p50=%.2fus p99=%.2fus "
+		     "max=%.2fus",
+		     name ? name : "", stat_names[i], (unsigned long long)summary.count, summary.total_ns / 1e6,
+		     summary.count ? summary.total_ns / 1e3 / summary.count : 0.0, summary.p50_ns / 1e3,
+		     summary.p99_ns / 1e3, summary.max_ns / 1e3);
+	}
+
+	struct match_counter_cache_summary cache;
+	match_counter_stats_get_cache(stats, &cache);
+	blog(LOG_INFO,
+	     "match_counter_stats: [%s] text_cache   hits=%llu misses=%llu hit_rate=%.1f%% entries=%llu "
+	     "bytes=%llu",
+	     name ? name : "", (unsigned long long)cache.hits, (unsigned long long)cache.misses,
+	     cache_hit_rate(&cache) * 100.0, (unsigned long long)cache.entries, (unsigned long long)cache.bytes);
+}
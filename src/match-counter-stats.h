@@ -0,0 +1,152 @@
+/*
+Match Counter for OBS
+Copyright (C) 2025 Yudai Udagawa
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include <obs-module.h>
+#include <util/dstr.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * 計測する処理の種類
+ */
+enum match_counter_stat {
+	MATCH_COUNTER_STAT_RENDER,       // video_render全体
+	MATCH_COUNTER_STAT_UPDATE,       // ソースのupdate全体
+	MATCH_COUNTER_STAT_FORMAT,       // 表示テキストのフォーマット
+	MATCH_COUNTER_STAT_CHILD_UPDATE, // テキストソースの更新・アトラスのラスタライズ
+	MATCH_COUNTER_STAT_COUNT,
+};
+
+// ヒストグラムのバケット数（2のべき乗ごとに4分割、約34秒まで）
+#define MATCH_COUNTER_STATS_BUCKETS 140
+
+/**
+ * 1種類の処理の集計結果
+ *
+ * パーセンタイルはバケットの上限値のため、最大で約25%大きめの値になる
+ */
+struct match_counter_stat_summary {
+	uint64_t count;
+	uint64_t total_ns;
+	uint64_t max_ns;
+	uint64_t p50_ns;
+	uint64_t p99_ns;
+};
+
+/**
+ * 描画済みテキストのキャッシュの集計結果
+ */
+struct match_counter_cache_summary {
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t entries; // 現在のエントリ数
+	uint64_t bytes;   // 現在のテクスチャの合計サイズ
+};
+
+/**
+ * ソースごとの処理時間の統計
+ *
+ * 記録は固定バケットのヒストグラムへの加算だけで行い、メモリ確保や文字列の整形はしない
+ */
+typedef struct match_counter_stats match_counter_stats_t;
+
+/**
+ * 統計を作成する
+ * @return 統計
+ */
+match_counter_stats_t *match_counter_stats_create(void);
+
+/**
+ * 統計を破棄する
+ * @param stats 統計
+ */
+void match_counter_stats_destroy(match_counter_stats_t *stats);
+
+/**
+ * 処理時間を1件記録する
+ * @param stats 統計
+ * @param stat 処理の種類
+ * @param ns 処理時間（ナノ秒）
+ */
+void match_counter_stats_record(match_counter_stats_t *stats, enum match_counter_stat stat, uint64_t ns);
+
+/**
+ * 記録をすべて消去する
+ * @param stats 統計
+ */
+void match_counter_stats_reset(match_counter_stats_t *stats);
+
+/**
+ * 集計結果を取得する
+ * @param stats 統計
+ * @param stat 処理の種類
+ * @param summary 集計結果の格納先
+ */
+void match_counter_stats_get(match_counter_stats_t *stats, enum match_counter_stat stat,
+			     struct match_counter_stat_summary *summary);
+
+/**
+ * テキストキャッシュの参照結果を1件記録する
+ * @param stats 統計
+ * @param hit キャッシュにあった場合はtrue
+ */
+void match_counter_stats_record_cache(match_counter_stats_t *stats, bool hit);
+
+/**
+ * テキストキャッシュの現在の使用量を記録する
+ * @param stats 統計
+ * @param entries エントリ数
+ * @param bytes テクスチャの合計サイズ
+ */
+void match_counter_stats_set_cache_usage(match_counter_stats_t *stats, uint64_t entries, uint64_t bytes);
+
+/**
+ * テキストキャッシュの集計結果を取得する
+ * @param stats 統計
+ * @param summary 集計結果の格納先
+ */
+void match_counter_stats_get_cache(match_counter_stats_t *stats, struct match_counter_cache_summary *summary);
+
+/**
+ * 処理の種類の名前を取得する
+ * @param stat 処理の種類
+ * @return 名前（"render"など）
+ */
+const char *match_counter_stats_name(enum match_counter_stat stat);
+
+/**
+ * すべての集計結果をJSONとして書き出す
+ * @param stats 統計
+ * @param out 書き出し先
+ */
+void match_counter_stats_to_json(match_counter_stats_t *stats, struct dstr *out);
+
+/**
+ * すべての集計結果をログに出力する
+ * @param stats 統計
+ * @param name ログに含めるソース名
+ */
+void match_counter_stats_log(match_counter_stats_t *stats, const char *name);
+
+#ifdef __cplusplus
+}
+#endif
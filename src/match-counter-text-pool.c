@@ -0,0 +1,168 @@
+/*
+Match Counter for OBS
+Copyright (C) 2025 Yudai Udagawa
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include "match-counter-text-pool.h"
+#include <util/darray.h>
+#include <util/threading.h>
+
+struct match_counter_text_renderer {
+	// キー
+	char *face;
+	uint16_t size;
+	uint32_t flags;
+
+	size_t refs; // pool_mutexで保護する
+	obs_source_t *source;
+
+	// 最後に反映したテキスト（描画スレッドからのみ触る）
+	char *text;
+	uint32_t cx;
+	uint32_t cy;
+};
+
+// 使われているフォントの種類は少ないため、配列を線形に探索する
+static pthread_mutex_t pool_mutex;
+static DARRAY(match_counter_text_renderer_t *) pool_renderers;
+
+static obs_source_t *text_pool_create_source(void)
+{
+#ifdef _WIN32
+	return obs_source_create_private("text_gdiplus", "match_counter_text", NULL);
+#else
+	return obs_source_create_private("text_ft2_source", "match_counter_text", NULL);
+#endif
+}
+
+static void text_pool_destroy_renderer(match_counter_text_renderer_t *renderer)
+{
+	obs_source_release(renderer->source);
+	bfree(renderer->face);
+	bfree(renderer->text);
+	bfree(renderer);
+}
+
+void match_counter_text_pool_init(void)
+{
+	pthread_mutex_init(&pool_mutex, NULL);
+	da_init(pool_renderers);
+}
+
+void match_counter_text_pool_free(void)
+{
+	// ソースはモジュールの解放前にすべて破棄されているはず
+	if (pool_renderers.num)
+		blog(LOG_WARNING, "match_counter_text_pool: %zu text renderers still referenced", pool_renderers.num);
+
+	for (size_t i = 0; i < pool_renderers.num; i++)
+		text_pool_destroy_renderer(pool_renderers.array[i]);
+
+	da_free(pool_renderers);
+	pthread_mutex_destroy(&pool_mutex);
+}
+
+match_counter_text_renderer_t *match_counter_text_pool_acquire(const char *face, uint16_t size, uint32_t flags)
+{
+	if (!face)
+		face = "";
+
+	pthread_mutex_lock(&pool_mutex);
+
+	for (size_t i = 0; i < pool_renderers.num; i++) {
+		match_counter_text_renderer_t *renderer = pool_renderers.array[i];
+		if (renderer->size == size && renderer->flags == flags && strcmp(renderer->face, face) == 0) {
+			renderer->refs++;
+			pthread_mutex_unlock(&pool_mutex);
+			return renderer;
+		}
+	}
+
+	obs_source_t *source = text_pool_create_source();
+	if (!source) {
+		pthread_mutex_unlock(&pool_mutex);
+		blog(LOG_ERROR, "match_counter_text_pool_acquire: Failed to create text source");
+		return NULL;
+	}
+
+	// フォントは作成時に一度だけ設定し、以降はテキストだけを差し替える
+	obs_data_t *settings = obs_data_create();
+	obs_data_t *font_obj = obs_data_create();
+	obs_data_set_string(font_obj, "face", face);
+	obs_data_set_int(font_obj, "size", size);
+	obs_data_set_int(font_obj, "flags", flags);
+	obs_data_set_obj(settings, "font", font_obj);
+	obs_data_release(font_obj);
+	obs_source_update(source, settings);
+	obs_data_release(settings);
+
+	match_counter_text_renderer_t *renderer = bzalloc(sizeof(match_counter_text_renderer_t));
+	renderer->face = bstrdup(face);
+	renderer->size = size;
+	renderer->flags = flags;
+	renderer->refs = 1;
+	renderer->source = source;
+	da_push_back(pool_renderers, &renderer);
+
+	pthread_mutex_unlock(&pool_mutex);
+
+	blog(LOG_DEBUG, "match_counter_text_pool_acquire: Created text renderer for '%s' %u (flags=%u)", face, size,
+	     flags);
+	return renderer;
+}
+
+void match_counter_text_pool_release(match_counter_text_renderer_t *renderer)
+{
+	if (!renderer)
+		return;
+
+	pthread_mutex_lock(&pool_mutex);
+	bool last = --renderer->refs == 0;
+	if (last)
+		da_erase_item(pool_renderers, &renderer);
+	pthread_mutex_unlock(&pool_mutex);
+
+	if (last)
+		text_pool_destroy_renderer(renderer);
+}
+
+bool match_counter_text_renderer_prepare(match_counter_text_renderer_t *renderer, const char *text, uint32_t *cx,
+					 uint32_t *cy)
+{
+	if (!renderer->text || strcmp(renderer->text, text) != 0) {
+		obs_data_t *settings = obs_data_create();
+		obs_data_set_string(settings, "text", text);
+		obs_source_update(renderer->source, settings);
+		obs_data_release(settings);
+
+		// 映像ソースの更新は次のtickまで遅延されるため、ここで反映させる
+		obs_source_video_tick(renderer->source, 0.0f);
+
+		bfree(renderer->text);
+		renderer->text = bstrdup(text);
+		renderer->cx = obs_source_get_width(renderer->source);
+		renderer->cy = obs_source_get_height(renderer->source);
+	}
+
+	*cx = renderer->cx;
+	*cy = renderer->cy;
+	return renderer->cx && renderer->cy;
+}
+
+void match_counter_text_renderer_render(match_counter_text_renderer_t *renderer)
+{
+	obs_source_video_render(renderer->source);
+}
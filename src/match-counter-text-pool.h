@@ -0,0 +1,84 @@
+/*
+Match Counter for OBS
+Copyright (C) 2025 Yudai Udagawa
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include <obs-module.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * フォントごとに共有されるテキストの描画器
+ *
+ * 同じフォント（フェイス・サイズ・フラグ）を使うソースは、1つの内部テキストソースを共有する。
+ * FreeType/GDI+のフォントの読み込みとグリフのキャッシュはフォントごとに1つだけになる。
+ */
+typedef struct match_counter_text_renderer match_counter_text_renderer_t;
+
+/**
+ * プールを初期化する（モジュールの読み込み時に1回だけ呼ぶ）
+ */
+void match_counter_text_pool_init(void);
+
+/**
+ * プールを解放する（モジュールの解放時に1回だけ呼ぶ）
+ */
+void match_counter_text_pool_free(void);
+
+/**
+ * フォントに対応する描画器を取得する。なければ作成する
+ * @param face フォント名
+ * @param size フォントサイズ
+ * @param flags フォントのフラグ（太字・斜体など）
+ * @return 参照カウントを1つ増やした描画器（テキストソースを作成できなかった場合はNULL）
+ */
+match_counter_text_renderer_t *match_counter_text_pool_acquire(const char *face, uint16_t size, uint32_t flags);
+
+/**
+ * 描画器の参照を手放す（最後の参照を手放すと内部のテキストソースも解放される）
+ * @param renderer 描画器（NULLなら何もしない）
+ */
+void match_counter_text_pool_release(match_counter_text_renderer_t *renderer);
+
+/**
+ * 描画器にテキストを反映し、その大きさを取得する
+ * @param renderer 描画器
+ * @param text 表示するテキスト
+ * @param cx 幅を受け取るポインタ
+ * @param cy 高さを受け取るポインタ
+ * @return テキストが空でない大きさになった場合はtrue
+ *
+ * 描画スレッドからのみ呼ぶ。直前に反映したテキストと同じであればテキストソースを更新しないため、
+ * 同じフレームで同じ表示のソースが続いてもレイアウトは1回で済む
+ */
+bool match_counter_text_renderer_prepare(match_counter_text_renderer_t *renderer, const char *text, uint32_t *cx,
+					 uint32_t *cy);
+
+/**
+ * 最後にmatch_counter_text_renderer_prepareで反映したテキストを現在の描画先に描画する
+ * @param renderer 描画器
+ *
+ * 描画スレッドからのみ、グラフィックスコンテキスト内で呼ぶ
+ */
+void match_counter_text_renderer_render(match_counter_text_renderer_t *renderer);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,187 @@
+/*
+Match Counter for OBS
+Copyright (C) 2025 Yudai Udagawa
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include "match-counter-trace.h"
+#include "match-counter-atomic.h"
+#include <stdlib.h>
+#include <util/darray.h>
+#include <util/platform.h>
+#include <util/threading.h>
+
+// スレッドごとのリングバッファに保持するレコード数（2のべき乗）
+#define TRACE_RING_CAPACITY 1024
+
+#ifdef _MSC_VER
+#define TRACE_THREAD_LOCAL __declspec(thread)
+#else
+#define TRACE_THREAD_LOCAL _Thread_local
+#endif
+
+// 固定長（64bit環境で32バイト）のレコード
+struct trace_record {
+	uint64_t time_ns;
+	const void *owner;
+	uint32_t event;
+	int32_t a;
+	int32_t b;
+	int32_t c;
+};
+
+// 書き込みは所有するスレッドだけが行い、ダンプ時に他のスレッドから読まれる
+struct trace_ring {
+	volatile uint64_t head; // 次に書き込むレコードの通し番号
+	uint32_t thread_index;
+	struct trace_record records[TRACE_RING_CAPACITY];
+};
+
+static const char *event_names[MATCH_COUNTER_TRACE_EVENT_COUNT] = {
+	"text_source_create",
+	"text_update",
+	"atlas_build",
+	"score_change",
+};
+
+static pthread_mutex_t trace_mutex;
+static DARRAY(struct trace_ring *) trace_rings;
+static TRACE_THREAD_LOCAL struct trace_ring *thread_ring;
+
+void match_counter_trace_init(void)
+{
+	pthread_mutex_init(&trace_mutex, NULL);
+	da_init(trace_rings);
+}
+
+void match_counter_trace_free(void)
+{
+	// 終了したスレッドのリングバッファもここでまとめて解放する
+	for (size_t i = 0; i < trace_rings.num; i++)
+		bfree(trace_rings.array[i]);
+	da_free(trace_rings);
+	pthread_mutex_destroy(&trace_mutex);
+}
+
+static struct trace_ring *trace_register_thread(void)
+{
+	struct trace_ring *ring = bzalloc(sizeof(struct trace_ring));
+
+	pthread_mutex_lock(&trace_mutex);
+	ring->thread_index = (uint32_t)trace_rings.num;
+	da_push_back(trace_rings, &ring);
+	pthread_mutex_unlock(&trace_mutex);
+
+	thread_ring = ring;
+	return ring;
+}
+
+void match_counter_trace_record(const void *owner, enum match_counter_trace_event event, int32_t a, int32_t b,
+				int32_t c)
+{
+	struct trace_ring *ring = thread_ring;
+	if (!ring)
+		ring = trace_register_thread();
+
+	uint64_t head = ring->head;
+	struct trace_record *record = &ring->records[head & (TRACE_RING_CAPACITY - 1)];
+	record->time_ns = os_gettime_ns();
+	record->owner = owner;
+	record->event = (uint32_t)event;
+	record->a = a;
+	record->b = b;
+	record->c = c;
+
+	// レコードを書き終えてから通し番号を公開する
+	match_counter_atomic_store_u64(&ring->head, head + 1);
+}
+
+struct trace_entry {
+	struct trace_record record;
+	uint64_t seq;
+	uint32_t thread_index;
+};
+
+// 書き込み中に上書きされた可能性のあるレコードは捨てて、確実に読めた分だけ集める
+static void trace_collect(struct trace_ring *ring, const void *owner, struct trace_entry **entries, size_t *num,
+			  size_t *capacity)
+{
+	uint64_t end = match_counter_atomic_load_u64(&ring->head);
+	uint64_t begin = end > TRACE_RING_CAPACITY ? end - TRACE_RING_CAPACITY : 0;
+	size_t first = *num;
+
+	for (uint64_t i = begin; i < end; i++) {
+		const struct trace_record *record = &ring->records[i & (TRACE_RING_CAPACITY - 1)];
+		if (owner && record->owner != owner)
+			continue;
+
+		if (*num == *capacity) {
+			*capacity = *capacity ? *capacity * 2 : TRACE_RING_CAPACITY;
+			*entries = brealloc(*entries, sizeof(struct trace_entry) * *capacity);
+		}
+		(*entries)[*num].record = *record;
+		(*entries)[*num].seq = i;
+		(*entries)[*num].thread_index = ring->thread_index;
+		(*num)++;
+	}
+
+	// コピー中に書き込みが進んだ場合、古い方から上書きされた（または上書き中の）分を取り除く
+	uint64_t head = match_counter_atomic_load_u64(&ring->head);
+	if (head + 1 > TRACE_RING_CAPACITY) {
+		uint64_t valid_from = head + 1 - TRACE_RING_CAPACITY;
+		size_t keep = first;
+		for (size_t i = first; i < *num; i++) {
+			if ((*entries)[i].seq >= valid_from)
+				(*entries)[keep++] = (*entries)[i];
+		}
+		*num = keep;
+	}
+}
+
+static int trace_entry_compare(const void *a, const void *b)
+{
+	uint64_t ta = ((const struct trace_entry *)a)->record.time_ns;
+	uint64_t tb = ((const struct trace_entry *)b)->record.time_ns;
+	return ta < tb ? -1 : ta > tb ? 1 : 0;
+}
+
+void match_counter_trace_dump(const void *owner, const char *name)
+{
+	struct trace_entry *entries = NULL;
+	size_t num = 0;
+	size_t capacity = 0;
+
+	pthread_mutex_lock(&trace_mutex);
+	for (size_t i = 0; i < trace_rings.num; i++)
+		trace_collect(trace_rings.array[i], owner, &entries, &num, &capacity);
+	pthread_mutex_unlock(&trace_mutex);
+
+	qsort(entries, num, sizeof(struct trace_entry), trace_entry_compare);
+
+	blog(LOG_INFO, "match_counter_trace: [%s] %zu records", name ? name : "", num);
+
+	uint64_t base_ns = num ? entries[0].record.time_ns : 0;
+	for (size_t i = 0; i < num; i++) {
+		const struct trace_record *record = &entries[i].record;
+		const char *event = record->event < MATCH_COUNTER_TRACE_EVENT_COUNT ? event_names[record->event]
+										    : "unknown";
+
+		blog(LOG_INFO, "match_counter_trace: +%.3fms thread=%u owner=%p %s a=%d b=%d c=%d",
+		     (double)(record->time_ns - base_ns) / 1e6, entries[i].thread_index, record->owner, event,
+		     record->a, record->b, record->c);
+	}
+
+	bfree(entries);
+}
@@ -0,0 +1,82 @@
+/*
+Match Counter for OBS
+Copyright (C) 2025 Yudai Udagawa
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include <obs-module.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * トレースするイベントの種類
+ */
+enum match_counter_trace_event {
+	MATCH_COUNTER_TRACE_TEXT_SOURCE_CREATE, // a: 成功なら1
+	MATCH_COUNTER_TRACE_TEXT_UPDATE,        // a: テキストのバイト数, b: 幅, c: 高さ
+	MATCH_COUNTER_TRACE_ATLAS_BUILD,        // a: 文字数, b: アトラスの幅, c: アトラスの高さ
+	MATCH_COUNTER_TRACE_SCORE_CHANGE,       // a: 適用した操作の数, b: 勝利数, c: 敗北数
+	MATCH_COUNTER_TRACE_EVENT_COUNT,
+};
+
+#ifdef ENABLE_TRACE
+
+/**
+ * トレースを初期化する（モジュールの読み込み時に1回だけ呼ぶ）
+ */
+void match_counter_trace_init(void);
+
+/**
+ * トレースを解放する（モジュールの解放時に1回だけ呼ぶ）
+ */
+void match_counter_trace_free(void);
+
+/**
+ * 呼び出したスレッドのリングバッファに固定長のレコードを1つ書き込む
+ * @param owner レコードの持ち主（ソースなど）
+ * @param event イベントの種類
+ * @param a イベントごとの値
+ * @param b イベントごとの値
+ * @param c イベントごとの値
+ *
+ * 文字列の整形やロックは行わない（スレッドごとの初回だけリングバッファを登録する）
+ */
+void match_counter_trace_record(const void *owner, enum match_counter_trace_event event, int32_t a, int32_t b,
+				int32_t c);
+
+/**
+ * 記録されたレコードを時刻順に文字列へ変換してログに出力する
+ * @param owner 出力するレコードの持ち主（NULLならすべて）
+ * @param name ログに含める名前
+ */
+void match_counter_trace_dump(const void *owner, const char *name);
+
+#define MATCH_COUNTER_TRACE(owner, event, a, b, c) \
+	match_counter_trace_record(owner, event, (int32_t)(a), (int32_t)(b), (int32_t)(c))
+
+#else
+
+// リリースビルドではトレースの呼び出しごと消える
+#define MATCH_COUNTER_TRACE(owner, event, a, b, c) ((void)0)
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
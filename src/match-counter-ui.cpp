@@ -0,0 +1,403 @@
+/*
+Match Counter for OBS
+Copyright (C) 2025 Yudai Udagawa
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include <obs-module.h>
+#include <obs-frontend-api.h>
+#include <obs.hpp>
+#include <plugin-support.h>
+
+#include <QHBoxLayout>
+#include <QLabel>
+#include <QMetaObject>
+#include <QPointer>
+#include <QPushButton>
+#include <QScrollArea>
+#include <QTimer>
+#include <QToolButton>
+#include <QVBoxLayout>
+#include <QWidget>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// 対象にするソースの種類
+#define MATCH_COUNTER_SOURCE_ID "match_counter_source"
+// ドックのID
+#define MATCH_COUNTER_DOCK_ID "match-counter-dock"
+// 表示を更新する最短間隔（1フレーム分）
+#define MATCH_COUNTER_DOCK_FLUSH_MS 16
+
+class MatchCounterDock;
+
+// ドックの1行（1つのカウンターソース）
+//
+// シグナルのコールバックは任意のスレッドから呼ばれるため、最新の値をアトミックに置いて
+// 汚れフラグを立てるだけにし、ラベルの更新はUIスレッドでまとめて行う
+struct MatchCounterRow {
+	MatchCounterDock *dock = nullptr;
+	OBSWeakSourceAutoRelease weak;
+	obs_source_t *source = nullptr; // 比較用（参照は持たない）
+
+	QWidget *widget = nullptr;
+	QLabel *name = nullptr;
+	QLabel *score = nullptr;
+
+	OBSSignal changedSignal;
+	OBSSignal renameSignal;
+
+	std::atomic<long long> wins{0};
+	std::atomic<long long> losses{0};
+	std::atomic<bool> scoreDirty{false};
+	std::atomic<bool> nameDirty{false};
+	std::atomic<bool> dead{false}; // ソースが破棄された（次の更新で行を取り除く）
+};
+
+class MatchCounterDock : public QWidget {
+public:
+	explicit MatchCounterDock(QWidget *parent = nullptr);
+	~MatchCounterDock();
+
+	void AddSource(obs_source_t *source);
+	void ReloadSources();
+	void ScheduleFlush();
+
+private:
+	void Flush();
+	void UpdateScore(MatchCounterRow *row);
+	void CallProc(MatchCounterRow *row, const char *proc);
+	QWidget *CreateRowWidget(MatchCounterRow *row);
+
+	static void SourceCreated(void *data, calldata_t *cd);
+	static void SourceDestroyed(void *data, calldata_t *cd);
+	static void CounterChanged(void *data, calldata_t *cd);
+	static void SourceRenamed(void *data, calldata_t *cd);
+
+	QVBoxLayout *rowsLayout;
+	QLabel *placeholder;
+	QTimer flushTimer;
+	std::atomic<bool> flushPending{false};
+
+	// 行の追加はUIスレッド、破棄の通知は任意のスレッドから行われる
+	std::mutex rowsMutex;
+	std::vector<std::unique_ptr<MatchCounterRow>> rows;
+
+	OBSSignal createSignal;
+	OBSSignal destroySignal;
+};
+
+static QPointer<MatchCounterDock> match_counter_dock;
+
+static bool match_counter_ui_is_counter(obs_source_t *source)
+{
+	const char *id = obs_source_get_unversioned_id(source);
+	return id && strcmp(id, MATCH_COUNTER_SOURCE_ID) == 0;
+}
+
+MatchCounterDock::MatchCounterDock(QWidget *parent) : QWidget(parent)
+{
+	QWidget *container = new QWidget();
+	rowsLayout = new QVBoxLayout(container);
+	rowsLayout->setContentsMargins(4, 4, 4, 4);
+
+	placeholder = new QLabel(QString::fromUtf8(obs_module_text("Dock.NoCounters")));
+	placeholder->setAlignment(Qt::AlignCenter);
+	rowsLayout->addWidget(placeholder);
+	rowsLayout->addStretch();
+
+	QScrollArea *scroll = new QScrollArea();
+	scroll->setWidgetResizable(true);
+	scroll->setFrameShape(QFrame::NoFrame);
+	scroll->setWidget(container);
+
+	QVBoxLayout *layout = new QVBoxLayout(this);
+	layout->setContentsMargins(0, 0, 0, 0);
+	layout->addWidget(scroll);
+
+	// 同じフレーム内に届いた変更は1回の更新にまとめる。変更がなければタイマーも動かない
+	flushTimer.setSingleShot(true);
+	flushTimer.setInterval(MATCH_COUNTER_DOCK_FLUSH_MS);
+	connect(&flushTimer, &QTimer::timeout, this, [this]() { Flush(); });
+
+	signal_handler_t *sh = obs_get_signal_handler();
+	createSignal.Connect(sh, "source_create", SourceCreated, this);
+	destroySignal.Connect(sh, "source_destroy", SourceDestroyed, this);
+}
+
+MatchCounterDock::~MatchCounterDock()
+{
+	createSignal.Disconnect();
+	destroySignal.Disconnect();
+
+	std::lock_guard<std::mutex> lock(rowsMutex);
+	for (auto &row : rows) {
+		row->changedSignal.Disconnect();
+		row->renameSignal.Disconnect();
+	}
+	rows.clear();
+}
+
+QWidget *MatchCounterDock::CreateRowWidget(MatchCounterRow *row)
+{
+	QWidget *widget = new QWidget();
+	QHBoxLayout *layout = new QHBoxLayout(widget);
+	layout->setContentsMargins(0, 0, 0, 0);
+
+	row->name = new QLabel(QString::fromUtf8(obs_source_get_name(row->source)));
+	row->score = new QLabel();
+	row->score->setMinimumWidth(64);
+	row->score->setAlignment(Qt::AlignRight | Qt::AlignVCenter);
+	layout->addWidget(row->name, 1);
+	layout->addWidget(row->score);
+
+	auto addButton = [&](const char *text, const char *tooltip, const char *proc) {
+		QToolButton *button = new QToolButton();
+		button->setText(QString::fromUtf8(text));
+		button->setToolTip(QString::fromUtf8(obs_module_text(tooltip)));
+		connect(button, &QToolButton::clicked, this, [this, row, proc]() { CallProc(row, proc); });
+		layout->addWidget(button);
+	};
+
+	layout->addWidget(new QLabel(QString::fromUtf8(obs_module_text("Wins"))));
+	addButton("+", "AddWin", "add_win");
+	addButton("\xE2\x88\x92", "SubtractWin", "subtract_win");
+	layout->addWidget(new QLabel(QString::fromUtf8(obs_module_text("Losses"))));
+	addButton("+", "AddLoss", "add_loss");
+	addButton("\xE2\x88\x92", "SubtractLoss", "subtract_loss");
+
+	QPushButton *reset = new QPushButton(QString::fromUtf8(obs_module_text("Dock.Reset")));
+	reset->setToolTip(QString::fromUtf8(obs_module_text("ResetCounter")));
+	connect(reset, &QPushButton::clicked, this, [this, row]() { CallProc(row, "reset"); });
+	layout->addWidget(reset);
+
+	return widget;
+}
+
+void MatchCounterDock::AddSource(obs_source_t *source)
+{
+	if (!match_counter_ui_is_counter(source))
+		return;
+
+	std::lock_guard<std::mutex> lock(rowsMutex);
+
+	for (auto &row : rows) {
+		if (row->source == source && !row->dead)
+			return;
+	}
+
+	auto row = std::make_unique<MatchCounterRow>();
+	row->dock = this;
+	row->source = source;
+	row->weak = obs_source_get_weak_source(source);
+	row->widget = CreateRowWidget(row.get());
+
+	// 末尾のストレッチより前に追加する
+	rowsLayout->insertWidget(rowsLayout->count() - 1, row->widget);
+	placeholder->setVisible(false);
+
+	signal_handler_t *sh = obs_source_get_signal_handler(source);
+	row->changedSignal.Connect(sh, "counter_changed", CounterChanged, row.get());
+	row->renameSignal.Connect(sh, "rename", SourceRenamed, row.get());
+
+	// 接続前の値は直接問い合わせる
+	uint8_t stack[128];
+	calldata_t cd;
+	calldata_init_fixed(&cd, stack, sizeof(stack));
+	proc_handler_call(obs_source_get_proc_handler(source), "get_score", &cd);
+	row->wins = calldata_int(&cd, "wins");
+	row->losses = calldata_int(&cd, "losses");
+	UpdateScore(row.get());
+
+	rows.push_back(std::move(row));
+}
+
+void MatchCounterDock::ReloadSources()
+{
+	obs_enum_sources(
+		[](void *data, obs_source_t *source) {
+			static_cast<MatchCounterDock *>(data)->AddSource(source);
+			return true;
+		},
+		this);
+}
+
+void MatchCounterDock::ScheduleFlush()
+{
+	if (flushPending.exchange(true))
+		return;
+
+	// タイマーはUIスレッドでしか開始できない
+	QMetaObject::invokeMethod(
+		this, [this]() { flushTimer.start(); }, Qt::QueuedConnection);
+}
+
+void MatchCounterDock::UpdateScore(MatchCounterRow *row)
+{
+	row->score->setText(QString("%1 - %2").arg(row->wins.load()).arg(row->losses.load()));
+}
+
+void MatchCounterDock::Flush()
+{
+	// 以降に届いた変更は次の更新で反映する
+	flushPending = false;
+
+	std::lock_guard<std::mutex> lock(rowsMutex);
+
+	for (auto it = rows.begin(); it != rows.end();) {
+		MatchCounterRow *row = it->get();
+
+		if (row->dead) {
+			delete row->widget;
+			it = rows.erase(it);
+			continue;
+		}
+
+		if (row->scoreDirty.exchange(false))
+			UpdateScore(row);
+
+		if (row->nameDirty.exchange(false)) {
+			OBSSourceAutoRelease source = obs_weak_source_get_source(row->weak);
+			if (source)
+				row->name->setText(QString::fromUtf8(obs_source_get_name(source)));
+		}
+		++it;
+	}
+
+	placeholder->setVisible(rows.empty());
+}
+
+void MatchCounterDock::CallProc(MatchCounterRow *row, const char *proc)
+{
+	OBSSourceAutoRelease source = obs_weak_source_get_source(row->weak);
+	if (!source)
+		return;
+
+	// 表示はcounter_changedシグナル経由で更新される
+	uint8_t stack[128];
+	calldata_t cd;
+	calldata_init_fixed(&cd, stack, sizeof(stack));
+	proc_handler_call(obs_source_get_proc_handler(source), proc, &cd);
+}
+
+void MatchCounterDock::SourceCreated(void *data, calldata_t *cd)
+{
+	MatchCounterDock *dock = static_cast<MatchCounterDock *>(data);
+	obs_source_t *source = static_cast<obs_source_t *>(calldata_ptr(cd, "source"));
+
+	if (!source || !match_counter_ui_is_counter(source))
+		return;
+
+	// 作成を通知したスレッドではなくUIスレッドで行を追加する
+	OBSWeakSource weak = OBSGetWeakRef(source);
+	QMetaObject::invokeMethod(
+		dock,
+		[dock, weak]() {
+			OBSSource source = OBSGetStrongRef(weak);
+			if (source)
+				dock->AddSource(source);
+		},
+		Qt::QueuedConnection);
+}
+
+void MatchCounterDock::SourceDestroyed(void *data, calldata_t *cd)
+{
+	MatchCounterDock *dock = static_cast<MatchCounterDock *>(data);
+	obs_source_t *source = static_cast<obs_source_t *>(calldata_ptr(cd, "source"));
+
+	if (!source || !match_counter_ui_is_counter(source))
+		return;
+
+	// ソースのシグナルハンドラーが破棄される前に、ここで切断しておく
+	{
+		std::lock_guard<std::mutex> lock(dock->rowsMutex);
+		for (auto &row : dock->rows) {
+			if (row->source == source && !row->dead) {
+				row->changedSignal.Disconnect();
+				row->renameSignal.Disconnect();
+				row->dead = true;
+			}
+		}
+	}
+
+	dock->ScheduleFlush();
+}
+
+void MatchCounterDock::CounterChanged(void *data, calldata_t *cd)
+{
+	MatchCounterRow *row = static_cast<MatchCounterRow *>(data);
+
+	row->wins = calldata_int(cd, "wins");
+	row->losses = calldata_int(cd, "losses");
+
+	// 既に更新待ちなら値を差し替えるだけで、UIスレッドへの通知は増やさない
+	if (!row->scoreDirty.exchange(true))
+		row->dock->ScheduleFlush();
+}
+
+void MatchCounterDock::SourceRenamed(void *data, calldata_t *cd)
+{
+	UNUSED_PARAMETER(cd);
+	MatchCounterRow *row = static_cast<MatchCounterRow *>(data);
+
+	if (!row->nameDirty.exchange(true))
+		row->dock->ScheduleFlush();
+}
+
+static void match_counter_ui_frontend_event(enum obs_frontend_event event, void *data)
+{
+	UNUSED_PARAMETER(data);
+
+	if (!match_counter_dock)
+		return;
+
+	switch (event) {
+	case OBS_FRONTEND_EVENT_FINISHED_LOADING:
+	case OBS_FRONTEND_EVENT_SCENE_COLLECTION_CHANGED:
+		match_counter_dock->ReloadSources();
+		break;
+	default:
+		break;
+	}
+}
+
+extern "C" void match_counter_ui_init(void)
+{
+	QWidget *main_window = static_cast<QWidget *>(obs_frontend_get_main_window());
+	match_counter_dock = new MatchCounterDock(main_window);
+
+	if (!obs_frontend_add_dock_by_id(MATCH_COUNTER_DOCK_ID, obs_module_text("MatchCounterTitle"),
+					 match_counter_dock)) {
+		obs_log(LOG_WARNING, "failed to add the match counter dock");
+		delete match_counter_dock;
+		return;
+	}
+
+	obs_frontend_add_event_callback(match_counter_ui_frontend_event, nullptr);
+}
+
+extern "C" void match_counter_ui_free(void)
+{
+	obs_frontend_remove_event_callback(match_counter_ui_frontend_event, nullptr);
+
+	// ドックはメインウィンドウと一緒に破棄されるため、ここでは残っている場合だけ片付ける
+	if (match_counter_dock)
+		obs_frontend_remove_dock(MATCH_COUNTER_DOCK_ID);
+}
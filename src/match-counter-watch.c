@@ -0,0 +1,497 @@
+/*
+Match Counter for OBS
+Copyright (C) 2025 Yudai Udagawa
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include "match-counter-watch.h"
+#include <util/platform.h>
+#include <util/threading.h>
+#include <ctype.h>
+#include <limits.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#else
+#include <sys/event.h>
+#include <sys/stat.h>
+#endif
+#endif
+
+// 最後の変更通知からファイルを読むまでの待ち時間（ミリ秒）
+#define WATCH_DEBOUNCE_MS 100
+// 変更通知を受け取るバッファの大きさ
+#define WATCH_BUFFER_SIZE 4096
+
+struct match_counter_watch {
+	char *path;
+	char *name; // ディレクトリを除いたファイル名（変更通知との照合用）
+	match_counter_watch_callback_t callback;
+	void *data;
+
+	pthread_t thread;
+	volatile bool stop;
+
+#ifdef _WIN32
+	wchar_t *wname;
+	HANDLE dir_handle;
+	HANDLE stop_event;
+#elif defined(__linux__)
+	int inotify_fd;
+	int wake_fds[2];
+#else
+	int kq;
+	int dir_fd;
+	int file_fd;
+	ino_t file_ino; // 開いているファイルのiノード（置き換えの検知用）
+	int wake_fds[2];
+#endif
+};
+
+// 文字列から整数を1つ読む（0からINT_MAXに丸める）。数字がなければNULL
+static const char *watch_parse_int(const char *p, int *value)
+{
+	while (*p && !isdigit((unsigned char)*p))
+		p++;
+	if (!*p)
+		return NULL;
+
+	long long parsed = 0;
+	while (isdigit((unsigned char)*p)) {
+		if (parsed < INT_MAX)
+			parsed = parsed * 10 + (*p - '0');
+		p++;
+	}
+
+	*value = parsed > INT_MAX ? INT_MAX : (int)parsed;
+	return p;
+}
+
+// JSONのキーの値を読む（"key"の後の':'に続く整数）
+static bool watch_parse_json_int(const char *text, const char *key, int *value)
+{
+	const char *p = strstr(text, key);
+	if (!p)
+		return false;
+
+	p += strlen(key);
+	while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+		p++;
+	if (*p++ != ':')
+		return false;
+	while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+		p++;
+
+	return isdigit((unsigned char)*p) && watch_parse_int(p, value);
+}
+
+// ファイルの内容から勝敗数を読む。JSONなら"wins"と"losses"、そうでなければ先頭から2つの整数
+static bool watch_parse(const char *text, int *wins, int *losses)
+{
+	const char *p = text;
+	while (isspace((unsigned char)*p))
+		p++;
+
+	if (*p == '{')
+		return watch_parse_json_int(p, "\"wins\"", wins) && watch_parse_json_int(p, "\"losses\"", losses);
+
+	p = watch_parse_int(p, wins);
+	return p && watch_parse_int(p, losses);
+}
+
+// ファイルを読み、勝敗数が読めればコールバックを呼ぶ（書きかけなどで読めなければ前の値のまま）
+static void watch_apply(struct match_counter_watch *watch)
+{
+	char *text = os_quick_read_utf8_file(watch->path);
+	if (!text)
+		return;
+
+	int wins = 0;
+	int losses = 0;
+	if (watch_parse(text, &wins, &losses))
+		watch->callback(watch->data, wins, losses);
+	else
+		blog(LOG_DEBUG, "match_counter_watch: Ignoring unreadable score in '%s'", watch->path);
+
+	bfree(text);
+}
+
+#ifdef _WIN32
+#define WATCH_FILTER (FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE)
+
+static bool watch_open(struct match_counter_watch *watch, const char *dir)
+{
+	wchar_t *wdir = NULL;
+	os_utf8_to_wcs_ptr(dir, 0, &wdir);
+	os_utf8_to_wcs_ptr(watch->name, 0, &watch->wname);
+
+	watch->dir_handle = wdir ? CreateFileW(wdir, FILE_LIST_DIRECTORY,
+					       FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+					       OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL)
+				 : INVALID_HANDLE_VALUE;
+	bfree(wdir);
+
+	watch->stop_event = CreateEventW(NULL, TRUE, FALSE, NULL);
+	return watch->wname && watch->dir_handle != INVALID_HANDLE_VALUE && watch->stop_event;
+}
+
+static void watch_close(struct match_counter_watch *watch)
+{
+	if (watch->dir_handle && watch->dir_handle != INVALID_HANDLE_VALUE)
+		CloseHandle(watch->dir_handle);
+	if (watch->stop_event)
+		CloseHandle(watch->stop_event);
+	bfree(watch->wname);
+}
+
+static void watch_wake(struct match_counter_watch *watch)
+{
+	SetEvent(watch->stop_event);
+}
+
+// 変更通知のバッファに監視中のファイルが含まれるか
+static bool watch_matches(struct match_counter_watch *watch, const void *buffer)
+{
+	const FILE_NOTIFY_INFORMATION *info = buffer;
+	size_t name_len = wcslen(watch->wname);
+
+	for (;;) {
+		if (info->FileNameLength / sizeof(WCHAR) == name_len &&
+		    _wcsnicmp(info->FileName, watch->wname, name_len) == 0)
+			return true;
+		if (!info->NextEntryOffset)
+			return false;
+		info = (const FILE_NOTIFY_INFORMATION *)((const uint8_t *)info + info->NextEntryOffset);
+	}
+}
+
+static void *watch_thread(void *data)
+{
+	struct match_counter_watch *watch = data;
+	os_set_thread_name("match-counter: watch");
+
+	watch_apply(watch);
+
+	OVERLAPPED ov = {0};
+	ov.hEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+	DWORD buffer[WATCH_BUFFER_SIZE / sizeof(DWORD)]; // FILE_NOTIFY_INFORMATIONはDWORD境界に置く必要がある
+	bool pending = false;
+
+	while (!os_atomic_load_bool(&watch->stop)) {
+		if (!ReadDirectoryChangesW(watch->dir_handle, buffer, sizeof(buffer), FALSE, WATCH_FILTER, NULL, &ov,
+					   NULL)) {
+			blog(LOG_WARNING, "match_counter_watch: Failed to watch '%s' (%lu)", watch->path,
+			     GetLastError());
+			break;
+		}
+
+		// 変更が続く間は読むのを遅らせ、落ち着いてから1回だけ読む
+		HANDLE handles[2] = {watch->stop_event, ov.hEvent};
+		DWORD wait;
+		while ((wait = WaitForMultipleObjects(2, handles, FALSE, pending ? WATCH_DEBOUNCE_MS : INFINITE)) ==
+		       WAIT_TIMEOUT) {
+			pending = false;
+			watch_apply(watch);
+		}
+
+		DWORD bytes = 0;
+		if (wait != WAIT_OBJECT_0 + 1) {
+			CancelIo(watch->dir_handle);
+			GetOverlappedResult(watch->dir_handle, &ov, &bytes, TRUE);
+			break;
+		}
+		if (!GetOverlappedResult(watch->dir_handle, &ov, &bytes, FALSE))
+			break;
+
+		// バッファが溢れた場合は何が変わったか分からないので読み直す
+		if (!bytes || watch_matches(watch, buffer))
+			pending = true;
+	}
+
+	CloseHandle(ov.hEvent);
+	return NULL;
+}
+#elif defined(__linux__)
+#define WATCH_MASK (IN_CLOSE_WRITE | IN_MODIFY | IN_CREATE | IN_MOVED_TO)
+
+static bool watch_open(struct match_counter_watch *watch, const char *dir)
+{
+	watch->wake_fds[0] = watch->wake_fds[1] = -1;
+	watch->inotify_fd = inotify_init1(IN_CLOEXEC);
+	if (watch->inotify_fd < 0 || inotify_add_watch(watch->inotify_fd, dir, WATCH_MASK) < 0 ||
+	    pipe(watch->wake_fds) != 0)
+		return false;
+
+	fcntl(watch->wake_fds[0], F_SETFD, FD_CLOEXEC);
+	fcntl(watch->wake_fds[1], F_SETFD, FD_CLOEXEC);
+	return true;
+}
+
+static void watch_close(struct match_counter_watch *watch)
+{
+	if (watch->inotify_fd >= 0)
+		close(watch->inotify_fd);
+	for (size_t i = 0; i < 2; i++) {
+		if (watch->wake_fds[i] >= 0)
+			close(watch->wake_fds[i]);
+	}
+}
+
+static void watch_wake(struct match_counter_watch *watch)
+{
+	char byte = 0;
+	if (write(watch->wake_fds[1], &byte, 1) < 0)
+		blog(LOG_WARNING, "match_counter_watch: Failed to wake watch thread (%d)", errno);
+}
+
+// 読み出した変更通知に監視中のファイルが含まれるか
+static bool watch_matches(struct match_counter_watch *watch, const char *buffer, ssize_t len)
+{
+	bool matched = false;
+	for (ssize_t offset = 0; offset < len;) {
+		const struct inotify_event *event = (const struct inotify_event *)(buffer + offset);
+		if ((event->mask & IN_Q_OVERFLOW) || (event->len && strcmp(event->name, watch->name) == 0))
+			matched = true;
+		offset += (ssize_t)(sizeof(struct inotify_event) + event->len);
+	}
+	return matched;
+}
+
+static void *watch_thread(void *data)
+{
+	struct match_counter_watch *watch = data;
+	os_set_thread_name("match-counter: watch");
+
+	watch_apply(watch);
+
+	char buffer[WATCH_BUFFER_SIZE] __attribute__((aligned(__alignof__(struct inotify_event))));
+	bool pending = false;
+
+	while (!os_atomic_load_bool(&watch->stop)) {
+		struct pollfd fds[2] = {{.fd = watch->inotify_fd, .events = POLLIN},
+					{.fd = watch->wake_fds[0], .events = POLLIN}};
+
+		// 変更が続く間は読むのを遅らせ、落ち着いてから1回だけ読む
+		int ready = poll(fds, 2, pending ? WATCH_DEBOUNCE_MS : -1);
+		if (ready < 0) {
+			if (errno == EINTR)
+				continue;
+			blog(LOG_WARNING, "match_counter_watch: poll failed (%d)", errno);
+			break;
+		}
+
+		if (fds[1].revents)
+			break;
+
+		if (!ready) {
+			pending = false;
+			watch_apply(watch);
+			continue;
+		}
+
+		ssize_t len = read(watch->inotify_fd, buffer, sizeof(buffer));
+		if (len < 0 && errno != EINTR && errno != EAGAIN) {
+			blog(LOG_WARNING, "match_counter_watch: Failed to read events for '%s' (%d)", watch->path,
+			     errno);
+			break;
+		}
+		if (len > 0 && watch_matches(watch, buffer, len))
+			pending = true;
+	}
+
+	return NULL;
+}
+#else
+#ifdef O_EVTONLY
+#define WATCH_OPEN_FLAGS (O_EVTONLY | O_CLOEXEC)
+#else
+#define WATCH_OPEN_FLAGS (O_RDONLY | O_CLOEXEC)
+#endif
+
+static bool watch_register(struct match_counter_watch *watch, int fd, short filter, unsigned int fflags)
+{
+	struct kevent change;
+	EV_SET(&change, fd, filter, EV_ADD | EV_CLEAR, fflags, 0, NULL);
+	return kevent(watch->kq, &change, 1, NULL, 0, NULL) == 0;
+}
+
+// ファイルを開き直す。別のファイルに置き換わった（または新しく作られた）場合はtrue
+static bool watch_reopen_file(struct match_counter_watch *watch)
+{
+	struct stat st;
+	if (stat(watch->path, &st) != 0) {
+		if (watch->file_fd >= 0)
+			close(watch->file_fd);
+		watch->file_fd = -1;
+		return false;
+	}
+
+	if (watch->file_fd >= 0 && st.st_ino == watch->file_ino)
+		return false;
+
+	// 閉じたファイルのイベントはkqueueから自動的に取り除かれる
+	if (watch->file_fd >= 0)
+		close(watch->file_fd);
+	watch->file_fd = open(watch->path, WATCH_OPEN_FLAGS);
+	watch->file_ino = st.st_ino;
+	if (watch->file_fd >= 0)
+		watch_register(watch, watch->file_fd, EVFILT_VNODE,
+			       NOTE_WRITE | NOTE_EXTEND | NOTE_DELETE | NOTE_RENAME);
+	return true;
+}
+
+static bool watch_open(struct match_counter_watch *watch, const char *dir)
+{
+	watch->wake_fds[0] = watch->wake_fds[1] = -1;
+	watch->file_fd = -1;
+	watch->kq = kqueue();
+	watch->dir_fd = open(dir, WATCH_OPEN_FLAGS);
+	if (watch->kq < 0 || watch->dir_fd < 0 || pipe(watch->wake_fds) != 0)
+		return false;
+
+	fcntl(watch->kq, F_SETFD, FD_CLOEXEC);
+	fcntl(watch->wake_fds[0], F_SETFD, FD_CLOEXEC);
+	fcntl(watch->wake_fds[1], F_SETFD, FD_CLOEXEC);
+
+	// ディレクトリの書き込みはファイルの作成・削除・名前の変更（書き出し後の置き換え）で起きる
+	if (!watch_register(watch, watch->dir_fd, EVFILT_VNODE, NOTE_WRITE) ||
+	    !watch_register(watch, watch->wake_fds[0], EVFILT_READ, 0))
+		return false;
+
+	watch_reopen_file(watch);
+	return true;
+}
+
+static void watch_close(struct match_counter_watch *watch)
+{
+	int fds[5] = {watch->kq, watch->dir_fd, watch->file_fd, watch->wake_fds[0], watch->wake_fds[1]};
+	for (size_t i = 0; i < 5; i++) {
+		if (fds[i] >= 0)
+			close(fds[i]);
+	}
+}
+
+static void watch_wake(struct match_counter_watch *watch)
+{
+	char byte = 0;
+	if (write(watch->wake_fds[1], &byte, 1) < 0)
+		blog(LOG_WARNING, "match_counter_watch: Failed to wake watch thread (%d)", errno);
+}
+
+static void *watch_thread(void *data)
+{
+	struct match_counter_watch *watch = data;
+	os_set_thread_name("match-counter: watch");
+
+	watch_apply(watch);
+
+	struct kevent events[8];
+	bool pending = false;
+
+	while (!os_atomic_load_bool(&watch->stop)) {
+		// 変更が続く間は読むのを遅らせ、落ち着いてから1回だけ読む
+		struct timespec debounce = {0, WATCH_DEBOUNCE_MS * 1000000L};
+		int count = kevent(watch->kq, NULL, 0, events, 8, pending ? &debounce : NULL);
+		if (count < 0) {
+			if (errno == EINTR)
+				continue;
+			blog(LOG_WARNING, "match_counter_watch: kevent failed (%d)", errno);
+			break;
+		}
+
+		if (!count) {
+			pending = false;
+			watch_apply(watch);
+			continue;
+		}
+
+		bool stop = false;
+		for (int i = 0; i < count; i++) {
+			int fd = (int)events[i].ident;
+			if (fd == watch->wake_fds[0])
+				stop = true;
+			else if (fd == watch->file_fd)
+				pending = true;
+		}
+		if (stop)
+			break;
+
+		// ディレクトリの変更は他のファイルでも起きるため、同じパスのファイルが置き換わった場合だけ読む
+		pending |= watch_reopen_file(watch);
+	}
+
+	return NULL;
+}
+#endif
+
+match_counter_watch_t *match_counter_watch_create(const char *path, match_counter_watch_callback_t callback,
+						  void *data)
+{
+	if (!path || !*path || !callback)
+		return NULL;
+
+	struct match_counter_watch *watch = bzalloc(sizeof(struct match_counter_watch));
+	watch->path = bstrdup(path);
+	watch->callback = callback;
+	watch->data = data;
+
+	// 変更通知はファイル単体ではなくディレクトリで受け取る（書き出し後に置き換えるツールがあるため）
+	const char *slash = strrchr(path, '/');
+#ifdef _WIN32
+	const char *backslash = strrchr(path, '\\');
+	if (backslash > slash)
+		slash = backslash;
+#endif
+	char *dir = slash ? bstrdup_n(path, slash == path ? 1 : (size_t)(slash - path)) : bstrdup(".");
+	watch->name = bstrdup(slash ? slash + 1 : path);
+
+	bool opened = watch_open(watch, dir);
+	bfree(dir);
+
+	if (!opened || pthread_create(&watch->thread, NULL, watch_thread, watch) != 0) {
+		blog(LOG_WARNING, "match_counter_watch: Failed to watch '%s'", path);
+		watch_close(watch);
+		bfree(watch->name);
+		bfree(watch->path);
+		bfree(watch);
+		return NULL;
+	}
+
+	blog(LOG_INFO, "match_counter_watch: Watching '%s'", path);
+	return watch;
+}
+
+void match_counter_watch_destroy(match_counter_watch_t *watch)
+{
+	if (!watch)
+		return;
+
+	os_atomic_set_bool(&watch->stop, true);
+	watch_wake(watch);
+	pthread_join(watch->thread, NULL);
+
+	watch_close(watch);
+	bfree(watch->name);
+	bfree(watch->path);
+	bfree(watch);
+}
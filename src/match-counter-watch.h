@@ -0,0 +1,70 @@
+/*
+Match Counter for OBS
+Copyright (C) 2025 Yudai Udagawa
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include <obs-module.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * 外部のツールが書き出す勝敗数のファイルを監視するウォッチャー
+ *
+ * ファイルのあるディレクトリをOSの変更通知（Linuxではinotify、WindowsではReadDirectoryChangesW、
+ * macOSなどではkqueue）で監視し、変更があったときだけ読み直す。変更が続く間は読み込みを遅らせ、
+ * 書き込みが落ち着いてから1回だけ読むため、書きかけの内容を拾いにくい。
+ * ファイルの内容は{"wins": 3, "losses": 1}のようなJSONか、「3-1」「3 1」のように
+ * 勝利数・敗北数の順に整数を並べたテキストとする。
+ */
+typedef struct match_counter_watch match_counter_watch_t;
+
+/**
+ * ファイルから勝敗数を読み込んだときに呼ばれるコールバック
+ * @param data 作成時に渡したポインタ
+ * @param wins ファイルの勝利数
+ * @param losses ファイルの敗北数
+ *
+ * ウォッチャーのスレッドから呼ばれる
+ */
+typedef void (*match_counter_watch_callback_t)(void *data, int wins, int losses);
+
+/**
+ * ファイルの監視を開始する
+ * @param path 監視するファイルのパス（まだ存在しなくてもよいが、ディレクトリは存在すること）
+ * @param callback 勝敗数を読み込んだときに呼ばれるコールバック
+ * @param data コールバックに渡すポインタ
+ * @return ウォッチャー（監視を開始できなかった場合はNULL）
+ *
+ * 開始時にも1回ファイルを読み、読めればコールバックを呼ぶ
+ */
+match_counter_watch_t *match_counter_watch_create(const char *path, match_counter_watch_callback_t callback,
+						  void *data);
+
+/**
+ * 監視を停止してウォッチャーを破棄する
+ * @param watch ウォッチャー（NULLなら何もしない）
+ *
+ * 戻った時点で、コールバックが実行中でないことが保証される
+ */
+void match_counter_watch_destroy(match_counter_watch_t *watch);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,139 @@
+/*
+Match Counter for OBS
+Copyright (C) 2025 Yudai Udagawa
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#include "match-counter-writer.h"
+#include <util/darray.h>
+#include <util/platform.h>
+#include <util/threading.h>
+
+// すべての書き込み先で1つの書き込みスレッドを共有する
+static pthread_t writer_thread;
+static bool writer_thread_active;
+static pthread_mutex_t writer_mutex; // 待ち行列とジョブのqueuedを保護する
+static pthread_mutex_t writer_flush_mutex; // flushの間保持する（finishが書き出し中のジョブを待つため）
+static os_sem_t *writer_sem;
+static DARRAY(struct match_counter_writer_job *) writer_queue;
+static volatile bool writer_stop;
+
+static void *writer_thread_main(void *data)
+{
+	UNUSED_PARAMETER(data);
+	os_set_thread_name("match-counter: writer");
+
+	while (os_sem_wait(writer_sem) == 0) {
+		if (os_atomic_load_bool(&writer_stop))
+			break;
+
+		// 取り出してから書き出し終えるまでflush_mutexを保持し、finishと入れ違わないようにする
+		pthread_mutex_lock(&writer_flush_mutex);
+
+		struct match_counter_writer_job *job = NULL;
+		pthread_mutex_lock(&writer_mutex);
+		if (writer_queue.num) {
+			job = writer_queue.array[0];
+			job->queued = false;
+			da_erase(writer_queue, 0);
+		}
+		pthread_mutex_unlock(&writer_mutex);
+
+		// finishで外されたジョブの分は空振りする
+		if (job)
+			job->flush(job->data);
+
+		pthread_mutex_unlock(&writer_flush_mutex);
+	}
+
+	return NULL;
+}
+
+void match_counter_writer_init(void)
+{
+	pthread_mutex_init(&writer_mutex, NULL);
+	pthread_mutex_init(&writer_flush_mutex, NULL);
+	da_init(writer_queue);
+	os_atomic_set_bool(&writer_stop, false);
+
+	if (os_sem_init(&writer_sem, 0) != 0) {
+		blog(LOG_ERROR, "match_counter_writer_init: Failed to create semaphore");
+		return;
+	}
+
+	writer_thread_active = pthread_create(&writer_thread, NULL, writer_thread_main, NULL) == 0;
+	if (!writer_thread_active)
+		blog(LOG_ERROR, "match_counter_writer_init: Failed to create writer thread");
+}
+
+void match_counter_writer_free(void)
+{
+	if (writer_thread_active) {
+		os_atomic_set_bool(&writer_stop, true);
+		os_sem_post(writer_sem);
+		pthread_join(writer_thread, NULL);
+		writer_thread_active = false;
+	}
+
+	// 書き込み先はすべて閉じられているため、待ち行列は空のはず
+	if (writer_queue.num)
+		blog(LOG_WARNING, "match_counter_writer_free: %zu jobs were not finished", writer_queue.num);
+
+	da_free(writer_queue);
+	os_sem_destroy(writer_sem);
+	writer_sem = NULL;
+	pthread_mutex_destroy(&writer_flush_mutex);
+	pthread_mutex_destroy(&writer_mutex);
+}
+
+void match_counter_writer_job_init(struct match_counter_writer_job *job, void (*flush)(void *data), void *data)
+{
+	job->flush = flush;
+	job->data = data;
+	job->queued = false;
+}
+
+void match_counter_writer_signal(struct match_counter_writer_job *job)
+{
+	if (!writer_thread_active) {
+		pthread_mutex_lock(&writer_flush_mutex);
+		job->flush(job->data);
+		pthread_mutex_unlock(&writer_flush_mutex);
+		return;
+	}
+
+	pthread_mutex_lock(&writer_mutex);
+	if (!job->queued) {
+		job->queued = true;
+		da_push_back(writer_queue, &job);
+		os_sem_post(writer_sem);
+	}
+	pthread_mutex_unlock(&writer_mutex);
+}
+
+void match_counter_writer_finish(struct match_counter_writer_job *job)
+{
+	pthread_mutex_lock(&writer_mutex);
+	if (job->queued) {
+		job->queued = false;
+		da_erase_item(writer_queue, &job);
+	}
+	pthread_mutex_unlock(&writer_mutex);
+
+	// 書き出し中なら終わるのを待ってから、残りを書き出す
+	pthread_mutex_lock(&writer_flush_mutex);
+	job->flush(job->data);
+	pthread_mutex_unlock(&writer_flush_mutex);
+}
@@ -0,0 +1,76 @@
+/*
+Match Counter for OBS
+Copyright (C) 2025 Yudai Udagawa
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program. If not, see <https://www.gnu.org/licenses/>
+*/
+
+#pragma once
+
+#include <obs-module.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * ジャーナル、対戦カードのストア、エクスポーターのファイル書き込みを行うジョブ
+ *
+ * すべての書き込み先で1つの書き込みスレッドを共有する。書き込み先はジョブを埋め込み、
+ * 書き出すデータが溜まったときだけmatch_counter_writer_signalで依頼する。
+ * スレッドは依頼があるまでタイムアウトなしで待つため、書き込み先がいくつあっても待機中はCPUを使わない。
+ */
+struct match_counter_writer_job {
+	void (*flush)(void *data); // 溜まったデータを書き出す（同時に2つ以上のflushが呼ばれることはない）
+	void *data;
+	bool queued; // 書き込みスレッドの待ち行列に入っているか（内部で使う）
+};
+
+/**
+ * 書き込みスレッドを開始する（モジュールの読み込み時に1回だけ呼ぶ）
+ */
+void match_counter_writer_init(void);
+
+/**
+ * 書き込みスレッドを停止する（モジュールの解放時に、すべての書き込み先を閉じた後で1回だけ呼ぶ）
+ */
+void match_counter_writer_free(void);
+
+/**
+ * ジョブを初期化する
+ * @param job ジョブ
+ * @param flush 溜まったデータを書き出す関数
+ * @param data flushに渡す値
+ */
+void match_counter_writer_job_init(struct match_counter_writer_job *job, void (*flush)(void *data), void *data);
+
+/**
+ * 書き込みスレッドにジョブの書き出しを依頼する
+ * @param job ジョブ
+ *
+ * 既に依頼済みで未着手なら何もしない。書き込みスレッドを開始できなかった場合はその場で書き出す
+ */
+void match_counter_writer_signal(struct match_counter_writer_job *job);
+
+/**
+ * ジョブを書き込みスレッドから外し、残りをその場で書き出す
+ * @param job ジョブ
+ *
+ * 書き出し中なら終わるまで待つ。戻った後はflushが呼ばれないため、書き込み先を破棄できる
+ */
+void match_counter_writer_finish(struct match_counter_writer_job *job);
+
+#ifdef __cplusplus
+}
+#endif
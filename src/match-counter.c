@@ -17,16 +17,286 @@ with this program. If not, see <https://www.gnu.org/licenses/>
 */
 
 #include "match-counter.h"
+#include "match-counter-atomic.h"
 #include <plugin-support.h>
 #include <util/platform.h>
 #include <util/dstr.h>
 
+// 変数1つあたりの最大出力長（符号付き64bit整数の10進表現。勝率の"100.0%"も収まる）
+#define MATCH_COUNTER_INT_MAX_LEN 20
+
+static void match_counter_push_literal(match_counter_format_t *fmt, size_t offset, size_t len)
+{
+	if (!len)
+		return;
+
+	// 直前もリテラルで連続していれば1つにまとめる
+	if (fmt->ops.num) {
+		struct match_counter_format_op *last = &fmt->ops.array[fmt->ops.num - 1];
+		if (last->type == MATCH_COUNTER_OP_LITERAL && last->offset + last->len == offset) {
+			last->len += len;
+			fmt->literal_len += len;
+			return;
+		}
+	}
+
+	struct match_counter_format_op op = {MATCH_COUNTER_OP_LITERAL, offset, len};
+	da_push_back(fmt->ops, &op);
+	fmt->literal_len += len;
+}
+
+static void match_counter_push_token(match_counter_format_t *fmt, enum match_counter_format_op_type type)
+{
+	struct match_counter_format_op op = {type, 0, 0};
+	da_push_back(fmt->ops, &op);
+	fmt->token_count++;
+	if (type == MATCH_COUNTER_OP_MATCHUP_KEY)
+		fmt->key_count++;
+}
+
+static void match_counter_compile_format(match_counter_format_t *fmt)
+{
+	const char *format = fmt->format;
+	size_t literal_start = 0;
+	size_t i = 0;
+
+	da_clear(fmt->ops);
+	fmt->literal_len = 0;
+	fmt->token_count = 0;
+	fmt->key_count = 0;
+
+	while (format[i]) {
+		if (format[i] != '%') {
+			i++;
+			continue;
+		}
+
+		enum match_counter_format_op_type type;
+		size_t token_len = 2;
+		switch (format[i + 1]) {
+		case 'w':
+			type = MATCH_COUNTER_OP_WINS;
+			break;
+		case 'l':
+			type = MATCH_COUNTER_OP_LOSSES;
+			break;
+		case 't':
+			type = MATCH_COUNTER_OP_TOTAL;
+			break;
+		case 'r':
+			type = MATCH_COUNTER_OP_WIN_RATE;
+			break;
+		case 's':
+			type = MATCH_COUNTER_OP_STREAK;
+			break;
+		case 'b':
+			type = MATCH_COUNTER_OP_BEST_STREAK;
+			break;
+		case 'W':
+			type = MATCH_COUNTER_OP_RECENT_WINS;
+			break;
+		case 'n':
+			type = MATCH_COUNTER_OP_RECENT_TOTAL;
+			break;
+		case 'R':
+			type = MATCH_COUNTER_OP_RECENT_WIN_RATE;
+			break;
+		case 'k':
+			// %kの後にw/l/t/rが続けば選択中のキーの勝敗、そうでなければキー名
+			token_len = 3;
+			switch (format[i + 2]) {
+			case 'w':
+				type = MATCH_COUNTER_OP_MATCHUP_WINS;
+				break;
+			case 'l':
+				type = MATCH_COUNTER_OP_MATCHUP_LOSSES;
+				break;
+			case 't':
+				type = MATCH_COUNTER_OP_MATCHUP_TOTAL;
+				break;
+			case 'r':
+				type = MATCH_COUNTER_OP_MATCHUP_RATE;
+				break;
+			default:
+				type = MATCH_COUNTER_OP_MATCHUP_KEY;
+				token_len = 2;
+				break;
+			}
+			break;
+		case '\0':
+			// 末尾の'%'はそのまま出力する
+			i++;
+			continue;
+		default:
+			// 未知の変数は'%'ごとそのまま出力する
+			i += 2;
+			continue;
+		}
+
+		match_counter_push_literal(fmt, literal_start, i - literal_start);
+		match_counter_push_token(fmt, type);
+		i += token_len;
+		literal_start = i;
+	}
+
+	match_counter_push_literal(fmt, literal_start, i - literal_start);
+}
+
+static inline uint64_t match_counter_pack_state(int wins, int losses)
+{
+	return (uint64_t)(uint32_t)wins | ((uint64_t)(uint32_t)losses << 32);
+}
+
+static inline int match_counter_state_wins(uint64_t state)
+{
+	return (int)(uint32_t)(state & 0xFFFFFFFFu);
+}
+
+static inline int match_counter_state_losses(uint64_t state)
+{
+	return (int)(uint32_t)(state >> 32);
+}
+
+// 勝敗数を書き換える。変化がなければfalseを返す
+typedef bool (*match_counter_state_op_t)(int *wins, int *losses, int arg);
+
+// CASで勝敗数を更新する。履歴を更新してから呼び出し側で世代番号を進める
+static bool match_counter_update_state(match_counter_t *counter, match_counter_state_op_t op, int arg)
+{
+	uint64_t old_state = match_counter_atomic_load_u64(&counter->state);
+
+	for (;;) {
+		int wins = match_counter_state_wins(old_state);
+		int losses = match_counter_state_losses(old_state);
+
+		if (!op(&wins, &losses, arg))
+			return false;
+
+		uint64_t new_state = match_counter_pack_state(wins, losses);
+		if (match_counter_atomic_compare_exchange_u64(&counter->state, &old_state, new_state))
+			return true;
+	}
+}
+
+// 表示に関わる値をすべて公開してから世代番号を進める
+static inline void match_counter_bump_generation(match_counter_t *counter)
+{
+	match_counter_atomic_inc_u64(&counter->generation);
+}
+
+// 選択中のキーとその勝敗を公開する（キーか記録を変えるたびに呼ぶ）
+static void match_counter_publish_matchup(match_counter_t *counter)
+{
+	const struct match_counter_matchup *matchup = match_counter_get_current_matchup(counter);
+	uint64_t words[MATCH_COUNTER_MATCHUP_KEY_SIZE / 8] = {0};
+	memcpy(words, counter->matchup_key, counter->matchup_key_len);
+
+	match_counter_atomic_inc_u64(&counter->matchup_seq);
+	for (size_t i = 0; i < MATCH_COUNTER_MATCHUP_KEY_SIZE / 8; i++)
+		match_counter_atomic_store_u64(&counter->matchup_words[i], words[i]);
+	match_counter_atomic_store_u64(&counter->matchup_state,
+				       matchup ? match_counter_pack_state(matchup->wins, matchup->losses) : 0);
+	match_counter_atomic_inc_u64(&counter->matchup_seq);
+}
+
+// 選択中のキーの記録に勝敗を加える（負の値なら取り消す）
+static void match_counter_record_matchup(match_counter_t *counter, int wins, int losses)
+{
+	if (!counter->matchup_key_len)
+		return;
+
+	// 取り消しのために記録を作ることはしない
+	struct match_counter_matchup *matchup =
+		wins > 0 || losses > 0 ? match_counter_matchup_insert(&counter->matchups, counter->matchup_key,
+								      counter->matchup_key_len, counter->matchup_hash)
+				       : match_counter_matchup_find(&counter->matchups, counter->matchup_key,
+								    counter->matchup_key_len, counter->matchup_hash);
+	if (!matchup)
+		return;
+
+	if (wins > 0 ? matchup->wins < INT_MAX : matchup->wins > 0)
+		matchup->wins += wins;
+	if (losses > 0 ? matchup->losses < INT_MAX : matchup->losses > 0)
+		matchup->losses += losses;
+
+	match_counter_publish_matchup(counter);
+}
+
+static bool match_counter_op_add_win(int *wins, int *losses, int arg)
+{
+	UNUSED_PARAMETER(losses);
+	UNUSED_PARAMETER(arg);
+	if (*wins == INT_MAX)
+		return false;
+	(*wins)++;
+	return true;
+}
+
+static bool match_counter_op_add_loss(int *wins, int *losses, int arg)
+{
+	UNUSED_PARAMETER(wins);
+	UNUSED_PARAMETER(arg);
+	if (*losses == INT_MAX)
+		return false;
+	(*losses)++;
+	return true;
+}
+
+static bool match_counter_op_subtract_win(int *wins, int *losses, int arg)
+{
+	UNUSED_PARAMETER(losses);
+	UNUSED_PARAMETER(arg);
+	if (*wins <= 0)
+		return false;
+	(*wins)--;
+	return true;
+}
+
+static bool match_counter_op_subtract_loss(int *wins, int *losses, int arg)
+{
+	UNUSED_PARAMETER(wins);
+	UNUSED_PARAMETER(arg);
+	if (*losses <= 0)
+		return false;
+	(*losses)--;
+	return true;
+}
+
+static bool match_counter_op_reset(int *wins, int *losses, int arg)
+{
+	UNUSED_PARAMETER(arg);
+	if (*wins == 0 && *losses == 0)
+		return false;
+	*wins = 0;
+	*losses = 0;
+	return true;
+}
+
+static bool match_counter_op_set_wins(int *wins, int *losses, int arg)
+{
+	UNUSED_PARAMETER(losses);
+	if (*wins == arg)
+		return false;
+	*wins = arg;
+	return true;
+}
+
+static bool match_counter_op_set_losses(int *wins, int *losses, int arg)
+{
+	UNUSED_PARAMETER(wins);
+	if (*losses == arg)
+		return false;
+	*losses = arg;
+	return true;
+}
+
 match_counter_t *match_counter_create(void)
 {
 	match_counter_t *counter = bzalloc(sizeof(match_counter_t));
-	counter->wins = 0;
-	counter->losses = 0;
-	counter->format = bstrdup("%w-%l(%r)");
+	counter->state = match_counter_pack_state(0, 0);
+	counter->history = match_counter_history_create(MATCH_COUNTER_HISTORY_DEFAULT_WINDOW);
+	counter->format = match_counter_format_create("%w-%l(%r)");
+	match_counter_matchup_table_init(&counter->matchups);
 	return counter;
 }
 
@@ -35,49 +305,80 @@ void match_counter_destroy(match_counter_t *counter)
 	if (!counter)
 		return;
 
-	bfree(counter->format);
+	match_counter_history_destroy(counter->history);
+	match_counter_format_destroy(counter->format);
+	match_counter_matchup_table_free(&counter->matchups);
 	bfree(counter);
 }
 
-void match_counter_add_win(match_counter_t *counter)
+bool match_counter_add_win(match_counter_t *counter)
 {
 	if (!counter)
-		return;
+		return false;
+
+	if (!match_counter_update_state(counter, match_counter_op_add_win, 0))
+		return false;
 
-	counter->wins++;
+	match_counter_history_push(counter->history, MATCH_RESULT_WIN, match_counter_history_now_ms());
+	match_counter_record_matchup(counter, 1, 0);
+	match_counter_bump_generation(counter);
+	return true;
 }
 
-void match_counter_add_loss(match_counter_t *counter)
+bool match_counter_add_loss(match_counter_t *counter)
 {
 	if (!counter)
-		return;
+		return false;
 
-	counter->losses++;
+	if (!match_counter_update_state(counter, match_counter_op_add_loss, 0))
+		return false;
+
+	match_counter_history_push(counter->history, MATCH_RESULT_LOSS, match_counter_history_now_ms());
+	match_counter_record_matchup(counter, 0, 1);
+	match_counter_bump_generation(counter);
+	return true;
 }
 
-void match_counter_subtract_win(match_counter_t *counter)
+bool match_counter_subtract_win(match_counter_t *counter)
 {
-	if (!counter || counter->wins <= 0)
-		return;
+	if (!counter)
+		return false;
 
-	counter->wins--;
+	if (!match_counter_update_state(counter, match_counter_op_subtract_win, 0))
+		return false;
+
+	// 直前の勝利の取り消しであれば履歴からも取り除く
+	match_counter_history_pop(counter->history, MATCH_RESULT_WIN);
+	match_counter_record_matchup(counter, -1, 0);
+	match_counter_bump_generation(counter);
+	return true;
 }
 
-void match_counter_subtract_loss(match_counter_t *counter)
+bool match_counter_subtract_loss(match_counter_t *counter)
 {
-	if (!counter || counter->losses <= 0)
-		return;
+	if (!counter)
+		return false;
 
-	counter->losses--;
+	if (!match_counter_update_state(counter, match_counter_op_subtract_loss, 0))
+		return false;
+
+	match_counter_history_pop(counter->history, MATCH_RESULT_LOSS);
+	match_counter_record_matchup(counter, 0, -1);
+	match_counter_bump_generation(counter);
+	return true;
 }
 
-void match_counter_reset(match_counter_t *counter)
+bool match_counter_reset(match_counter_t *counter)
 {
 	if (!counter)
-		return;
+		return false;
+
+	if (!match_counter_update_state(counter, match_counter_op_reset, 0))
+		return false;
 
-	counter->wins = 0;
-	counter->losses = 0;
+	match_counter_history_clear(counter->history);
+	match_counter_bump_generation(counter);
+	return true;
 }
 
 int match_counter_get_wins(match_counter_t *counter)
@@ -85,7 +386,7 @@ int match_counter_get_wins(match_counter_t *counter)
 	if (!counter)
 		return 0;
 
-	return counter->wins;
+	return match_counter_state_wins(match_counter_atomic_load_u64(&counter->state));
 }
 
 int match_counter_get_losses(match_counter_t *counter)
@@ -93,35 +394,134 @@ int match_counter_get_losses(match_counter_t *counter)
 	if (!counter)
 		return 0;
 
-	return counter->losses;
+	return match_counter_state_losses(match_counter_atomic_load_u64(&counter->state));
 }
 
-void match_counter_set_wins(match_counter_t *counter, int wins)
+bool match_counter_set_wins(match_counter_t *counter, int wins)
 {
 	if (!counter)
-		return;
+		return false;
+
+	if (!match_counter_update_state(counter, match_counter_op_set_wins, wins < 0 ? 0 : wins))
+		return false;
 
-	counter->wins = wins < 0 ? 0 : wins;
+	match_counter_bump_generation(counter);
+	return true;
 }
 
-void match_counter_set_losses(match_counter_t *counter, int losses)
+bool match_counter_set_losses(match_counter_t *counter, int losses)
 {
 	if (!counter)
+		return false;
+
+	if (!match_counter_update_state(counter, match_counter_op_set_losses, losses < 0 ? 0 : losses))
+		return false;
+
+	match_counter_bump_generation(counter);
+	return true;
+}
+
+void match_counter_get_snapshot(match_counter_t *counter, match_counter_snapshot_t *snapshot)
+{
+	if (!counter) {
+		memset(snapshot, 0, sizeof(*snapshot));
 		return;
+	}
 
-	counter->losses = losses < 0 ? 0 : losses;
+	snapshot->generation = match_counter_atomic_load_u64(&counter->generation);
+
+	uint64_t state = match_counter_atomic_load_u64(&counter->state);
+	snapshot->wins = match_counter_state_wins(state);
+	snapshot->losses = match_counter_state_losses(state);
+
+	match_counter_history_get_stats(counter->history, &snapshot->history);
+
+	// 書き換え中でない、前後で同じシーケンス番号の間に読めた値を使う
+	uint64_t words[MATCH_COUNTER_MATCHUP_KEY_SIZE / 8];
+	uint64_t matchup_state;
+	uint64_t seq;
+	do {
+		seq = match_counter_atomic_load_u64(&counter->matchup_seq);
+		for (size_t i = 0; i < MATCH_COUNTER_MATCHUP_KEY_SIZE / 8; i++)
+			words[i] = match_counter_atomic_load_u64(&counter->matchup_words[i]);
+		matchup_state = match_counter_atomic_load_u64(&counter->matchup_state);
+	} while ((seq & 1) || seq != match_counter_atomic_load_u64(&counter->matchup_seq));
+
+	memcpy(snapshot->matchup_key, words, sizeof(snapshot->matchup_key));
+	snapshot->matchup_key[MATCH_COUNTER_MATCHUP_KEY_SIZE - 1] = '\0';
+	snapshot->matchup_wins = match_counter_state_wins(matchup_state);
+	snapshot->matchup_losses = match_counter_state_losses(matchup_state);
 }
 
-float match_counter_get_win_rate(match_counter_t *counter)
+bool match_counter_set_matchup(match_counter_t *counter, const char *key)
 {
 	if (!counter)
-		return 0.0f;
+		return false;
+
+	size_t len = key ? strlen(key) : 0;
+	if (len >= MATCH_COUNTER_MATCHUP_KEY_SIZE)
+		return false;
+
+	if (len == counter->matchup_key_len && memcmp(counter->matchup_key, key, len) == 0)
+		return false;
+
+	memset(counter->matchup_key, 0, sizeof(counter->matchup_key));
+	if (len)
+		memcpy(counter->matchup_key, key, len);
+	counter->matchup_key_len = (uint8_t)len;
+	counter->matchup_hash = match_counter_matchup_hash(counter->matchup_key, len);
+
+	match_counter_publish_matchup(counter);
+	match_counter_bump_generation(counter);
+	return true;
+}
+
+const struct match_counter_matchup *match_counter_get_current_matchup(match_counter_t *counter)
+{
+	if (!counter || !counter->matchup_key_len)
+		return NULL;
+
+	return match_counter_matchup_find(&counter->matchups, counter->matchup_key, counter->matchup_key_len,
+					  counter->matchup_hash);
+}
+
+bool match_counter_set_history_window(match_counter_t *counter, uint32_t window)
+{
+	if (!counter)
+		return false;
+
+	if (!match_counter_history_set_window(counter->history, window))
+		return false;
+
+	match_counter_bump_generation(counter);
+	return true;
+}
+
+uint32_t match_counter_get_history_window(match_counter_t *counter)
+{
+	if (!counter)
+		return 0;
 
-	int total = counter->wins + counter->losses;
+	return match_counter_history_get_window(counter->history);
+}
+
+static float match_counter_calc_win_rate(int wins, int losses)
+{
+	long long total = (long long)wins + losses;
 	if (total == 0)
 		return 0.0f;
 
-	return (float)counter->wins / (float)total;
+	return (float)wins / (float)total;
+}
+
+float match_counter_get_win_rate(match_counter_t *counter)
+{
+	if (!counter)
+		return 0.0f;
+
+	match_counter_snapshot_t snapshot;
+	match_counter_get_snapshot(counter, &snapshot);
+	return match_counter_calc_win_rate(snapshot.wins, snapshot.losses);
 }
 
 void match_counter_set_format(match_counter_t *counter, const char *format)
@@ -129,8 +529,8 @@ void match_counter_set_format(match_counter_t *counter, const char *format)
 	if (!counter || !format)
 		return;
 
-	bfree(counter->format);
-	counter->format = bstrdup(format);
+	if (match_counter_format_set(counter->format, format))
+		match_counter_bump_generation(counter);
 }
 
 const char *match_counter_get_format(match_counter_t *counter)
@@ -138,7 +538,135 @@ const char *match_counter_get_format(match_counter_t *counter)
 	if (!counter)
 		return "";
 
-	return counter->format;
+	return match_counter_format_get(counter->format);
+}
+
+uint64_t match_counter_get_generation(match_counter_t *counter)
+{
+	if (!counter)
+		return 0;
+
+	return match_counter_atomic_load_u64(&counter->generation);
+}
+
+// 整数を10進数で書き込み、書き込んだバイト数を返す
+static size_t match_counter_write_int(char *dst, long long value)
+{
+	char buf[MATCH_COUNTER_INT_MAX_LEN];
+	unsigned long long v = value < 0 ? 0ULL - (unsigned long long)value : (unsigned long long)value;
+	size_t n = 0;
+
+	do {
+		buf[n++] = (char)('0' + v % 10);
+		v /= 10;
+	} while (v);
+
+	if (value < 0)
+		buf[n++] = '-';
+
+	for (size_t i = 0; i < n; i++)
+		dst[i] = buf[n - 1 - i];
+
+	return n;
+}
+
+// 勝率を"%.1f%%"と同じ表記で書き込み、書き込んだバイト数を返す
+static size_t match_counter_write_win_rate(char *dst, float win_rate)
+{
+	// printfと同じ結果にするため、float の値を10倍した正確な値を偶数丸めで整数化する
+	double scaled = (double)(win_rate * 100.0f) * 10.0;
+	unsigned long long tenths = (unsigned long long)scaled;
+	double frac = scaled - (double)tenths;
+	if (frac > 0.5 || (frac == 0.5 && (tenths & 1)))
+		tenths++;
+
+	size_t n = match_counter_write_int(dst, (long long)(tenths / 10));
+	dst[n++] = '.';
+	dst[n++] = (char)('0' + tenths % 10);
+	dst[n++] = '%';
+	return n;
+}
+
+static void match_counter_format_into(match_counter_format_t *fmt, const match_counter_snapshot_t *snapshot,
+				      struct dstr *out)
+{
+	const char *format = fmt->format;
+	int wins = snapshot->wins;
+	int losses = snapshot->losses;
+	const struct match_counter_history_stats *stats = &snapshot->history;
+	size_t max_len = fmt->literal_len + fmt->token_count * MATCH_COUNTER_INT_MAX_LEN +
+			 fmt->key_count * MATCH_COUNTER_MATCHUP_KEY_SIZE;
+	size_t pos = 0;
+
+	// 最大長を確保しておけば、書き込み中に再確保は起きない
+	dstr_ensure_capacity(out, max_len + 1);
+
+	for (size_t i = 0; i < fmt->ops.num; i++) {
+		const struct match_counter_format_op *op = &fmt->ops.array[i];
+		char *dst = out->array + pos;
+
+		switch (op->type) {
+		case MATCH_COUNTER_OP_LITERAL:
+			memcpy(dst, format + op->offset, op->len);
+			pos += op->len;
+			break;
+		case MATCH_COUNTER_OP_WINS:
+			pos += match_counter_write_int(dst, wins);
+			break;
+		case MATCH_COUNTER_OP_LOSSES:
+			pos += match_counter_write_int(dst, losses);
+			break;
+		case MATCH_COUNTER_OP_TOTAL:
+			// 総試合数（wins+losses）
+			pos += match_counter_write_int(dst, (long long)wins + losses);
+			break;
+		case MATCH_COUNTER_OP_WIN_RATE:
+			// 勝率をパーセント表示（小数点以下1桁）
+			pos += match_counter_write_win_rate(dst, match_counter_calc_win_rate(wins, losses));
+			break;
+		case MATCH_COUNTER_OP_STREAK:
+			// 連敗中は0と表示する
+			pos += match_counter_write_int(dst, stats->streak > 0 ? stats->streak : 0);
+			break;
+		case MATCH_COUNTER_OP_BEST_STREAK:
+			pos += match_counter_write_int(dst, stats->best_streak);
+			break;
+		case MATCH_COUNTER_OP_RECENT_WINS:
+			pos += match_counter_write_int(dst, stats->recent_wins);
+			break;
+		case MATCH_COUNTER_OP_RECENT_TOTAL:
+			pos += match_counter_write_int(dst, stats->recent_total);
+			break;
+		case MATCH_COUNTER_OP_RECENT_WIN_RATE:
+			pos += match_counter_write_win_rate(
+				dst, match_counter_calc_win_rate(stats->recent_wins,
+								 stats->recent_total - stats->recent_wins));
+			break;
+		case MATCH_COUNTER_OP_MATCHUP_KEY: {
+			size_t len = strlen(snapshot->matchup_key);
+			memcpy(dst, snapshot->matchup_key, len);
+			pos += len;
+			break;
+		}
+		case MATCH_COUNTER_OP_MATCHUP_WINS:
+			pos += match_counter_write_int(dst, snapshot->matchup_wins);
+			break;
+		case MATCH_COUNTER_OP_MATCHUP_LOSSES:
+			pos += match_counter_write_int(dst, snapshot->matchup_losses);
+			break;
+		case MATCH_COUNTER_OP_MATCHUP_TOTAL:
+			pos += match_counter_write_int(dst,
+						       (long long)snapshot->matchup_wins + snapshot->matchup_losses);
+			break;
+		case MATCH_COUNTER_OP_MATCHUP_RATE:
+			pos += match_counter_write_win_rate(
+				dst, match_counter_calc_win_rate(snapshot->matchup_wins, snapshot->matchup_losses));
+			break;
+		}
+	}
+
+	out->array[pos] = 0;
+	out->len = pos;
 }
 
 char *match_counter_get_formatted_text(match_counter_t *counter)
@@ -146,35 +674,88 @@ char *match_counter_get_formatted_text(match_counter_t *counter)
 	if (!counter)
 		return bstrdup("");
 
-	struct dstr str = {0};
-	const char *format = counter->format;
-	int wins = counter->wins;
-	int losses = counter->losses;
-	float win_rate = match_counter_get_win_rate(counter);
-
-	dstr_init(&str);
-
-	while (*format) {
-		if (*format == '%') {
-			format++;
-			if (*format == 'w') {
-				dstr_catf(&str, "%d", wins);
-			} else if (*format == 'l') {
-				dstr_catf(&str, "%d", losses);
-			} else if (*format == 't') {
-				// 総試合数（wins+losses）
-				dstr_catf(&str, "%d", wins + losses);
-			} else if (*format == 'r') {
-				// 勝率をパーセント表示（小数点以下1桁）
-				dstr_catf(&str, "%.1f%%", win_rate * 100.0f);
-			} else {
-				dstr_catf(&str, "%%%c", *format);
-			}
-		} else {
-			dstr_catf(&str, "%c", *format);
-		}
-		format++;
+	return match_counter_format_render_copy(counter->format, counter);
+}
+
+const char *match_counter_get_text(match_counter_t *counter)
+{
+	if (!counter)
+		return "";
+
+	return match_counter_format_render(counter->format, counter);
+}
+
+match_counter_format_t *match_counter_format_create(const char *format)
+{
+	match_counter_format_t *fmt = bzalloc(sizeof(match_counter_format_t));
+	fmt->format = bstrdup(format ? format : "");
+	da_init(fmt->ops);
+	dstr_init(&fmt->text);
+	match_counter_compile_format(fmt);
+	return fmt;
+}
+
+void match_counter_format_destroy(match_counter_format_t *fmt)
+{
+	if (!fmt)
+		return;
+
+	da_free(fmt->ops);
+	dstr_free(&fmt->text);
+	bfree(fmt->format);
+	bfree(fmt);
+}
+
+bool match_counter_format_set(match_counter_format_t *fmt, const char *format)
+{
+	if (!fmt || !format)
+		return false;
+
+	if (fmt->format && strcmp(fmt->format, format) == 0)
+		return false;
+
+	bfree(fmt->format);
+	fmt->format = bstrdup(format);
+	match_counter_compile_format(fmt);
+	fmt->text_valid = false;
+	return true;
+}
+
+const char *match_counter_format_get(match_counter_format_t *fmt)
+{
+	if (!fmt)
+		return "";
+
+	return fmt->format;
+}
+
+const char *match_counter_format_render(match_counter_format_t *fmt, match_counter_t *counter)
+{
+	if (!fmt)
+		return "";
+
+	if (!fmt->text_valid || fmt->text_counter != counter ||
+	    fmt->text_generation != match_counter_get_generation(counter)) {
+		match_counter_snapshot_t snapshot;
+		match_counter_get_snapshot(counter, &snapshot);
+		match_counter_format_into(fmt, &snapshot, &fmt->text);
+		fmt->text_counter = counter;
+		fmt->text_generation = snapshot.generation;
+		fmt->text_valid = true;
 	}
 
+	return fmt->text.array;
+}
+
+char *match_counter_format_render_copy(match_counter_format_t *fmt, match_counter_t *counter)
+{
+	if (!fmt)
+		return bstrdup("");
+
+	match_counter_snapshot_t snapshot;
+	struct dstr str = {0};
+
+	match_counter_get_snapshot(counter, &snapshot);
+	match_counter_format_into(fmt, &snapshot, &str);
 	return str.array;
 }
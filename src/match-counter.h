@@ -21,18 +21,108 @@ with this program. If not, see <https://www.gnu.org/licenses/>
 #include <obs-module.h>
 #include <util/bmem.h>
 #include <util/darray.h>
+#include <util/dstr.h>
+#include "match-counter-history.h"
+#include "match-counter-matchup.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/**
+ * コンパイル済みフォーマットの命令の種類
+ */
+enum match_counter_format_op_type {
+	MATCH_COUNTER_OP_LITERAL,         // フォーマット文字列の一部をそのまま出力
+	MATCH_COUNTER_OP_WINS,            // %w
+	MATCH_COUNTER_OP_LOSSES,          // %l
+	MATCH_COUNTER_OP_TOTAL,           // %t
+	MATCH_COUNTER_OP_WIN_RATE,        // %r
+	MATCH_COUNTER_OP_STREAK,          // %s
+	MATCH_COUNTER_OP_BEST_STREAK,     // %b
+	MATCH_COUNTER_OP_RECENT_WINS,     // %W
+	MATCH_COUNTER_OP_RECENT_TOTAL,    // %n
+	MATCH_COUNTER_OP_RECENT_WIN_RATE, // %R
+	MATCH_COUNTER_OP_MATCHUP_KEY,     // %k
+	MATCH_COUNTER_OP_MATCHUP_WINS,    // %kw
+	MATCH_COUNTER_OP_MATCHUP_LOSSES,  // %kl
+	MATCH_COUNTER_OP_MATCHUP_TOTAL,   // %kt
+	MATCH_COUNTER_OP_MATCHUP_RATE,    // %kr
+};
+
+/**
+ * コンパイル済みフォーマットの命令
+ */
+struct match_counter_format_op {
+	enum match_counter_format_op_type type;
+	size_t offset; // LITERALの場合のフォーマット文字列内の開始位置
+	size_t len;    // LITERALの場合のバイト数
+};
+
+/**
+ * コンパイル済みの表示フォーマット
+ *
+ * 同じカウンターを複数のソースが異なるフォーマットで表示できるよう、
+ * カウンター本体とは別に持つ。描画スレッドからのみ触る。
+ */
+typedef struct match_counter_format {
+	char *format; // 表示フォーマット
+
+	// コンパイルした命令列
+	DARRAY(struct match_counter_format_op) ops;
+	size_t literal_len; // リテラル部分の合計バイト数
+	size_t token_count; // 変数の数
+	size_t key_count;   // そのうちキー名（%k）の数
+
+	// 描画用に使い回すテキストバッファ
+	struct dstr text;
+	const void *text_counter; // textを生成したカウンター
+	uint64_t text_generation; // textを生成した時点の世代番号
+	bool text_valid;
+} match_counter_format_t;
+
+/**
+ * 勝敗数の一貫したスナップショット
+ */
+typedef struct match_counter_snapshot {
+	int wins;            // 勝利数
+	int losses;          // 敗北数
+	uint64_t generation; // 取得時点の世代番号
+
+	struct match_counter_history_stats history; // 履歴の集計値
+
+	char matchup_key[MATCH_COUNTER_MATCHUP_KEY_SIZE]; // 選択中のキー（なければ空文字列）
+	int matchup_wins;                                 // 選択中のキーの勝利数
+	int matchup_losses;                               // 選択中のキーの敗北数
+} match_counter_snapshot_t;
+
 /**
  * 試合結果の構造体
+ *
+ * 勝敗数はホットキーのスレッドから更新され、描画スレッドから読まれるため、
+ * 1つの64bit値にまとめてアトミックに公開する。フォーマットと描画用バッファは
+ * 描画スレッド（ソースのupdate/video_render）からのみ触る。
  */
 typedef struct match_counter {
-	int wins;     // 勝利数
-	int losses;   // 敗北数
-	char *format; // 表示フォーマット
+	volatile uint64_t state;      // 下位32bit: 勝利数, 上位32bit: 敗北数
+	volatile uint64_t generation; // 表示内容が変わるたびに増える世代番号
+
+	// 試合結果の履歴（連勝数・直近N試合の集計用）
+	match_counter_history_t *history;
+
+	// match_counter_set_format/match_counter_get_textで使うフォーマット
+	match_counter_format_t *format;
+
+	// キー（対戦相手・キャラクターなど）ごとの勝敗。勝敗数と同じスレッドからのみ更新する
+	match_counter_matchup_table_t matchups;
+	char matchup_key[MATCH_COUNTER_MATCHUP_KEY_SIZE]; // 選択中のキー（空ならキーごとには記録しない）
+	uint8_t matchup_key_len;
+	uint32_t matchup_hash;
+
+	// 選択中のキーとその勝敗を、他のスレッドからもロックなしで一貫して読めるように公開する
+	volatile uint64_t matchup_seq; // 書き換え中は奇数になるシーケンス番号
+	volatile uint64_t matchup_words[MATCH_COUNTER_MATCHUP_KEY_SIZE / 8];
+	volatile uint64_t matchup_state; // 下位32bit: 勝利数, 上位32bit: 敗北数
 } match_counter_t;
 
 /**
@@ -50,32 +140,37 @@ void match_counter_destroy(match_counter_t *counter);
 /**
  * 勝利数を増やす
  * @param counter 試合カウンター
+ * @return 値が変わった場合はtrue
  */
-void match_counter_add_win(match_counter_t *counter);
+bool match_counter_add_win(match_counter_t *counter);
 
 /**
  * 敗北数を増やす
  * @param counter 試合カウンター
+ * @return 値が変わった場合はtrue
  */
-void match_counter_add_loss(match_counter_t *counter);
+bool match_counter_add_loss(match_counter_t *counter);
 
 /**
  * 勝利数を減らす
  * @param counter 試合カウンター
+ * @return 値が変わった場合はtrue
  */
-void match_counter_subtract_win(match_counter_t *counter);
+bool match_counter_subtract_win(match_counter_t *counter);
 
 /**
  * 敗北数を減らす
  * @param counter 試合カウンター
+ * @return 値が変わった場合はtrue
  */
-void match_counter_subtract_loss(match_counter_t *counter);
+bool match_counter_subtract_loss(match_counter_t *counter);
 
 /**
  * 勝敗をリセットする
  * @param counter 試合カウンター
+ * @return 値が変わった場合はtrue
  */
-void match_counter_reset(match_counter_t *counter);
+bool match_counter_reset(match_counter_t *counter);
 
 /**
  * 勝利数を取得する
@@ -95,15 +190,61 @@ int match_counter_get_losses(match_counter_t *counter);
  * 勝利数を設定する
  * @param counter 試合カウンター
  * @param wins 勝利数
+ * @return 値が変わった場合はtrue
  */
-void match_counter_set_wins(match_counter_t *counter, int wins);
+bool match_counter_set_wins(match_counter_t *counter, int wins);
 
 /**
  * 敗北数を設定する
  * @param counter 試合カウンター
  * @param losses 敗北数
+ * @return 値が変わった場合はtrue
+ */
+bool match_counter_set_losses(match_counter_t *counter, int losses);
+
+/**
+ * 勝敗数のスナップショットを取得する
+ * @param counter 試合カウンター
+ * @param snapshot 取得したスナップショットの格納先
+ *
+ * ロックを取らずに、勝利数と敗北数が同時に更新された一貫した組を取得する。
+ * generationは勝敗数より先に読むため、勝敗数の方が新しい場合はあるが古い場合はない。
+ */
+void match_counter_get_snapshot(match_counter_t *counter, match_counter_snapshot_t *snapshot);
+
+/**
+ * 記録先のキーを選択する
+ * @param counter 試合カウンター
+ * @param key キー（NULLまたは空文字列ならキーごとの記録をやめる）
+ * @return 選択が変わった場合はtrue（キーが長すぎる場合はfalse）
+ *
+ * 以降の勝利・敗北とその取り消しは、全体の勝敗数に加えて選択中のキーの記録にも反映される。
+ * 選択の切り替えはハッシュテーブルを引くだけで、メモリを確保しない（記録は最初の勝敗で追加する）。
+ * リセットと勝敗数の直接設定は全体の勝敗数だけを変え、キーごとの記録は残す。
  */
-void match_counter_set_losses(match_counter_t *counter, int losses);
+bool match_counter_set_matchup(match_counter_t *counter, const char *key);
+
+/**
+ * 選択中のキーの記録を取得する（記録を更新するスレッド用）
+ * @param counter 試合カウンター
+ * @return 選択中のキーの記録（キーが未選択か、まだ記録がなければNULL）
+ */
+const struct match_counter_matchup *match_counter_get_current_matchup(match_counter_t *counter);
+
+/**
+ * 直近何試合を集計するかを設定する
+ * @param counter 試合カウンター
+ * @param window 試合数（1～MATCH_COUNTER_HISTORY_MAX_WINDOW）
+ * @return 値が変わった場合はtrue
+ */
+bool match_counter_set_history_window(match_counter_t *counter, uint32_t window);
+
+/**
+ * 直近何試合を集計するかを取得する
+ * @param counter 試合カウンター
+ * @return 試合数
+ */
+uint32_t match_counter_get_history_window(match_counter_t *counter);
 
 /**
  * 勝率を取得する
@@ -120,7 +261,17 @@ float match_counter_get_win_rate(match_counter_t *counter);
  * フォーマット文字列では以下の変数が使用可能:
  * %w - 勝利数
  * %l - 敗北数
+ * %t - 総試合数
  * %r - 勝率（パーセント表示、例: 75.0%）
+ * %s - 現在の連勝数（連敗中は0）
+ * %b - 最長連勝数
+ * %W - 直近N試合の勝利数
+ * %n - 直近N試合の試合数（記録がN試合未満ならその数）
+ * %R - 直近N試合の勝率（パーセント表示）
+ * %k - 選択中のキー
+ * %kw, %kl, %kt, %kr - 選択中のキーの勝利数・敗北数・総試合数・勝率
+ *
+ * フォーマットはここで命令列にコンパイルされ、文字列生成時に毎回解釈されることはない
  */
 void match_counter_set_format(match_counter_t *counter, const char *format);
 
@@ -131,6 +282,15 @@ void match_counter_set_format(match_counter_t *counter, const char *format);
  */
 const char *match_counter_get_format(match_counter_t *counter);
 
+/**
+ * 世代番号を取得する
+ * @param counter 試合カウンター
+ * @return 勝敗数またはフォーマットが変わるたびに増える世代番号
+ *
+ * 前回取得した値と比較することで、表示の再生成が必要かを判定できる
+ */
+uint64_t match_counter_get_generation(match_counter_t *counter);
+
 /**
  * フォーマットされた文字列を取得する
  * @param counter 試合カウンター
@@ -138,6 +298,61 @@ const char *match_counter_get_format(match_counter_t *counter);
  */
 char *match_counter_get_formatted_text(match_counter_t *counter);
 
+/**
+ * フォーマットされた文字列をカウンター内部のバッファに生成して取得する
+ * @param counter 試合カウンター
+ * @return フォーマットされた文字列（解放不要、次に勝敗数かフォーマットが変わるまで有効）
+ *
+ * 世代番号が変わっていなければ前回生成した文字列をそのまま返す
+ */
+const char *match_counter_get_text(match_counter_t *counter);
+
+/**
+ * 表示フォーマットを作成する
+ * @param format フォーマット文字列（変数はmatch_counter_set_formatを参照）
+ * @return コンパイル済みの表示フォーマット
+ */
+match_counter_format_t *match_counter_format_create(const char *format);
+
+/**
+ * 表示フォーマットを破棄する
+ * @param fmt 表示フォーマット
+ */
+void match_counter_format_destroy(match_counter_format_t *fmt);
+
+/**
+ * フォーマット文字列を変更する
+ * @param fmt 表示フォーマット
+ * @param format フォーマット文字列
+ * @return 変わった場合はtrue
+ */
+bool match_counter_format_set(match_counter_format_t *fmt, const char *format);
+
+/**
+ * フォーマット文字列を取得する
+ * @param fmt 表示フォーマット
+ * @return フォーマット文字列
+ */
+const char *match_counter_format_get(match_counter_format_t *fmt);
+
+/**
+ * カウンターの値をフォーマットしてfmt内部のバッファに生成する
+ * @param fmt 表示フォーマット
+ * @param counter 試合カウンター
+ * @return フォーマットされた文字列（解放不要、fmtかcounterが変わるまで有効）
+ *
+ * 同じカウンターの世代番号が変わっていなければ前回生成した文字列をそのまま返す
+ */
+const char *match_counter_format_render(match_counter_format_t *fmt, match_counter_t *counter);
+
+/**
+ * カウンターの値をフォーマットした文字列を新しく確保して返す
+ * @param fmt 表示フォーマット
+ * @param counter 試合カウンター
+ * @return フォーマットされた文字列（呼び出し側で解放する必要あり）
+ */
+char *match_counter_format_render_copy(match_counter_format_t *fmt, match_counter_t *counter);
+
 #ifdef __cplusplus
 }
 #endif
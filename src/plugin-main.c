@@ -19,13 +19,19 @@ with this program. If not, see <https://www.gnu.org/licenses/>
 #include <obs-module.h>
 #include <plugin-support.h>
 #include "match-counter.h"
+#include "match-counter-writer.h"
 #include "match-counter-source.c"
+#include "match-counter-aggregate-source.c"
+#ifdef ENABLE_CONTROL_SOCKET
+#include "match-counter-control.h"
+#endif
 
 // C++関数の宣言
 #ifdef __cplusplus
 extern "C" {
 #endif
 extern void match_counter_ui_init(void);
+extern void match_counter_ui_free(void);
 #ifdef __cplusplus
 }
 #endif
@@ -33,13 +39,65 @@ extern void match_counter_ui_init(void);
 OBS_DECLARE_MODULE()
 OBS_MODULE_USE_DEFAULT_LOCALE(PLUGIN_NAME, "en-US")
 
+// フレームの始めに、外部ツールからのコマンドを積んでからすべての共有カウンターに適用する
+static void match_counter_tick_callback(void *param, float seconds)
+{
+	UNUSED_PARAMETER(param);
+	UNUSED_PARAMETER(seconds);
+#ifdef ENABLE_CONTROL_SOCKET
+	match_counter_control_tick();
+#endif
+	match_counter_registry_drain_all();
+}
+
+#ifdef ENABLE_CONTROL_SOCKET
+static void match_counter_control_load(void)
+{
+#ifdef _WIN32
+	match_counter_control_start("\\\\.\\pipe\\match-counter");
+#else
+	char *dir = obs_module_config_path("");
+	char *path = obs_module_config_path("control.sock");
+	os_mkdirs(dir);
+	match_counter_control_start(path);
+	bfree(path);
+	bfree(dir);
+#endif
+}
+#endif
+
 bool obs_module_load(void)
 {
 	obs_log(LOG_INFO, "plugin loaded successfully (version %s)", PLUGIN_VERSION);
 
+	// ジャーナルや書き出しのファイルに書き込むスレッドを開始
+	match_counter_writer_init();
+
+	// 共有カウンターのレジストリを初期化し、積まれた操作を毎フレーム適用する
+	match_counter_registry_init();
+	obs_add_tick_callback(match_counter_tick_callback, NULL);
+
+	// フォントごとに共有するテキストの描画器のプールを初期化
+	match_counter_text_pool_init();
+
+	// グリフアトラスからテキストを合成するワーカースレッドを開始
+	match_counter_compose_init();
+
+#ifdef ENABLE_TRACE
+	match_counter_trace_init();
+#endif
+
+	// 外部ツールから勝敗を操作するローカルのソケットを開く
+#ifdef ENABLE_CONTROL_SOCKET
+	match_counter_control_load();
+#endif
+
 	// テキストソースの登録
 	obs_register_source(&match_counter_source_info);
 
+	// 複数のカウンターの合計を表示するソースの登録
+	obs_register_source(&match_counter_aggregate_source_info);
+
 	// UIの初期化（フロントエンドAPIが有効な場合）
 #ifdef ENABLE_FRONTEND_API
 	match_counter_ui_init();
@@ -50,5 +108,19 @@ bool obs_module_load(void)
 
 void obs_module_unload(void)
 {
+#ifdef ENABLE_FRONTEND_API
+	match_counter_ui_free();
+#endif
+	obs_remove_tick_callback(match_counter_tick_callback, NULL);
+#ifdef ENABLE_CONTROL_SOCKET
+	match_counter_control_stop();
+#endif
+	match_counter_registry_free();
+	match_counter_writer_free();
+	match_counter_text_pool_free();
+	match_counter_compose_free();
+#ifdef ENABLE_TRACE
+	match_counter_trace_free();
+#endif
 	obs_log(LOG_INFO, "plugin unloaded");
 }